@@ -0,0 +1,117 @@
+// bench/articles_batch_bench.cpp
+//
+// Лента из BENCH_PAGE статей через работающий сервис: N отдельных запросов
+// GET /article/<id> против одного GET /articles?ids=... Каждый из BENCH_CLIENTS потоков
+// держит своё keep-alive соединение и в цикле запрашивает «страницу» из случайных id
+// в [1, BENCH_MAX_ID]. Для каждого режима печатаются страниц и HTTP-запросов в секунду
+// и p50/p99 времени получения страницы.
+//
+// Попадания и промахи кеша зависят от состояния сервиса: для замера промахов перед
+// запуском сбросьте ключи article:* в Redis и перезапустите сервис (L1).
+//
+// Запуск: articles_batch_bench
+// Переменные: BENCH_HOST (127.0.0.1), BENCH_PORT (18080), BENCH_CLIENTS (8),
+//             BENCH_SECONDS (10), BENCH_PAGE (20), BENCH_MAX_ID (1000).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/metrics.h"
+#include "http_client.h"
+
+enum class Mode { Individual, Batch };
+
+struct Result {
+    double pages_per_s = 0;
+    double requests_per_s = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    std::uint64_t errors = 0;
+};
+
+static Result run_mode(Mode mode, const std::string &host, int port, long clients, long seconds, long page,
+                       long max_id) {
+    LatencyRecorder latency("bench", {"op=\"page\""});
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> requests{0};
+    std::vector<std::thread> threads;
+
+    for (long c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            HttpClient http(host, port);
+            std::mt19937 rng(static_cast<unsigned>(c));
+            std::uniform_int_distribution<int> article(1, static_cast<int>(max_id));
+            std::vector<int> ids(static_cast<std::size_t>(page));
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int &id : ids) {
+                    id = article(rng);
+                }
+                const auto start = std::chrono::steady_clock::now();
+                bool failed = false;
+                try {
+                    if (mode == Mode::Individual) {
+                        for (int id : ids) {
+                            const int status = http.get("/article/" + std::to_string(id)).status;
+                            failed |= status != 200 && status != 404;
+                        }
+                        requests.fetch_add(ids.size(), std::memory_order_relaxed);
+                    }
+                    else {
+                        std::string path = "/articles?ids=";
+                        for (std::size_t i = 0; i < ids.size(); ++i) {
+                            path += (i ? "," : "") + std::to_string(ids[i]);
+                        }
+                        failed = http.get(path).status != 200;
+                        requests.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                catch (const std::exception &) {
+                    failed = true;
+                }
+                latency.record(0, std::chrono::steady_clock::now() - start, failed);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    const auto pages = latency.snapshot(0);
+    Result result;
+    result.pages_per_s = static_cast<double>(pages.count) / seconds;
+    result.requests_per_s = static_cast<double>(requests.load()) / seconds;
+    result.p50_ms = pages.percentile(0.5) / 1000.0;
+    result.p99_ms = pages.percentile(0.99) / 1000.0;
+    result.errors = pages.errors;
+    return result;
+}
+
+int main() {
+    const std::string host = env_string("BENCH_HOST", "127.0.0.1");
+    const int port = static_cast<int>(env_long("BENCH_PORT", 18080));
+    const long clients = std::max(1L, env_long("BENCH_CLIENTS", 8));
+    const long seconds = std::max(1L, env_long("BENCH_SECONDS", 10));
+    const long page = std::max(1L, env_long("BENCH_PAGE", 20));
+    const long max_id = std::max(1L, env_long("BENCH_MAX_ID", 1000));
+
+    std::printf("clients=%ld seconds=%ld page=%ld max_id=%ld\n", clients, seconds, page, max_id);
+    std::printf("%-10s %12s %12s %12s %12s %8s\n", "mode", "pages/s", "requests/s", "p50_ms", "p99_ms", "errors");
+    for (const auto &[name, mode] : {std::make_pair("individual", Mode::Individual),
+                                     std::make_pair("batch", Mode::Batch)}) {
+        const Result r = run_mode(mode, host, port, clients, seconds, page, max_id);
+        std::printf("%-10s %12.0f %12.0f %12.2f %12.2f %8llu\n", name, r.pages_per_s, r.requests_per_s, r.p50_ms,
+                    r.p99_ms, static_cast<unsigned long long>(r.errors));
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+// bench/articles_fetch_bench.cpp
+//
+// Сравнение способов собрать ответ GET /articles:
+//   loop    — прежний цикл 1 + N запросов (запрос комментариев на каждую статью);
+//   grouped — два запроса и группировка в памяти (ArticleListMode::Grouped);
+//   pg_json — один запрос с json_agg (ArticleListMode::PgJson);
+//   stream  — один запрос, чтение курсором прямо в текст ответа (ArticleListMode::Stream).
+//
+// Данные создаются во временных таблицах articles/comments текущей сессии: pg_temp
+// просматривается раньше public, поэтому запросы сервиса работают с ними без изменений,
+// а реальные таблицы не затрагиваются.
+//
+// peak_heap_kb — наибольший объём кучи сверх уже занятого за одну сборку ответа. malloc и
+// free подменены (через __libc_malloc и другие, только glibc), чтобы учитывать и память
+// libpq — pqxx::result выделяется мимо operator new. Сам ответ в это число входит:
+// сервис кеширует его целиком, поэтому ни один режим не собирает ответ в памяти
+// фиксированного размера; режимы различаются тем, что держат помимо него.
+//
+// Запуск: articles_fetch_bench [N ...]   (по умолчанию 100 10000 100000)
+// Переменные: BENCH_DB_CONN (или DB_CONN), BENCH_COMMENTS (комментариев на статью, 3),
+//             BENCH_REPEAT (повторов на замер, 5).
+
+#include <crow.h>
+#include <malloc.h>
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/article_queries.h"
+#include "../src/config.h"
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *p);
+}
+
+static std::atomic<long long> g_heap{0};
+static std::atomic<long long> g_heap_peak{0};
+
+static void heap_add(void *p) {
+    if (!p) {
+        return;
+    }
+    const auto size = static_cast<long long>(malloc_usable_size(p));
+    const long long now = g_heap.fetch_add(size) + size;
+    long long peak = g_heap_peak.load(std::memory_order_relaxed);
+    while (now > peak && !g_heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+static void heap_sub(void *p) {
+    if (p) {
+        g_heap.fetch_sub(static_cast<long long>(malloc_usable_size(p)));
+    }
+}
+
+extern "C" {
+void *malloc(std::size_t size) {
+    void *p = __libc_malloc(size);
+    heap_add(p);
+    return p;
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+    void *p = __libc_calloc(count, size);
+    heap_add(p);
+    return p;
+}
+
+void *realloc(void *old, std::size_t size) {
+    heap_sub(old);
+    void *p = __libc_realloc(old, size);
+    // При неудаче прежний блок остаётся занятым
+    heap_add(p ? p : (size ? old : nullptr));
+    return p;
+}
+
+void *memalign(std::size_t alignment, std::size_t size) {
+    void *p = __libc_memalign(alignment, size);
+    heap_add(p);
+    return p;
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size) {
+    void *p = memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void free(void *p) {
+    heap_sub(p);
+    __libc_free(p);
+}
+}
+
+// Прежняя реализация обработчика /articles: по запросу комментариев на каждую статью
+static std::string fetch_articles_loop(pqxx::transaction_base &tx) {
+    std::vector<crow::json::wvalue> articles_list;
+    pqxx::result articles = tx.exec("SELECT id, title, content FROM articles");
+    for (const auto &row : articles) {
+        crow::json::wvalue article_json;
+        int id = row[0].as<int>();
+        article_json["id"] = id;
+        article_json["title"] = row[1].c_str();
+        article_json["content"] = row[2].c_str();
+
+        pqxx::result comments = tx.exec_prepared("get_comments", id);
+        std::vector<crow::json::wvalue> comments_list;
+        for (const auto &c : comments) {
+            crow::json::wvalue cm;
+            cm["id"] = c[0].as<int>();
+            cm["content"] = c[1].c_str();
+            comments_list.push_back(cm);
+        }
+        article_json["comments"] = std::move(comments_list);
+        articles_list.push_back(article_json);
+    }
+    crow::json::wvalue result;
+    result["articles"] = std::move(articles_list);
+    return result.dump();
+}
+
+static void seed(pqxx::connection &conn, long articles, long comments_per_article) {
+    pqxx::work tx(conn);
+    tx.exec("CREATE TEMP TABLE articles (id serial PRIMARY KEY, title text NOT NULL, content text NOT NULL)");
+    tx.exec("CREATE TEMP TABLE comments (id serial PRIMARY KEY, article_id int NOT NULL, content text NOT NULL)");
+    tx.exec("INSERT INTO articles (title, content) "
+            "SELECT 'Article ' || g, repeat('Lorem ipsum dolor sit amet. ', 8) "
+            "FROM generate_series(1, " + std::to_string(articles) + ") g");
+    tx.exec("INSERT INTO comments (article_id, content) "
+            "SELECT a, 'Comment ' || c || ' on article ' || a "
+            "FROM generate_series(1, " + std::to_string(articles) + ") a, "
+            "generate_series(1, " + std::to_string(comments_per_article) + ") c");
+    tx.exec("CREATE INDEX ON comments (article_id)");
+    tx.commit();
+
+    pqxx::nontransaction analyze(conn);
+    analyze.exec("ANALYZE articles");
+    analyze.exec("ANALYZE comments");
+}
+
+struct Measurement {
+    double min_ms = 0;
+    double median_ms = 0;
+    std::size_t bytes = 0;
+    long long peak_heap_kb = 0; // наибольший за повторы
+};
+
+static Measurement measure(pqxx::connection &conn, long repeat,
+                           const std::function<std::string(pqxx::transaction_base &)> &fetch) {
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(repeat));
+    std::size_t bytes = 0;
+    long long peak_heap = 0;
+    for (long i = 0; i < repeat; ++i) {
+        const long long base = g_heap.load();
+        g_heap_peak.store(base);
+        auto start = std::chrono::steady_clock::now();
+        pqxx::work tx(conn);
+        bytes = fetch(tx).size();
+        tx.commit();
+        auto end = std::chrono::steady_clock::now();
+        peak_heap = std::max(peak_heap, g_heap_peak.load() - base);
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return {samples.front(), samples[samples.size() / 2], bytes, peak_heap / 1024};
+}
+
+int main(int argc, char **argv) {
+    const std::string conn_str = env_string("BENCH_DB_CONN", env_string("DB_CONN", "dbname=blogdb user=bloguser"));
+    const long comments_per_article = env_long("BENCH_COMMENTS", 3);
+    const long repeat = std::max(1L, env_long("BENCH_REPEAT", 5));
+
+    std::vector<long> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(std::stol(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {100, 10000, 100000};
+    }
+
+    std::printf("%-10s %-8s %12s %12s %12s %12s %14s\n",
+                "articles", "mode", "round_trips", "min_ms", "median_ms", "bytes", "peak_heap_kb");
+    try {
+        for (long n : sizes) {
+            // Новое соединение на каждый размер: свои временные таблицы и подготовленные запросы
+            pqxx::connection conn(conn_str);
+            seed(conn, n, comments_per_article);
+            prepare_article_statements(conn);
+
+            struct Mode {
+                const char *name;
+                long round_trips;
+                std::function<std::string(pqxx::transaction_base &)> fetch;
+            };
+            const std::vector<Mode> modes = {
+                {"loop", 1 + n, fetch_articles_loop},
+                {"grouped", 2, [](pqxx::transaction_base &tx) {
+                     std::string out;
+                     fetch_articles_json(tx, ArticleListMode::Grouped, out);
+                     return out;
+                 }},
+                {"pg_json", 1, [](pqxx::transaction_base &tx) {
+                     std::string out;
+                     fetch_articles_json(tx, ArticleListMode::PgJson, out);
+                     return out;
+                 }},
+                {"stream", 1, [](pqxx::transaction_base &tx) {
+                     std::string out;
+                     fetch_articles_json(tx, ArticleListMode::Stream, out);
+                     return out;
+                 }},
+            };
+            for (const auto &mode : modes) {
+                Measurement m = measure(conn, repeat, mode.fetch);
+                std::printf("%-10ld %-8s %12ld %12.2f %12.2f %12zu %14lld\n",
+                            n, mode.name, mode.round_trips, m.min_ms, m.median_ms, m.bytes, m.peak_heap_kb);
+            }
+        }
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
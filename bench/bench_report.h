@@ -0,0 +1,147 @@
+// bench/bench_report.h
+//
+// Результаты бенчмарка в JSON для сравнения между коммитами (bench/compare_results.py):
+//   {"bench": "...", "commit": "...", "timestamp": "...", "params": {...},
+//    "results": [{"name": "...", "ns_per_op": 12.3, ...}, ...]}
+// commit берётся из BENCH_COMMIT, иначе из git rev-parse текущего каталога.
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/json_writer.h"
+
+class BenchReport {
+public:
+    // Числовые показатели одного замера, по порядку добавления
+    class Result {
+    public:
+        explicit Result(std::string name) : name_(std::move(name)) {}
+
+        Result &set(std::string key, double value) {
+            values_.emplace_back(std::move(key), value);
+            return *this;
+        }
+
+        const std::string &name() const { return name_; }
+        const std::vector<std::pair<std::string, double>> &values() const { return values_; }
+
+    private:
+        std::string name_;
+        std::vector<std::pair<std::string, double>> values_;
+    };
+
+    explicit BenchReport(std::string bench) : bench_(std::move(bench)) {}
+
+    void param(std::string key, long long value) { params_.emplace_back(std::move(key), std::to_string(value)); }
+    void param(std::string key, long value) { param(std::move(key), static_cast<long long>(value)); }
+    void param(std::string key, int value) { param(std::move(key), static_cast<long long>(value)); }
+
+    void param(std::string key, std::string_view value) {
+        std::string json;
+        JsonWriter(json).value(value);
+        params_.emplace_back(std::move(key), std::move(json));
+    }
+
+    void param(std::string key, double value) { params_.emplace_back(std::move(key), format_number(value)); }
+
+    Result &result(std::string name) {
+        results_.emplace_back(std::move(name));
+        return results_.back();
+    }
+
+    std::string to_json() const {
+        std::string out;
+        JsonWriter json(out);
+        json.begin_object();
+        json.key("bench").value(bench_);
+        json.key("commit").value(commit());
+        json.key("timestamp").value(timestamp());
+        json.key("params").begin_object();
+        for (const auto &[key, value] : params_) {
+            json.key(key).raw(value);
+        }
+        json.end_object();
+        json.key("results").begin_array();
+        for (const Result &result : results_) {
+            json.begin_object().key("name").value(result.name());
+            for (const auto &[key, value] : result.values()) {
+                json.key(key).raw(format_number(value));
+            }
+            json.end_object();
+        }
+        json.end_array().end_object();
+        out += '\n';
+        return out;
+    }
+
+    // Пишет JSON в path ("-" — stdout); пустой path — ничего не пишет
+    bool write(const std::string &path) const {
+        if (path.empty()) {
+            return true;
+        }
+        const std::string json = to_json();
+        if (path == "-") {
+            std::fwrite(json.data(), 1, json.size(), stdout);
+            return true;
+        }
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return false;
+        }
+        std::fwrite(json.data(), 1, json.size(), file);
+        std::fclose(file);
+        std::fprintf(stderr, "Results written to %s\n", path.c_str());
+        return true;
+    }
+
+private:
+    static std::string format_number(double value) {
+        if (!std::isfinite(value)) {
+            return "null";
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", value);
+        return buf;
+    }
+
+    static std::string commit() {
+        std::string commit = env_string("BENCH_COMMIT", "");
+        if (!commit.empty()) {
+            return commit;
+        }
+        if (std::FILE *git = popen("git rev-parse --short HEAD 2>/dev/null", "r")) {
+            char buf[64] = {};
+            if (std::fgets(buf, sizeof(buf), git)) {
+                commit = buf;
+                while (!commit.empty() && (commit.back() == '\n' || commit.back() == '\r')) {
+                    commit.pop_back();
+                }
+            }
+            pclose(git);
+        }
+        return commit.empty() ? "unknown" : commit;
+    }
+
+    static std::string timestamp() {
+        const std::time_t now = std::time(nullptr);
+        std::tm tm{};
+        gmtime_r(&now, &tm);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        return buf;
+    }
+
+    std::string bench_;
+    std::vector<std::pair<std::string, std::string>> params_; // значения — готовый JSON
+    std::deque<Result> results_; // deque: ссылки из result() не инвалидируются
+};
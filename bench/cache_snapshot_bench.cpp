@@ -0,0 +1,129 @@
+// bench/cache_snapshot_bench.cpp
+//
+// Снимок кеша для тёплого рестарта (src/cache_snapshot.h) без сервиса: запись
+// BENCH_ENTRIES записей по BENCH_VALUE_BYTES байт, затем повтор старта — open() (mmap и
+// индекс по заголовкам записей) и первое попадание take(), то есть время от старта до
+// первого тёплого ответа без учёта самого сервиса; затем take() всех остальных ключей
+// (копирование из отображения с проверкой CRC). Перед каждым повтором файл
+// вытесняется из page cache (posix_fadvise), чтобы старт был холодным, как после
+// перезагрузки; BENCH_DROP_CACHE=off — файл остаётся в памяти, как при перезапуске
+// процесса.
+//
+// Запуск: cache_snapshot_bench
+// Переменные: BENCH_ENTRIES (10000), BENCH_VALUE_BYTES (2048), BENCH_REPEAT (5),
+//             BENCH_SNAPSHOT_FILE (/tmp/cache_snapshot_bench.bin), BENCH_DROP_CACHE (on),
+//             BENCH_OUTPUT.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/cache_snapshot.h"
+#include "../src/config.h"
+#include "bench_report.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void drop_page_cache(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+int main() {
+    const std::size_t count = static_cast<std::size_t>(std::max(1L, env_long("BENCH_ENTRIES", 10000)));
+    const std::size_t value_bytes = static_cast<std::size_t>(std::max(1L, env_long("BENCH_VALUE_BYTES", 2048)));
+    const int repeat = static_cast<int>(std::max(1L, env_long("BENCH_REPEAT", 5)));
+    const std::string path = env_string("BENCH_SNAPSHOT_FILE", "/tmp/cache_snapshot_bench.bin");
+    const bool drop_cache = env_string("BENCH_DROP_CACHE", "on") == "on";
+
+    BenchReport report("cache_snapshot_bench");
+    report.param("entries", static_cast<long long>(count));
+    report.param("value_bytes", static_cast<long long>(value_bytes));
+    report.param("drop_cache", drop_cache ? "on" : "off");
+
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back("article:" + std::to_string(i + 1));
+        std::string value = keys.back();
+        value.resize(value_bytes, 'x');
+        values.push_back(std::move(value));
+    }
+    const std::int64_t expires = CacheSnapshot::now_ms() + 3600 * 1000;
+    std::vector<CacheSnapshot::Entry> entries;
+    for (std::size_t i = 0; i < count; ++i) {
+        entries.push_back({keys[i], values[i], expires});
+    }
+
+    std::vector<double> write_ms, open_ms, first_hit_ms, take_all_ms;
+    std::size_t bytes = 0;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = Clock::now();
+        bytes = CacheSnapshot::write(path, entries);
+        write_ms.push_back(elapsed_ms(start));
+        if (drop_cache) {
+            drop_page_cache(path);
+        }
+
+        CacheSnapshot snapshot;
+        start = Clock::now();
+        if (!snapshot.open(path, std::chrono::hours(1))) {
+            std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+            return 1;
+        }
+        open_ms.push_back(elapsed_ms(start));
+        std::chrono::milliseconds ttl{0};
+        // Первым приходит самый горячий ключ — он и в снимке первый
+        if (!snapshot.take(keys[0], ttl)) {
+            std::fprintf(stderr, "First key is missing from the snapshot\n");
+            return 1;
+        }
+        first_hit_ms.push_back(elapsed_ms(start));
+
+        const auto take_start = Clock::now();
+        std::size_t found = 1;
+        for (std::size_t i = 1; i < count; ++i) {
+            found += snapshot.take(keys[i], ttl) != nullptr;
+        }
+        take_all_ms.push_back(elapsed_ms(take_start));
+        if (found != count || snapshot.stats().corrupt != 0) {
+            std::fprintf(stderr, "Snapshot returned %zu of %zu entries\n", found, count);
+            return 1;
+        }
+    }
+    std::remove(path.c_str());
+
+    auto best = [](std::vector<double> v) { return *std::min_element(v.begin(), v.end()); };
+    auto median = [](std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        return v[v.size() / 2];
+    };
+    std::printf("%zu entries x %zu bytes, file %.1f MB, page cache %s\n", count, value_bytes, bytes / 1e6,
+                drop_cache ? "dropped" : "kept");
+    std::printf("%-14s %10s %10s\n", "stage", "best_ms", "median_ms");
+    const struct {
+        const char *name;
+        const std::vector<double> &ms;
+    } stages[] = {{"write", write_ms}, {"open", open_ms}, {"first_hit", first_hit_ms}, {"take_all", take_all_ms}};
+    for (const auto &stage : stages) {
+        std::printf("%-14s %10.3f %10.3f\n", stage.name, best(stage.ms), median(stage.ms));
+        BenchReport::Result &result = report.result(stage.name);
+        result.set("ms", best(stage.ms)).set("median_ms", median(stage.ms));
+        if (&stage.ms == &take_all_ms) {
+            result.set("entries_per_s", count * 1000.0 / best(take_all_ms));
+        }
+    }
+    return report.write(env_string("BENCH_OUTPUT", "")) ? 0 : 1;
+}
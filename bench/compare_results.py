@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# bench/compare_results.py
+#
+# Сравнение двух JSON-отчётов бенчмарков (bench_report.h), например одного замера на
+# двух коммитах:
+#   python3 bench/compare_results.py base.json new.json --threshold 5
+# Печатает показатели обоих отчётов и разницу в процентах; ухудшение больше threshold
+# процентов помечается, и скрипт завершается с кодом 1.
+# Показатели *_per_s — чем больше, тем лучше; requests, bytes — справочные; остальные
+# (время, ошибки) — чем меньше, тем лучше.
+
+import argparse
+import json
+import sys
+
+NEUTRAL = {'requests', 'bytes'}
+
+
+def higher_is_better(metric):
+    return metric.endswith('_per_s')
+
+
+def load(path):
+    with open(path, 'r') as f:
+        report = json.load(f)
+    results = {r['name']: r for r in report.get('results', [])}
+    return report, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Сравнение результатов бенчмарков.")
+    parser.add_argument('base', help='Отчёт, с которым сравнивается (например, с main)')
+    parser.add_argument('new', help='Новый отчёт')
+    parser.add_argument('--threshold', type=float, default=5.0, help='Допустимое ухудшение, %%')
+    args = parser.parse_args()
+
+    base_report, base = load(args.base)
+    new_report, new = load(args.new)
+    if base_report.get('bench') != new_report.get('bench'):
+        print(f"warning: comparing {base_report.get('bench')} with {new_report.get('bench')}")
+    if base_report.get('params') != new_report.get('params'):
+        print(f"warning: parameters differ: {base_report.get('params')} vs {new_report.get('params')}")
+
+    print(f"{base_report.get('bench')}: {base_report.get('commit')} -> {new_report.get('commit')}")
+    print(f"{'result':<22} {'metric':<18} {'base':>12} {'new':>12} {'change':>9}")
+    regressions = 0
+    for name, new_result in new.items():
+        base_result = base.get(name)
+        if base_result is None:
+            print(f"{name:<22} (new)")
+            continue
+        for metric, value in new_result.items():
+            old = base_result.get(metric)
+            if metric == 'name' or not isinstance(value, (int, float)) or not isinstance(old, (int, float)):
+                continue
+            if old:
+                change = (value - old) * 100.0 / old
+            else:
+                # С нуля любое изменение — бесконечное: 0 -> 3 ошибки это ухудшение, а не 0%
+                change = 0.0 if value == old else (float('inf') if value > old else float('-inf'))
+            worse = -change if higher_is_better(metric) else change
+            mark = ''
+            if metric not in NEUTRAL and worse > args.threshold:
+                mark = '  REGRESSION'
+                regressions += 1
+            elif metric not in NEUTRAL and worse < -args.threshold:
+                mark = '  improved'
+            print(f"{name:<22} {metric:<18} {old:>12.4g} {value:>12.4g} {change:>+8.1f}%{mark}")
+    for name in base:
+        if name not in new:
+            print(f"{name:<22} (missing in new)")
+
+    if regressions:
+        print(f"{regressions} metric(s) regressed by more than {args.threshold}%")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
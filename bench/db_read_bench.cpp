@@ -0,0 +1,163 @@
+// bench/db_read_bench.cpp
+//
+// Задержка одного промаха кеша (чтение из БД) при разных способах отправки запросов:
+//   work       — прежний путь: pqxx::work и запросы по одному (BEGIN, запросы, COMMIT);
+//   sequential — ReadTransaction без BEGIN/COMMIT, запросы по одному (DbReadMode::Sequential);
+//   pipeline   — ReadTransaction, все запросы одной отправкой (DbReadMode::Pipeline).
+// Замеряются чтение статьи (как /article/{id}) и страницы списка (как /articles?limit=).
+// Столбец p50_rtt — p50 чтения в p50 пустого запроса: при задержке netem, много большей
+// времени выполнения запросов, это замеренное число сетевых кругов на чтение.
+//
+// Разница видна при сетевой задержке, поэтому на локальной машине её добавляют netem
+// (задержка действует в обе стороны, круг на loopback — 2 × delay):
+//   sudo tc qdisc add dev lo root netem delay 1ms
+//   ./db_read_bench
+//   sudo tc qdisc del dev lo root
+//
+// Данные создаются во временных таблицах сессии, как в articles_fetch_bench.
+//
+// Запуск: db_read_bench
+// Переменные: BENCH_DB_CONN (или DB_CONN), BENCH_ARTICLES (10000), BENCH_COMMENTS (3),
+//             BENCH_REPEAT (чтений на замер, 1000), BENCH_PAGE_LIMIT (20).
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/article_queries.h"
+#include "../src/config.h"
+
+static void seed(pqxx::connection &conn, long articles, long comments_per_article) {
+    pqxx::work tx(conn);
+    tx.exec("CREATE TEMP TABLE articles (id serial PRIMARY KEY, title text NOT NULL, content text NOT NULL)");
+    tx.exec("CREATE TEMP TABLE comments (id serial PRIMARY KEY, article_id int NOT NULL, content text NOT NULL)");
+    tx.exec("INSERT INTO articles (title, content) "
+            "SELECT 'Article ' || g, repeat('Lorem ipsum dolor sit amet. ', 8) "
+            "FROM generate_series(1, " + std::to_string(articles) + ") g");
+    tx.exec("INSERT INTO comments (article_id, content) "
+            "SELECT a, 'Comment ' || c || ' on article ' || a "
+            "FROM generate_series(1, " + std::to_string(articles) + ") a, "
+            "generate_series(1, " + std::to_string(comments_per_article) + ") c");
+    tx.exec("CREATE INDEX ON comments (article_id)");
+    tx.commit();
+
+    pqxx::nontransaction analyze(conn);
+    analyze.exec("ANALYZE articles");
+    analyze.exec("ANALYZE comments");
+}
+
+struct Measurement {
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double mean_ms = 0;
+};
+
+// repeat чтений read(conn, arg) со случайным arg из [1, max_arg]
+static Measurement measure(pqxx::connection &conn, long repeat, int max_arg,
+                           const std::function<void(pqxx::connection &, int)> &read) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> arg(1, max_arg);
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(repeat));
+    for (long i = 0; i < repeat; ++i) {
+        const int value = arg(rng);
+        const auto start = std::chrono::steady_clock::now();
+        read(conn, value);
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double s : samples) {
+        sum += s;
+    }
+    return {samples[samples.size() / 2], samples[samples.size() * 99 / 100], sum / static_cast<double>(samples.size())};
+}
+
+// Чтение в транзакции Tx тем же кодом, что и у сервиса
+template <typename Tx, typename Fetch>
+static void read_in(pqxx::connection &conn, Fetch &&fetch) {
+    Tx tx(conn);
+    std::string out;
+    fetch(tx, out);
+    tx.commit();
+}
+
+int main() {
+    const std::string conn_str = env_string("BENCH_DB_CONN", env_string("DB_CONN", "dbname=blogdb user=bloguser"));
+    const long articles = std::max(1L, env_long("BENCH_ARTICLES", 10000));
+    const long comments_per_article = env_long("BENCH_COMMENTS", 3);
+    const long repeat = std::max(1L, env_long("BENCH_REPEAT", 1000));
+    const int page_limit = static_cast<int>(std::max(1L, env_long("BENCH_PAGE_LIMIT", 20)));
+
+    try {
+        pqxx::connection conn(conn_str);
+        seed(conn, articles, comments_per_article);
+        prepare_article_statements(conn);
+
+        // Базовая задержка круга: пустой запрос вне транзакции
+        const Measurement ping = measure(conn, repeat, 1, [](pqxx::connection &c, int) {
+            pqxx::nontransaction tx(c);
+            tx.exec("SELECT 1");
+        });
+        std::printf("articles=%ld comments/article=%ld repeat=%ld round_trip_p50=%.3fms\n", articles,
+                    comments_per_article, repeat, ping.p50_ms);
+        std::printf("%-8s %-11s %10s %10s %10s %10s\n", "read", "mode", "p50_rtt", "p50_ms", "p99_ms", "mean_ms");
+
+        struct Mode {
+            const char *read;
+            const char *name;
+            int max_arg;
+            std::function<void(pqxx::connection &, int)> fn;
+        };
+        const int max_after = static_cast<int>(std::max(0L, articles - page_limit));
+        const std::vector<Mode> modes = {
+            {"article", "work", static_cast<int>(articles), [](pqxx::connection &c, int id) {
+                 read_in<pqxx::work>(c, [id](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_article(tx, id, out, DbReadMode::Sequential);
+                 });
+             }},
+            {"article", "sequential", static_cast<int>(articles), [](pqxx::connection &c, int id) {
+                 read_in<ReadTransaction>(c, [id](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_article(tx, id, out, DbReadMode::Sequential);
+                 });
+             }},
+            {"article", "pipeline", static_cast<int>(articles), [](pqxx::connection &c, int id) {
+                 read_in<ReadTransaction>(c, [id](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_article(tx, id, out, DbReadMode::Pipeline);
+                 });
+             }},
+            {"page", "work", max_after + 1, [page_limit](pqxx::connection &c, int after) {
+                 read_in<pqxx::work>(c, [&](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_articles_page_json(tx, after - 1, page_limit, out, DbReadMode::Sequential);
+                 });
+             }},
+            {"page", "sequential", max_after + 1, [page_limit](pqxx::connection &c, int after) {
+                 read_in<ReadTransaction>(c, [&](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_articles_page_json(tx, after - 1, page_limit, out, DbReadMode::Sequential);
+                 });
+             }},
+            {"page", "pipeline", max_after + 1, [page_limit](pqxx::connection &c, int after) {
+                 read_in<ReadTransaction>(c, [&](pqxx::transaction_base &tx, std::string &out) {
+                     fetch_articles_page_json(tx, after - 1, page_limit, out, DbReadMode::Pipeline);
+                 });
+             }},
+        };
+        for (const auto &mode : modes) {
+            const Measurement m = measure(conn, repeat, mode.max_arg, mode.fn);
+            const double rtt = ping.p50_ms > 0 ? m.p50_ms / ping.p50_ms : 0;
+            std::printf("%-8s %-11s %10.2f %10.3f %10.3f %10.3f\n", mode.read, mode.name, rtt, m.p50_ms, m.p99_ms,
+                        m.mean_ms);
+        }
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
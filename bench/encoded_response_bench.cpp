@@ -0,0 +1,91 @@
+// bench/encoded_response_bench.cpp
+//
+// Стоимость попадания в кеш и размер ответа до и после хранения закодированных записей:
+//   raw         — прежний путь: копия JSON из кеша в тело ответа;
+//   entry       — decode_entry + выбор варианта по Accept-Encoding + копия варианта;
+//   gzip/request — для сравнения: сжатие gzip на каждый запрос.
+// Ответ — синтетический список статей того же вида, что отдаёт GET /articles.
+//
+// Запуск: encoded_response_bench [статей] [итераций]   (по умолчанию 100 и 20000)
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "../src/encoded_response.h"
+
+static std::string make_articles_json(int articles, int comments_per_article) {
+    std::string out = "{\"articles\":[";
+    int comment_id = 1;
+    for (int a = 1; a <= articles; ++a) {
+        if (a > 1) {
+            out += ',';
+        }
+        out += "{\"id\":" + std::to_string(a) + ",\"title\":\"Article " + std::to_string(a) +
+               "\",\"content\":\"Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed do eiusmod "
+               "tempor incididunt ut labore et dolore magna aliqua.\",\"comments\":[";
+        for (int c = 0; c < comments_per_article; ++c) {
+            if (c > 0) {
+                out += ',';
+            }
+            out += "{\"id\":" + std::to_string(comment_id++) + ",\"content\":\"Comment " + std::to_string(c) +
+                   " on article " + std::to_string(a) + "\"}";
+        }
+        out += "]}";
+    }
+    out += "]}";
+    return out;
+}
+
+template <typename Fn>
+static double ops_per_second(long iterations, Fn &&fn) {
+    std::size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        sink += fn();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 0) {
+        std::puts("");
+    }
+    return iterations / seconds;
+}
+
+int main(int argc, char **argv) {
+    const int articles = argc > 1 ? std::atoi(argv[1]) : 100;
+    const long iterations = argc > 2 ? std::atol(argv[2]) : 20000;
+
+    const std::string json = make_articles_json(articles, 3);
+    const std::string entry = encode_entry(json);
+    const EncodedView view = decode_entry(entry);
+
+    std::printf("articles=%d json=%zu gzip=%zu br=%zu zstd=%zu entry=%zu bytes\n",
+                articles, json.size(), view.gzip.size(), view.br.size(), view.zstd.size(), entry.size());
+
+    double raw = ops_per_second(iterations, [&] {
+        std::string body(json);
+        return body.size();
+    });
+    double identity = ops_per_second(iterations, [&] {
+        std::string_view encoding;
+        EncodedView v = decode_entry(entry);
+        std::string body(choose_encoding(v, "", encoding));
+        return body.size();
+    });
+    double gzip = ops_per_second(iterations, [&] {
+        std::string_view encoding;
+        EncodedView v = decode_entry(entry);
+        std::string body(choose_encoding(v, "gzip, deflate", encoding));
+        return body.size();
+    });
+    double gzip_per_request = ops_per_second(iterations / 100 + 1, [&] {
+        return gzip_compress(json, 6).size();
+    });
+
+    std::printf("%-22s %14s %16s\n", "path", "hits/s", "bytes/response");
+    std::printf("%-22s %14.0f %16zu\n", "raw (before)", raw, json.size());
+    std::printf("%-22s %14.0f %16zu\n", "entry identity", identity, view.identity.size());
+    std::printf("%-22s %14.0f %16zu\n", "entry gzip", gzip, view.gzip.size());
+    std::printf("%-22s %14.0f %16zu\n", "gzip per request", gzip_per_request, view.gzip.size());
+    return 0;
+}
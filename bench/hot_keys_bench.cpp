@@ -0,0 +1,175 @@
+// bench/hot_keys_bench.cpp
+//
+// Модель кеша под нагрузкой с распределением Ципфа: BENCH_REQUESTS обращений к
+// BENCH_KEYS ключам (ранг r выбирается с вероятностью ~ 1 / r^BENCH_ZIPF_S) при
+// BENCH_RPS запросах в секунду модельного времени. Кеш вмещает BENCH_CAPACITY записей
+// (как Redis с maxmemory: LRU-вытеснение), запись живёт BENCH_TTL секунд. Сравниваются:
+//   fixed    — каждый промах кладётся в кеш с одинаковым TTL;
+//   adaptive — HotKeyTracker (как в сервисе): холодные ключи (< BENCH_ADMIT_MIN_HITS
+//              обращений за окно) не кладутся, горячие (>= BENCH_HOT_MIN_HITS) живут
+//              в BENCH_HOT_TTL_FACTOR раз дольше.
+// Печатаются доля попаданий, обращений к БД на 1000 запросов, вытеснений и средний
+// размер кеша, а также первые ключи отчёта top-K против точных частот.
+//
+// Запуск: hot_keys_bench
+// Переменные: BENCH_KEYS (100000), BENCH_REQUESTS (5000000), BENCH_ZIPF_S (0.99),
+//             BENCH_RPS (5000), BENCH_CAPACITY (10000), BENCH_TTL (60),
+//             BENCH_ADMIT_MIN_HITS (2), BENCH_HOT_MIN_HITS (16), BENCH_HOT_TTL_FACTOR (4).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/hot_keys.h"
+#include "zipf.h"
+
+// Кеш фиксированной ёмкости с LRU и TTL в модельном времени
+class SimulatedCache {
+public:
+    explicit SimulatedCache(std::size_t capacity) : capacity_(capacity) {}
+
+    bool get(std::size_t key, double now) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        if (it->second->expires <= now) {
+            lru_.erase(it->second);
+            index_.erase(it);
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return true;
+    }
+
+    void put(std::size_t key, double expires) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            it->second->expires = expires;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return;
+        }
+        if (index_.size() >= capacity_) {
+            index_.erase(lru_.back().key);
+            lru_.pop_back();
+            ++evictions;
+        }
+        lru_.push_front({key, expires});
+        index_[key] = lru_.begin();
+    }
+
+    std::size_t size() const { return index_.size(); }
+
+    std::uint64_t evictions = 0;
+
+private:
+    struct Entry {
+        std::size_t key;
+        double expires;
+    };
+    const std::size_t capacity_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::size_t, std::list<Entry>::iterator> index_;
+};
+
+struct Result {
+    double hit_rate = 0;
+    double db_per_1000 = 0;
+    std::uint64_t evictions = 0;
+    double avg_size = 0;
+};
+
+int main() {
+    const std::size_t keys = static_cast<std::size_t>(std::max(1L, env_long("BENCH_KEYS", 100000)));
+    const long requests = std::max(1L, env_long("BENCH_REQUESTS", 5000000));
+    const double zipf_s = std::strtod(env_string("BENCH_ZIPF_S", "0.99").c_str(), nullptr);
+    const double rps = static_cast<double>(std::max(1L, env_long("BENCH_RPS", 5000)));
+    const std::size_t capacity = static_cast<std::size_t>(std::max(1L, env_long("BENCH_CAPACITY", 10000)));
+    const double ttl = static_cast<double>(std::max(1L, env_long("BENCH_TTL", 60)));
+    const double hot_factor = static_cast<double>(std::max(1L, env_long("BENCH_HOT_TTL_FACTOR", 4)));
+
+    HotKeyTracker::Options options;
+    options.admit_min_hits = static_cast<std::uint32_t>(env_long("BENCH_ADMIT_MIN_HITS", 2));
+    options.hot_min_hits = static_cast<std::uint32_t>(env_long("BENCH_HOT_MIN_HITS", 16));
+    options.top_k = 10;
+
+    ZipfGenerator zipf(keys, zipf_s);
+    std::printf("keys=%zu requests=%ld zipf_s=%.2f rps=%.0f capacity=%zu ttl=%.0fs\n", keys, requests, zipf_s, rps,
+                capacity, ttl);
+    std::printf("%-9s %10s %10s %12s %10s\n", "policy", "hit_rate", "db/1000", "evictions", "avg_size");
+
+    std::vector<std::uint64_t> exact(keys);
+    std::vector<HotKeyTracker::HotKey> top;
+    for (const bool adaptive : {false, true}) {
+        std::mt19937_64 rng(42); // одна и та же последовательность запросов для обеих политик
+        SimulatedCache cache(capacity);
+        HotKeyTracker tracker(options);
+        std::uint64_t hits = 0;
+        std::uint64_t db = 0;
+        double size_sum = 0;
+        for (long i = 0; i < requests; ++i) {
+            const double now = static_cast<double>(i) / rps;
+            const std::size_t key = zipf(rng);
+            const std::string name = "article:" + std::to_string(key + 1);
+            if (adaptive) {
+                tracker.record(name);
+                tracker.age_if_due(); // в сервисе — фоновая задача раз в 100 мс
+            }
+            else {
+                ++exact[key];
+            }
+            if (cache.get(key, now)) {
+                ++hits;
+            }
+            else {
+                ++db;
+                double key_ttl = ttl;
+                bool store = true;
+                if (adaptive) {
+                    switch (tracker.temperature(name)) {
+                        case HotKeyTracker::Temperature::Cold:
+                            store = false;
+                            break;
+                        case HotKeyTracker::Temperature::Hot:
+                            key_ttl *= hot_factor;
+                            break;
+                        case HotKeyTracker::Temperature::Warm:
+                            break;
+                    }
+                }
+                if (store) {
+                    cache.put(key, now + key_ttl);
+                }
+            }
+            if ((i & 1023) == 0) {
+                size_sum += static_cast<double>(cache.size());
+            }
+        }
+        Result r;
+        r.hit_rate = static_cast<double>(hits) / requests;
+        r.db_per_1000 = 1000.0 * static_cast<double>(db) / requests;
+        r.evictions = cache.evictions;
+        r.avg_size = size_sum / static_cast<double>((requests + 1023) / 1024);
+        std::printf("%-9s %9.2f%% %10.1f %12llu %10.0f\n", adaptive ? "adaptive" : "fixed", 100.0 * r.hit_rate,
+                    r.db_per_1000, static_cast<unsigned long long>(r.evictions), r.avg_size);
+        if (adaptive) {
+            top = tracker.top(options.top_k);
+        }
+    }
+
+    // Отчёт top-K оценивает частоту за последнее окно sketch, поэтому сравнивается
+    // порядок ключей, а не абсолютные значения
+    std::printf("\ntop-%zu (sketch estimate / exact total):\n", options.top_k);
+    for (const auto &hot : top) {
+        const std::size_t rank = std::strtoul(hot.key.c_str() + 8, nullptr, 10);
+        std::printf("  %-16s %8u %10llu\n", hot.key.c_str(), hot.hits,
+                    static_cast<unsigned long long>(exact[rank - 1]));
+    }
+    return 0;
+}
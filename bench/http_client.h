@@ -0,0 +1,203 @@
+// bench/http_client.h
+//
+// Минимальный блокирующий HTTP/1.1-клиент для бенчмарков: одно keep-alive соединение,
+// запросы без тела или с JSON-телом, ответы с Content-Length или chunked. При обрыве
+// соединение открывается заново при следующем запросе.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+class HttpClient {
+public:
+    struct Response {
+        int status = 0;
+        std::string body;
+    };
+
+    HttpClient(std::string host, int port) : host_(std::move(host)), port_(port) {}
+
+    ~HttpClient() { close_socket(); }
+
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    Response get(const std::string &path) { return request("GET", path, {}); }
+
+    Response post(const std::string &path, std::string_view json) { return request("POST", path, json); }
+
+    // Запрос; один повтор, если сервер закрыл простаивавшее keep-alive соединение
+    Response request(const char *method, const std::string &path, std::string_view body) {
+        for (int attempt = 0;; ++attempt) {
+            try {
+                return request_once(method, path, body);
+            }
+            catch (const std::runtime_error &) {
+                close_socket();
+                if (attempt > 0) {
+                    throw;
+                }
+            }
+        }
+    }
+
+private:
+    Response request_once(const char *method, const std::string &path, std::string_view body) {
+        if (fd_ < 0) {
+            connect_socket();
+        }
+        std::string req;
+        req.reserve(128 + path.size() + body.size());
+        req += method;
+        req += ' ';
+        req += path;
+        req += " HTTP/1.1\r\nHost: ";
+        req += host_;
+        req += "\r\n";
+        if (!body.empty()) {
+            req += "Content-Type: application/json\r\nContent-Length: ";
+            req += std::to_string(body.size());
+            req += "\r\n";
+        }
+        req += "\r\n";
+        req.append(body);
+        send_all(req);
+
+        Response res;
+        const std::string head = read_until("\r\n\r\n");
+        if (head.compare(0, 5, "HTTP/") != 0 || head.size() < 12) {
+            throw std::runtime_error("Malformed HTTP response");
+        }
+        res.status = std::atoi(head.c_str() + 9);
+
+        const std::string lower = to_lower(head);
+        if (lower.find("transfer-encoding: chunked") != std::string::npos) {
+            read_chunked(res.body);
+        }
+        else {
+            const std::size_t pos = lower.find("content-length:");
+            const std::size_t length = pos == std::string::npos ? 0 : std::strtoul(head.c_str() + pos + 15, nullptr, 10);
+            read_exact(length, res.body);
+        }
+        if (lower.find("connection: close") != std::string::npos) {
+            close_socket();
+        }
+        return res;
+    }
+
+    void connect_socket() {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addrs = nullptr;
+        if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addrs) != 0) {
+            throw std::runtime_error("Cannot resolve " + host_);
+        }
+        for (addrinfo *a = addrs; a; a = a->ai_next) {
+            const int fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+                const int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fd_ = fd;
+                break;
+            }
+            ::close(fd);
+        }
+        freeaddrinfo(addrs);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot connect to " + host_ + ":" + std::to_string(port_));
+        }
+        buffer_.clear();
+    }
+
+    void close_socket() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        buffer_.clear();
+    }
+
+    void send_all(const std::string &data) {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t n = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                throw std::runtime_error("HTTP send failed");
+            }
+            sent += static_cast<std::size_t>(n);
+        }
+    }
+
+    void fill() {
+        char chunk[16384];
+        const ssize_t n = ::recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            throw std::runtime_error("HTTP connection closed");
+        }
+        buffer_.append(chunk, static_cast<std::size_t>(n));
+    }
+
+    std::string read_until(const char *delimiter) {
+        std::size_t pos;
+        while ((pos = buffer_.find(delimiter)) == std::string::npos) {
+            fill();
+        }
+        const std::size_t end = pos + std::strlen(delimiter);
+        std::string head = buffer_.substr(0, end);
+        buffer_.erase(0, end);
+        return head;
+    }
+
+    void read_exact(std::size_t length, std::string &out) {
+        while (buffer_.size() < length) {
+            fill();
+        }
+        out.append(buffer_, 0, length);
+        buffer_.erase(0, length);
+    }
+
+    void read_chunked(std::string &out) {
+        while (true) {
+            const std::string size_line = read_until("\r\n");
+            const std::size_t size = std::strtoul(size_line.c_str(), nullptr, 16);
+            if (size == 0) {
+                read_until("\r\n");
+                return;
+            }
+            read_exact(size, out);
+            std::string crlf;
+            read_exact(2, crlf);
+        }
+    }
+
+    static std::string to_lower(std::string text) {
+        for (char &c : text) {
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        return text;
+    }
+
+    const std::string host_;
+    const int port_;
+    int fd_ = -1;
+    std::string buffer_;
+};
@@ -0,0 +1,181 @@
+// bench/json_writer_bench.cpp
+//
+// Стоимость сериализации ответа /articles в памяти, без БД:
+//   wvalue — прежний путь: дерево crow::json::wvalue на каждую статью и комментарий, затем dump();
+//   writer — JsonWriter прямо в переиспользуемый буфер (ScratchBuffer).
+// Для каждого способа печатаются нс на статью и на комментарий (время делится на число
+// статей + комментариев), число выделений памяти на ответ и размер ответа.
+//
+// Перед замером экранирование json_escape_append сверяется с crow::json::escape на
+// случайных строках (включая управляющие символы, кавычки и UTF-8): вывод должен совпадать
+// байт в байт.
+//
+// Запуск: json_writer_bench [N ...]   (по умолчанию 100 10000)
+// Переменные: BENCH_COMMENTS (комментариев на статью, 3), BENCH_REPEAT (повторов, 20).
+
+#include <crow.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/json_writer.h"
+
+// Подсчёт выделений памяти во всей программе
+static std::atomic<unsigned long long> g_allocations{0};
+
+void *operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct Comment {
+    int id;
+    std::string content;
+};
+
+struct Article {
+    int id;
+    std::string title;
+    std::string content;
+    std::vector<Comment> comments;
+};
+
+static std::vector<Article> make_articles(long count, long comments_per_article) {
+    std::vector<Article> articles;
+    articles.reserve(count);
+    int comment_id = 1;
+    for (long i = 1; i <= count; ++i) {
+        Article a{static_cast<int>(i), "Article " + std::to_string(i), {}, {}};
+        for (int k = 0; k < 8; ++k) {
+            a.content += "Lorem ipsum dolor sit amet. ";
+        }
+        for (long c = 1; c <= comments_per_article; ++c) {
+            a.comments.push_back({comment_id++, "Comment " + std::to_string(c) + " on \"article\" " + std::to_string(i)});
+        }
+        articles.push_back(std::move(a));
+    }
+    return articles;
+}
+
+// Прежний путь: как build_articles_list до перехода на JsonWriter
+static std::string serialize_wvalue(const std::vector<Article> &articles) {
+    std::vector<crow::json::wvalue> articles_list;
+    articles_list.reserve(articles.size());
+    for (const auto &a : articles) {
+        crow::json::wvalue article_json;
+        article_json["id"] = a.id;
+        article_json["title"] = a.title.c_str();
+        article_json["content"] = a.content.c_str();
+        std::vector<crow::json::wvalue> comments_list;
+        for (const auto &c : a.comments) {
+            crow::json::wvalue cm;
+            cm["id"] = c.id;
+            cm["content"] = c.content.c_str();
+            comments_list.push_back(std::move(cm));
+        }
+        article_json["comments"] = std::move(comments_list);
+        articles_list.push_back(std::move(article_json));
+    }
+    crow::json::wvalue result;
+    result["articles"] = std::move(articles_list);
+    return result.dump();
+}
+
+static std::size_t serialize_writer(const std::vector<Article> &articles) {
+    ScratchBuffer buffer;
+    JsonWriter json(buffer.str());
+    json.begin_object().key("articles").begin_array();
+    for (const auto &a : articles) {
+        json.begin_object();
+        json.key("id").value(a.id);
+        json.key("title").value(a.title);
+        json.key("content").value(a.content);
+        json.key("comments").begin_array();
+        for (const auto &c : a.comments) {
+            json.begin_object().key("id").value(c.id).key("content").value(c.content).end_object();
+        }
+        json.end_array().end_object();
+    }
+    json.end_array().end_object();
+    return buffer.str().size();
+}
+
+static bool check_escaping() {
+    std::mt19937 rng(42);
+    const char alphabet[] = "abc \"\\/\n\r\t\b\f\x01\x1f\x7f\xd0\xbf";
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof(alphabet) - 2);
+    std::uniform_int_distribution<std::size_t> length(0, 80);
+    for (int i = 0; i < 100000; ++i) {
+        std::string s(length(rng), ' ');
+        for (char &c : s) {
+            c = alphabet[pick(rng)];
+        }
+        std::string expected;
+        crow::json::escape(s, expected);
+        std::string actual;
+        json_escape_append(actual, s);
+        if (actual != expected) {
+            std::fprintf(stderr, "Escaping mismatch for input of %zu bytes\n", s.size());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const long comments_per_article = env_long("BENCH_COMMENTS", 3);
+    const long repeat = std::max(1L, env_long("BENCH_REPEAT", 20));
+
+    if (!check_escaping()) {
+        return 1;
+    }
+
+    std::vector<long> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(std::stol(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {100, 10000};
+    }
+
+    std::printf("%-10s %-8s %14s %14s %12s\n", "articles", "mode", "ns_per_item", "allocs", "bytes");
+    for (long n : sizes) {
+        const std::vector<Article> articles = make_articles(n, comments_per_article);
+        const double items = static_cast<double>(n * (1 + comments_per_article));
+
+        auto run = [&](const char *name, auto &&serialize) {
+            serialize(); // прогрев: для writer — заполнение буфера потока
+            std::size_t bytes = 0;
+            const unsigned long long allocs_before = g_allocations.load();
+            const auto start = std::chrono::steady_clock::now();
+            for (long i = 0; i < repeat; ++i) {
+                bytes = serialize();
+            }
+            const auto end = std::chrono::steady_clock::now();
+            const double ns = std::chrono::duration<double, std::nano>(end - start).count() / repeat;
+            const double allocs = static_cast<double>(g_allocations.load() - allocs_before) / repeat;
+            std::printf("%-10ld %-8s %14.1f %14.0f %12zu\n", n, name, ns / items, allocs, bytes);
+        };
+        run("wvalue", [&] { return serialize_wvalue(articles).size(); });
+        run("writer", [&] { return serialize_writer(articles); });
+    }
+    return 0;
+}
@@ -0,0 +1,327 @@
+// bench/load_generator.cpp
+//
+// Нагрузочный генератор для запущенного сервиса со смесью операций и JSON-отчётом.
+//
+// Открытая модель (BENCH_RATE > 0): запросы идут с постоянной общей частотой BENCH_RATE
+// по расписанию, которое не зависит от ответов сервиса. Каждое из BENCH_CONNECTIONS
+// соединений отправляет свою долю запросов в заранее назначенные моменты; если ответ
+// задержался, следующие запросы уходят сразу, а их задержка считается от назначенного
+// момента (поправка на coordinated omission, как в wrk2). Поэтому перцентили отражают
+// ожидание клиента под заданной нагрузкой, а не только время обслуживания: оно
+// печатается отдельно (service_p99). BENCH_RATE=0 — закрытая модель: каждое соединение
+// шлёт следующий запрос сразу после ответа (предельная пропускная способность).
+//
+// Операции (BENCH_MIX, веса через запятую, например "article=80,page=10,comment=10"):
+//   article      — GET /article/{id};            random — GET /article/random;
+//   list         — GET /articles;                page   — GET /articles?limit=L&after_id={id};
+//   batch        — GET /articles?ids=...;        comment — POST /comment к статье {id};
+//   post_article — POST /article.
+// Готовые смеси: read (article=100), mixed (article=70,random=5,page=10,batch=5,comment=10),
+// write_heavy (article=50,comment=40,post_article=10).
+// id статей — от 1 до BENCH_KEYS, равномерно или по Ципфу (BENCH_DIST=zipf, показатель
+// BENCH_ZIPF_S); популярные id разбросаны по диапазону перестановкой с BENCH_SEED.
+//
+// Первые BENCH_WARMUP_SECONDS не учитываются. Итоги по операциям печатаются таблицей и
+// пишутся в JSON (BENCH_OUTPUT, см. bench_report.h) для сравнения между коммитами.
+//
+// Запуск: load_generator
+// Переменные: BENCH_HOST (127.0.0.1), BENCH_PORT (18080), BENCH_RATE (1000),
+//             BENCH_CONNECTIONS (32), BENCH_SECONDS (30), BENCH_WARMUP_SECONDS (5),
+//             BENCH_MIX (read), BENCH_KEYS (10000), BENCH_DIST (zipf), BENCH_ZIPF_S (0.99),
+//             BENCH_PAGE_LIMIT (20), BENCH_BATCH_IDS (20), BENCH_SEED (1), BENCH_OUTPUT.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/metrics.h"
+#include "bench_report.h"
+#include "http_client.h"
+#include "zipf.h"
+
+using Clock = std::chrono::steady_clock;
+
+enum class Op { Article, Random, List, Page, Batch, Comment, PostArticle, Count };
+
+static const char *const kOpNames[] = {"article", "random", "list", "page", "batch", "comment", "post_article"};
+static constexpr std::size_t kOpCount = static_cast<std::size_t>(Op::Count);
+
+// Ряды гистограмм: по операции и итог ("all"), для каждого — задержка от назначенного
+// момента и время обслуживания
+static constexpr std::size_t kAllSeries = kOpCount;
+
+static std::size_t latency_series(std::size_t op) { return op * 2; }
+static std::size_t service_series(std::size_t op) { return op * 2 + 1; }
+
+static std::vector<std::string> series_labels() {
+    std::vector<std::string> labels;
+    for (std::size_t op = 0; op <= kOpCount; ++op) {
+        const std::string name = op == kAllSeries ? "all" : kOpNames[op];
+        labels.push_back("op=\"" + name + "\",time=\"latency\"");
+        labels.push_back("op=\"" + name + "\",time=\"service\"");
+    }
+    return labels;
+}
+
+static std::string expand_mix(const std::string &mix) {
+    if (mix == "read") {
+        return "article=100";
+    }
+    if (mix == "mixed") {
+        return "article=70,random=5,page=10,batch=5,comment=10";
+    }
+    if (mix == "write_heavy") {
+        return "article=50,comment=40,post_article=10";
+    }
+    return mix;
+}
+
+// "article=80,comment=20" -> веса по операциям
+static std::vector<long> parse_mix(const std::string &mix) {
+    std::vector<long> weights(kOpCount, 0);
+    std::size_t pos = 0;
+    while (pos < mix.size()) {
+        std::size_t end = mix.find(',', pos);
+        if (end == std::string::npos) {
+            end = mix.size();
+        }
+        const std::string item = mix.substr(pos, end - pos);
+        const std::size_t eq = item.find('=');
+        const std::string name = item.substr(0, eq);
+        const long weight = eq == std::string::npos ? 1 : std::atol(item.c_str() + eq + 1);
+        const auto it = std::find(std::begin(kOpNames), std::end(kOpNames), name);
+        if (it == std::end(kOpNames) || weight < 0) {
+            throw std::invalid_argument("Unknown operation in BENCH_MIX: " + item);
+        }
+        weights[static_cast<std::size_t>(it - std::begin(kOpNames))] += weight;
+        pos = end + 1;
+    }
+    if (std::accumulate(weights.begin(), weights.end(), 0L) <= 0) {
+        throw std::invalid_argument("BENCH_MIX has no operations");
+    }
+    return weights;
+}
+
+// Выбор id статьи: равномерно или по Ципфу с перестановкой рангов
+class KeyChooser {
+public:
+    KeyChooser(long keys, bool zipf, double s, unsigned seed) : keys_(keys) {
+        if (zipf) {
+            zipf_.emplace(static_cast<std::size_t>(keys), s);
+            ids_.resize(static_cast<std::size_t>(keys));
+            std::iota(ids_.begin(), ids_.end(), 1);
+            std::shuffle(ids_.begin(), ids_.end(), std::mt19937(seed));
+        }
+    }
+
+    template <typename Rng>
+    int operator()(Rng &rng) const {
+        if (zipf_) {
+            return ids_[(*zipf_)(rng)];
+        }
+        return static_cast<int>(std::uniform_int_distribution<long>(1, keys_)(rng));
+    }
+
+private:
+    const long keys_;
+    std::optional<ZipfGenerator> zipf_;
+    std::vector<int> ids_;
+};
+
+struct Settings {
+    std::string host;
+    int port = 18080;
+    double rate = 0;
+    long connections = 0;
+    long seconds = 0;
+    long warmup_seconds = 0;
+    long page_limit = 0;
+    long batch_ids = 0;
+};
+
+// Один запрос операции op; true — успешный ответ
+template <typename Rng>
+static bool send(HttpClient &http, Op op, const KeyChooser &keys, const Settings &settings, Rng &rng) {
+    int status = 0;
+    switch (op) {
+        case Op::Article:
+            status = http.get("/article/" + std::to_string(keys(rng))).status;
+            break;
+        case Op::Random:
+            status = http.get("/article/random").status;
+            break;
+        case Op::List:
+            status = http.get("/articles").status;
+            break;
+        case Op::Page:
+            status = http.get("/articles?limit=" + std::to_string(settings.page_limit) +
+                              "&after_id=" + std::to_string(keys(rng) - 1)).status;
+            break;
+        case Op::Batch: {
+            std::string path = "/articles?ids=";
+            for (long i = 0; i < settings.batch_ids; ++i) {
+                path += (i ? "," : "") + std::to_string(keys(rng));
+            }
+            status = http.get(path).status;
+            break;
+        }
+        case Op::Comment:
+            status = http.post("/comment", "{\"article_id\":" + std::to_string(keys(rng)) +
+                                               ",\"content\":\"load generator comment\"}").status;
+            break;
+        case Op::PostArticle:
+            status = http.post("/article", "{\"title\":\"Load generator\",\"content\":\"Generated article\"}").status;
+            break;
+        case Op::Count:
+            break;
+    }
+    return status >= 200 && status < 400;
+}
+
+int main() {
+    Settings settings;
+    settings.host = env_string("BENCH_HOST", "127.0.0.1");
+    settings.port = static_cast<int>(env_long("BENCH_PORT", 18080));
+    settings.rate = static_cast<double>(std::max(0L, env_long("BENCH_RATE", 1000)));
+    settings.connections = std::max(1L, env_long("BENCH_CONNECTIONS", 32));
+    settings.seconds = std::max(1L, env_long("BENCH_SECONDS", 30));
+    settings.warmup_seconds = std::max(0L, env_long("BENCH_WARMUP_SECONDS", 5));
+    settings.page_limit = std::max(1L, env_long("BENCH_PAGE_LIMIT", 20));
+    settings.batch_ids = std::max(1L, env_long("BENCH_BATCH_IDS", 20));
+    const long key_count = std::max(1L, env_long("BENCH_KEYS", 10000));
+    const std::string dist = env_string("BENCH_DIST", "zipf");
+    const double zipf_s = std::stod(env_string("BENCH_ZIPF_S", "0.99"));
+    const auto seed = static_cast<unsigned>(env_long("BENCH_SEED", 1));
+    const std::string mix_name = env_string("BENCH_MIX", "read");
+
+    std::vector<long> weights;
+    try {
+        weights = parse_mix(expand_mix(mix_name));
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    std::vector<long> cumulative(weights.size());
+    std::partial_sum(weights.begin(), weights.end(), cumulative.begin());
+    const KeyChooser keys(key_count, dist == "zipf", zipf_s, seed);
+
+    LatencyRecorder latency("load_generator", series_labels());
+    std::atomic<std::uint64_t> late{0}; // запросы, ушедшие позже назначенного на 1 мс и больше
+
+    const auto begin = Clock::now() + std::chrono::milliseconds(100);
+    const auto measure_from = begin + std::chrono::seconds(settings.warmup_seconds);
+    const auto end = measure_from + std::chrono::seconds(settings.seconds);
+    // Интервал между запросами одного соединения; соединения сдвинуты по фазе
+    const std::chrono::duration<double> interval(settings.rate > 0 ? settings.connections / settings.rate : 0);
+
+    std::vector<std::thread> threads;
+    for (long c = 0; c < settings.connections; ++c) {
+        threads.emplace_back([&, c] {
+            HttpClient http(settings.host, settings.port);
+            std::mt19937_64 rng(seed * 1000003ULL + static_cast<std::uint64_t>(c));
+            std::uniform_int_distribution<long> pick(0, cumulative.back() - 1);
+            const double phase = static_cast<double>(c) / static_cast<double>(settings.connections);
+            for (long k = 0;; ++k) {
+                auto intended = Clock::now();
+                if (settings.rate > 0) {
+                    intended = begin + std::chrono::duration_cast<Clock::duration>(interval * (phase + k));
+                    if (intended >= end) {
+                        return;
+                    }
+                    std::this_thread::sleep_until(intended);
+                }
+                else if (intended >= end) {
+                    return;
+                }
+                const long r = pick(rng);
+                const auto op = static_cast<std::size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), r) -
+                                                         cumulative.begin());
+                const auto sent = Clock::now();
+                bool ok = false;
+                try {
+                    ok = send(http, static_cast<Op>(op), keys, settings, rng);
+                }
+                catch (const std::exception &) {
+                    ok = false;
+                }
+                const auto done = Clock::now();
+                if (intended < measure_from) {
+                    continue;
+                }
+                if (sent - intended >= std::chrono::milliseconds(1)) {
+                    late.fetch_add(1, std::memory_order_relaxed);
+                }
+                for (std::size_t series_op : {op, kAllSeries}) {
+                    latency.record(latency_series(series_op), done - intended, !ok);
+                    latency.record(service_series(series_op), done - sent, !ok);
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    // Если сервис не успевал, отставшие запросы досылаются после end: частота считается
+    // по фактическому времени замера
+    const double measured_seconds = std::chrono::duration<double>(Clock::now() - measure_from).count();
+
+    BenchReport report("load_generator");
+    report.param("mix", expand_mix(mix_name));
+    report.param("rate", settings.rate);
+    report.param("connections", settings.connections);
+    report.param("seconds", settings.seconds);
+    report.param("keys", key_count);
+    report.param("dist", dist);
+    report.param("zipf_s", zipf_s);
+
+    std::printf("mix=%s rate=%s connections=%ld seconds=%ld keys=%ld dist=%s\n", expand_mix(mix_name).c_str(),
+                settings.rate > 0 ? std::to_string(static_cast<long>(settings.rate)).c_str() : "closed-loop",
+                settings.connections, settings.seconds, key_count, dist.c_str());
+    std::printf("%-13s %9s %9s %7s %9s %9s %9s %9s %9s %12s\n", "op", "requests", "req/s", "errors", "p50_ms",
+                "p90_ms", "p99_ms", "p99.9_ms", "max_ms", "service_p99");
+    for (std::size_t op = 0; op <= kOpCount; ++op) {
+        const auto snap = latency.snapshot(latency_series(op));
+        if (snap.count == 0) {
+            continue;
+        }
+        const auto service = latency.snapshot(service_series(op));
+        const char *name = op == kAllSeries ? "all" : kOpNames[op];
+        const double per_second = static_cast<double>(snap.count) / measured_seconds;
+        std::printf("%-13s %9llu %9.1f %7llu %9.2f %9.2f %9.2f %9.2f %9.2f %12.2f\n", name,
+                    static_cast<unsigned long long>(snap.count), per_second,
+                    static_cast<unsigned long long>(snap.errors), snap.percentile(0.5) / 1000.0,
+                    snap.percentile(0.9) / 1000.0, snap.percentile(0.99) / 1000.0, snap.percentile(0.999) / 1000.0,
+                    snap.max_us / 1000.0, service.percentile(0.99) / 1000.0);
+        report.result(name)
+            .set("requests", static_cast<double>(snap.count))
+            .set("requests_per_s", per_second)
+            .set("errors", static_cast<double>(snap.errors))
+            .set("p50_ms", snap.percentile(0.5) / 1000.0)
+            .set("p90_ms", snap.percentile(0.9) / 1000.0)
+            .set("p99_ms", snap.percentile(0.99) / 1000.0)
+            .set("p999_ms", snap.percentile(0.999) / 1000.0)
+            .set("max_ms", snap.max_us / 1000.0)
+            .set("service_p50_ms", service.percentile(0.5) / 1000.0)
+            .set("service_p99_ms", service.percentile(0.99) / 1000.0);
+    }
+    const std::uint64_t late_sends = late.load(std::memory_order_relaxed);
+    if (settings.rate > 0 && late_sends > 0) {
+        std::printf("%llu requests were sent >= 1 ms late: the service (or BENCH_CONNECTIONS) cannot keep up "
+                    "with the rate, latency above includes the wait\n",
+                    static_cast<unsigned long long>(late_sends));
+    }
+    report.result("schedule").set("late_sends", static_cast<double>(late_sends));
+    return report.write(env_string("BENCH_OUTPUT", "")) ? 0 : 1;
+}
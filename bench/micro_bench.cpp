@@ -0,0 +1,273 @@
+// bench/micro_bench.cpp
+//
+// Микробенчмарки горячих участков обработчиков без сервиса и БД:
+//   json_article      — статья с BENCH_COMMENTS комментариями через JsonWriter;
+//   json_escape_*     — экранирование 1 КБ текста без спецсимволов и с ними;
+//   key_article, key_page — сборка ключей кеша, как в обработчиках;
+//   key_hot_record    — учёт обращения в HotKeyTracker (на каждый запрос);
+//   key_l1_hit        — попадание в L1Cache по ключу статьи;
+//   rows_grouped      — group_comments + write_articles_list над синтетическими строками
+//                       в духе pqxx::result (текстовые поля, id разбирается из текста):
+//                       BENCH_ARTICLES статей по BENCH_COMMENTS комментариев.
+// Каждый замер повторяется BENCH_REPEAT раз; печатаются лучшее и медианное время на
+// операцию. BENCH_OUTPUT — файл для JSON-результатов ("-" — stdout), см. bench_report.h.
+//
+// Запуск: micro_bench   (или make bench — с записью JSON в bench_results/)
+// Переменные: BENCH_ARTICLES (100), BENCH_COMMENTS (10), BENCH_REPEAT (5),
+//             BENCH_MIN_TIME_MS (200), BENCH_OUTPUT.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/article_queries.h"
+#include "../src/hot_keys.h"
+#include "../src/json_writer.h"
+#include "../src/l1_cache.h"
+#include "bench_report.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Не даёт компилятору выбросить результат замера
+static volatile std::size_t g_sink = 0;
+
+// Поле строки с интерфейсом pqxx::field: значение хранится текстом, как в ответе PostgreSQL
+struct SyntheticField {
+    std::string_view text;
+
+    template <typename T>
+    T as() const {
+        T value{};
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+
+    std::string_view view() const { return text; }
+};
+
+struct SyntheticRow {
+    std::vector<SyntheticField> fields;
+
+    const SyntheticField &operator[](int i) const { return fields[static_cast<std::size_t>(i)]; }
+};
+
+// Набор строк с интерфейсом pqxx::result, достаточным для group_comments/write_articles_list
+class SyntheticResult {
+public:
+    void add(std::vector<std::string> values) {
+        pending_.push_back(values.size());
+        for (std::string &value : values) {
+            storage_.push_back(std::move(value));
+        }
+        rows_.emplace_back();
+    }
+
+    // Поля ссылаются на storage_, поэтому строки собираются после всех add()
+    void finish() {
+        std::size_t next = 0;
+        for (std::size_t r = 0; r < rows_.size(); ++r) {
+            for (std::size_t f = 0; f < pending_[r]; ++f) {
+                rows_[r].fields.push_back({storage_[next++]});
+            }
+        }
+    }
+
+    std::size_t size() const { return rows_.size(); }
+    const SyntheticRow &operator[](pqxx::result::size_type i) const { return rows_[static_cast<std::size_t>(i)]; }
+    std::vector<SyntheticRow>::const_iterator begin() const { return rows_.begin(); }
+    std::vector<SyntheticRow>::const_iterator end() const { return rows_.end(); }
+
+private:
+    std::deque<std::string> storage_; // deque: строки не переезжают, view() остаются верными
+    std::vector<SyntheticRow> rows_;
+    std::vector<std::size_t> pending_;
+};
+
+static const char kLorem[] =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Sed do eiusmod tempor incididunt ut labore et "
+    "dolore magna aliqua.";
+
+struct Timing {
+    double best_ns = 0;   // лучшее время на операцию по повторам
+    double median_ns = 0; // медианное время на операцию
+    long ops = 0;         // операций в одном повторе
+};
+
+// fn(ops) выполняет ops операций. Число операций подбирается так, чтобы повтор шёл не
+// меньше min_time; затем repeat повторов.
+template <typename Fn>
+static Timing measure(Fn &&fn, int repeat, std::chrono::milliseconds min_time) {
+    long ops = 1;
+    while (true) {
+        const auto start = Clock::now();
+        fn(ops);
+        if (Clock::now() - start >= min_time / 4 || ops >= (1L << 30)) {
+            break;
+        }
+        ops *= 2;
+    }
+    ops *= 4;
+    std::vector<double> per_op;
+    for (int r = 0; r < repeat; ++r) {
+        const auto start = Clock::now();
+        fn(ops);
+        per_op.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    return {per_op.front(), per_op[per_op.size() / 2], ops};
+}
+
+int main() {
+    const int articles = static_cast<int>(std::max(1L, env_long("BENCH_ARTICLES", 100)));
+    const int comments = static_cast<int>(std::max(0L, env_long("BENCH_COMMENTS", 10)));
+    const int repeat = static_cast<int>(std::max(1L, env_long("BENCH_REPEAT", 5)));
+    const auto min_time = std::chrono::milliseconds(std::max(1L, env_long("BENCH_MIN_TIME_MS", 200)));
+
+    BenchReport report("micro_bench");
+    report.param("articles", static_cast<long long>(articles));
+    report.param("comments", static_cast<long long>(comments));
+    report.param("repeat", static_cast<long long>(repeat));
+
+    std::printf("%-20s %12s %12s %14s\n", "benchmark", "best_ns", "median_ns", "extra");
+    // extra_name — необязательный дополнительный показатель замера
+    auto print = [&report](const char *name, const Timing &t, const char *extra_name = nullptr, double extra = 0) {
+        BenchReport::Result &result = report.result(name);
+        result.set("ns_per_op", t.best_ns).set("median_ns_per_op", t.median_ns);
+        if (extra_name) {
+            result.set(extra_name, extra);
+            std::printf("%-20s %12.1f %12.1f %14.1f %s\n", name, t.best_ns, t.median_ns, extra, extra_name);
+        }
+        else {
+            std::printf("%-20s %12.1f %12.1f\n", name, t.best_ns, t.median_ns);
+        }
+    };
+
+    // Статья с комментариями через JsonWriter (как fetch_article)
+    {
+        std::string out;
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                out.clear();
+                JsonWriter json(out);
+                begin_article(json, static_cast<int>(i), "Article title", kLorem);
+                for (int c = 0; c < comments; ++c) {
+                    write_comment(json, c, "A comment with \"quotes\" and some text");
+                }
+                end_article(json);
+                g_sink = g_sink + out.size();
+            }
+        }, repeat, min_time);
+        print("json_article", t, "bytes", static_cast<double>(out.size()));
+    }
+
+    // Экранирование строк: без спецсимволов (быстрый путь) и с частыми спецсимволами
+    for (const bool special : {false, true}) {
+        std::string text;
+        while (text.size() < 1024) {
+            text += special ? "line \"one\"\n\ttab\\" : kLorem;
+        }
+        text.resize(1024);
+        std::string out;
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                out.clear();
+                json_escape_append(out, text);
+                g_sink = g_sink + out.size();
+            }
+        }, repeat, min_time);
+        print(special ? "json_escape_special" : "json_escape_plain", t, "mb_per_s", 1024 * 1e3 / t.best_ns);
+    }
+
+    // Ключи кеша: статья и страница списка (поколение + after_id + limit)
+    {
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                const std::string key = "article:" + std::to_string(i & 0xffff);
+                g_sink = g_sink + key.size();
+            }
+        }, repeat, min_time);
+        print("key_article", t);
+    }
+    {
+        const std::string generation = "42";
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                const std::string key = "articles:page:" + generation + ":" + std::to_string(i & 0xffff) + ":" +
+                                        std::to_string(20);
+                g_sink = g_sink + key.size();
+            }
+        }, repeat, min_time);
+        print("key_page", t);
+    }
+
+    // Учёт обращения к ключу в sketch частот (каждый GET)
+    {
+        HotKeyTracker::Options options;
+        HotKeyTracker hot_keys(options);
+        std::vector<std::string> keys;
+        for (int i = 0; i < 4096; ++i) {
+            keys.push_back("article:" + std::to_string(i));
+        }
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                g_sink = g_sink + hot_keys.record(keys[static_cast<std::size_t>(i) & 4095]);
+            }
+        }, repeat, min_time);
+        print("key_hot_record", t);
+    }
+
+    // Попадание в L1 по ключу статьи
+    {
+        L1Cache::Options options;
+        L1Cache l1(options);
+        std::vector<std::string> keys;
+        for (int i = 0; i < 4096; ++i) {
+            keys.push_back("article:" + std::to_string(i));
+            l1.put(keys.back(), std::make_shared<const std::string>(kLorem), std::chrono::hours(1));
+        }
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                g_sink = g_sink + (l1.get(keys[static_cast<std::size_t>(i) & 4095]) != nullptr);
+            }
+        }, repeat, min_time);
+        print("key_l1_hit", t);
+    }
+
+    // Строки результата -> JSON списка (как fetch_articles_json в режиме grouped)
+    {
+        SyntheticResult article_rows;
+        SyntheticResult comment_rows;
+        int comment_id = 1;
+        for (int a = 1; a <= articles; ++a) {
+            article_rows.add({std::to_string(a), "Article " + std::to_string(a), kLorem});
+            for (int c = 0; c < comments; ++c) {
+                comment_rows.add({std::to_string(a), std::to_string(comment_id++),
+                                  "Comment " + std::to_string(c) + " on article " + std::to_string(a)});
+            }
+        }
+        article_rows.finish();
+        comment_rows.finish();
+
+        std::string out;
+        auto t = measure([&](long ops) {
+            for (long i = 0; i < ops; ++i) {
+                out.clear();
+                const CommentsByArticle grouped = group_comments(comment_rows, article_rows.size());
+                JsonWriter json(out);
+                json.begin_object().key("articles");
+                write_articles_list(json, article_rows, comment_rows, grouped);
+                json.end_object();
+                g_sink = g_sink + out.size();
+            }
+        }, repeat, min_time);
+        print("rows_grouped", t, "ns_per_article", t.best_ns / articles);
+    }
+
+    return report.write(env_string("BENCH_OUTPUT", "")) ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+// bench/redis_outage_bench.cpp
+//
+// Задержка ответов сервиса, пока Redis недоступен. BENCH_CLIENTS потоков по своему
+// keep-alive соединению запрашивают GET /article/<id> со случайным id из
+// [1, BENCH_MAX_ID] в течение BENCH_SECONDS; по каждой секунде печатаются запросов в
+// секунду, p50/p99/max и число ошибок (не 200/404).
+//
+// Redis останавливают посреди замера: вручную (redis-cli shutdown nosave, kill
+// redis-server) или командами BENCH_KILL_CMD и BENCH_RESTART_CMD, которые бенчмарк
+// выполняет на секунде BENCH_KILL_AT и BENCH_RESTART_AT. Без автомата защиты каждый
+// запрос в это время ждал бы таймаута Redis; с ним задержка после нескольких ошибок
+// возвращается к уровню L1 + БД, а после перезапуска Redis — к обычной.
+//
+// Раз в секунду бенчмарк читает l1_hits из /stats/cache и печатает долю ответов из L1.
+// Пока Redis недоступен, L1 должен продолжать отвечать: если с BENCH_KILL_AT + 2 до
+// BENCH_RESTART_AT доля хоть в одну секунду меньше половины доли до остановки, замер
+// завершается с кодом 1 (например, если L1 очищается при каждой попытке переподписки).
+//
+// Запуск: redis_outage_bench
+// Переменные: BENCH_HOST (127.0.0.1), BENCH_PORT (18080), BENCH_CLIENTS (8),
+//             BENCH_SECONDS (30), BENCH_MAX_ID (1000), BENCH_KILL_AT (10),
+//             BENCH_RESTART_AT (20), BENCH_KILL_CMD, BENCH_RESTART_CMD (по умолчанию пусто).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/metrics.h"
+#include "http_client.h"
+
+// Счётчик l1_hits из /stats/cache; -1 — не удалось прочитать
+static long long read_l1_hits(HttpClient &http) {
+    try {
+        const HttpClient::Response res = http.get("/stats/cache");
+        const char *field = "\"l1_hits\":";
+        const std::size_t pos = res.body.find(field);
+        if (res.status != 200 || pos == std::string::npos) {
+            return -1;
+        }
+        return std::atoll(res.body.c_str() + pos + std::strlen(field));
+    }
+    catch (const std::exception &) {
+        return -1;
+    }
+}
+
+int main() {
+    const std::string host = env_string("BENCH_HOST", "127.0.0.1");
+    const int port = static_cast<int>(env_long("BENCH_PORT", 18080));
+    const long clients = std::max(1L, env_long("BENCH_CLIENTS", 8));
+    const long seconds = std::max(1L, env_long("BENCH_SECONDS", 30));
+    const long max_id = std::max(1L, env_long("BENCH_MAX_ID", 1000));
+    const long kill_at = env_long("BENCH_KILL_AT", 10);
+    const long restart_at = env_long("BENCH_RESTART_AT", 20);
+    const std::string kill_cmd = env_string("BENCH_KILL_CMD", "");
+    const std::string restart_cmd = env_string("BENCH_RESTART_CMD", "");
+
+    // Ряд на каждую секунду замера
+    std::vector<std::string> labels;
+    for (long s = 0; s < seconds; ++s) {
+        labels.push_back("second=\"" + std::to_string(s) + "\"");
+    }
+    LatencyRecorder latency("bench", labels);
+
+    // l1_hits на начало каждой секунды и в конце замера
+    HttpClient stats_http(host, port);
+    std::vector<long long> l1_hits(static_cast<std::size_t>(seconds) + 1, -1);
+    l1_hits[0] = read_l1_hits(stats_http);
+
+    const auto begin = std::chrono::steady_clock::now();
+    const auto end = begin + std::chrono::seconds(seconds);
+    std::vector<std::thread> threads;
+    for (long c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            HttpClient http(host, port);
+            std::mt19937 rng(static_cast<unsigned>(c));
+            std::uniform_int_distribution<int> article(1, static_cast<int>(max_id));
+            while (true) {
+                const auto start = std::chrono::steady_clock::now();
+                if (start >= end) {
+                    return;
+                }
+                bool failed = false;
+                try {
+                    const int status = http.get("/article/" + std::to_string(article(rng))).status;
+                    failed = status != 200 && status != 404;
+                }
+                catch (const std::exception &) {
+                    failed = true;
+                }
+                const auto second = std::chrono::duration_cast<std::chrono::seconds>(start - begin).count();
+                latency.record(static_cast<std::size_t>(second), std::chrono::steady_clock::now() - start, failed);
+            }
+        });
+    }
+
+    for (long s = 1; s < seconds; ++s) {
+        std::this_thread::sleep_until(begin + std::chrono::seconds(s));
+        l1_hits[static_cast<std::size_t>(s)] = read_l1_hits(stats_http);
+        if (s == kill_at && !kill_cmd.empty()) {
+            std::cerr << "t=" << s << "s: " << kill_cmd << " -> " << std::system(kill_cmd.c_str()) << std::endl;
+        }
+        if (s == restart_at && !restart_cmd.empty()) {
+            std::cerr << "t=" << s << "s: " << restart_cmd << " -> " << std::system(restart_cmd.c_str()) << std::endl;
+        }
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    l1_hits[static_cast<std::size_t>(seconds)] = read_l1_hits(stats_http);
+
+    // Доля ответов секунды s из L1; -1 — нет данных
+    auto l1_share = [&](long s) {
+        const long long from = l1_hits[static_cast<std::size_t>(s)];
+        const long long to = l1_hits[static_cast<std::size_t>(s) + 1];
+        const auto requests = latency.snapshot(static_cast<std::size_t>(s)).count;
+        if (from < 0 || to < from || requests == 0) {
+            return -1.0;
+        }
+        return std::min(1.0, static_cast<double>(to - from) / static_cast<double>(requests));
+    };
+
+    std::printf("clients=%ld max_id=%ld kill_at=%lds restart_at=%lds\n", clients, max_id, kill_at, restart_at);
+    std::printf("%-6s %10s %10s %10s %10s %8s %8s\n", "second", "req/s", "p50_ms", "p99_ms", "max_ms", "errors",
+                "l1_%");
+    for (long s = 0; s < seconds; ++s) {
+        const auto snap = latency.snapshot(static_cast<std::size_t>(s));
+        std::printf("%-6ld %10llu %10.2f %10.2f %10.2f %8llu %8.1f\n", s, static_cast<unsigned long long>(snap.count),
+                    snap.percentile(0.5) / 1000.0, snap.percentile(0.99) / 1000.0, snap.max_us / 1000.0,
+                    static_cast<unsigned long long>(snap.errors), l1_share(s) * 100.0);
+    }
+
+    // L1 во время недоступности Redis: с kill_at + 2 (автомат успел разомкнуться) до restart_at
+    double before = 0;
+    long before_seconds = 0;
+    for (long s = 1; s < std::min(kill_at, seconds); ++s) {
+        const double share = l1_share(s);
+        if (share >= 0) {
+            before += share;
+            ++before_seconds;
+        }
+    }
+    if (kill_cmd.empty() || before_seconds == 0 || kill_at + 2 >= std::min(restart_at, seconds)) {
+        std::printf("L1 during outage: not checked (needs BENCH_KILL_CMD, /stats/cache and seconds before the kill)\n");
+        return 0;
+    }
+    before /= static_cast<double>(before_seconds);
+    double worst = 1.0;
+    for (long s = kill_at + 2; s < std::min(restart_at, seconds); ++s) {
+        worst = std::min(worst, std::max(0.0, l1_share(s)));
+    }
+    const bool ok = worst >= before / 2;
+    std::printf("L1 during outage: %s (lowest %.1f%% vs %.1f%% before the kill)\n", ok ? "OK" : "FAIL", worst * 100.0,
+                before * 100.0);
+    return ok ? 0 : 1;
+}
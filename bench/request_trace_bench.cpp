@@ -0,0 +1,138 @@
+// bench/request_trace_bench.cpp
+//
+// Цена трассировки этапов запроса (src/request_trace.h) на синтетическом обработчике.
+// Обработчик проходит те же этапы, что промах /article/<id>: cache, db_conn, два
+// db_query, serialize, encode, cache_fill — каждый как BENCH_WORK_NS наносекунд
+// вычислений. Режимы:
+//   off          — RequestTracer выключен (REQUEST_TRACE=off): StageSpan без трассировки;
+//   spans        — замеры этапов без итогов запроса;
+//   finish       — плюс RequestTracer::finish (гистограммы этапов);
+//   server_timing — плюс заголовок Server-Timing (как в сервисе по умолчанию).
+// Для каждого режима печатаются нс на запрос и надбавка к off; отдельно — нс на один
+// StageSpan с трассировкой и без неё. Потоки пишут параллельно, как рабочие потоки Crow.
+//
+// Запуск: request_trace_bench
+// Переменные: BENCH_REQUESTS (1000000 на поток), BENCH_THREADS (4), BENCH_WORK_NS (1000).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/config.h"
+#include "../src/request_trace.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Вычисления примерно на work_ns наносекунд, которые компилятор не может выбросить
+static std::uint64_t busy_work(std::uint64_t iterations, std::uint64_t seed) {
+    std::uint64_t x = seed | 1;
+    for (std::uint64_t i = 0; i < iterations; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    return x;
+}
+
+static std::uint64_t calibrate_iterations(long work_ns) {
+    const std::uint64_t probe = 10000000;
+    const auto start = Clock::now();
+    volatile std::uint64_t sink = busy_work(probe, 42);
+    (void)sink;
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return static_cast<std::uint64_t>(probe * static_cast<double>(work_ns) / ns) + 1;
+}
+
+enum class Mode { Off, Spans, Finish, ServerTiming };
+
+static const char *const kModeNames[] = {"off", "spans", "finish", "server_timing"};
+
+// Один запрос: этапы промаха /article/<id> и итоги, как в RequestTimer::done
+static std::uint64_t handle(RequestTracer &tracer, Mode mode, std::uint64_t iterations, std::uint64_t seed) {
+    const auto start = Clock::now();
+    StageTimes stages;
+    TraceScope scope(mode == Mode::Off ? nullptr : &stages);
+    std::uint64_t x = seed;
+    for (Stage stage : {Stage::Cache, Stage::DbConnect, Stage::DbQuery, Stage::DbQuery, Stage::Serialize,
+                        Stage::Encode, Stage::CacheFill}) {
+        StageSpan span(stage);
+        x = busy_work(iterations, x);
+    }
+    if (mode == Mode::Finish || mode == Mode::ServerTiming) {
+        const auto elapsed = Clock::now() - start;
+        if (mode == Mode::ServerTiming) {
+            const std::string header = stages.server_timing(elapsed);
+            x += header.size();
+        }
+        tracer.finish(stages, elapsed, [] { return std::string("GET /article/1 -> 200"); });
+    }
+    return x;
+}
+
+// Среднее время запроса (нс) при threads параллельных потоках
+static double run(Mode mode, int threads, long requests, std::uint64_t iterations) {
+    RequestTracer::Options options;
+    options.slow_threshold = std::chrono::milliseconds(0); // журнал не пишется
+    RequestTracer tracer(options);
+    std::atomic<std::uint64_t> sink{0};
+    std::vector<std::thread> workers;
+    const auto start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::uint64_t x = static_cast<std::uint64_t>(t) + 1;
+            for (long i = 0; i < requests; ++i) {
+                x = handle(tracer, mode, iterations, x);
+            }
+            sink.fetch_add(x, std::memory_order_relaxed);
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / static_cast<double>(requests); // каждый поток выполнил requests запросов
+}
+
+// нс на один StageSpan (пустой этап)
+static double span_cost(bool traced, long spans) {
+    StageTimes stages;
+    TraceScope scope(traced ? &stages : nullptr);
+    const auto start = Clock::now();
+    for (long i = 0; i < spans; ++i) {
+        StageSpan span(Stage::DbQuery);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (traced && stages.count[static_cast<std::size_t>(Stage::DbQuery)] != static_cast<std::uint32_t>(spans)) {
+        std::printf("unexpected span count\n");
+    }
+    return ns / static_cast<double>(spans);
+}
+
+int main() {
+    const long requests = std::max(1L, env_long("BENCH_REQUESTS", 1000000));
+    const int threads = static_cast<int>(std::max(1L, env_long("BENCH_THREADS", 4)));
+    const long work_ns = std::max(0L, env_long("BENCH_WORK_NS", 1000));
+    const std::uint64_t iterations = work_ns > 0 ? calibrate_iterations(work_ns) : 0;
+
+    std::printf("StageSpan: %.1f ns without trace, %.1f ns with trace\n", span_cost(false, 10000000),
+                span_cost(true, 10000000));
+    std::printf("%ld requests x %d threads, 7 stages of ~%ld ns each\n", requests, threads, work_ns);
+    std::printf("%-14s %14s %14s\n", "mode", "ns/request", "overhead");
+
+    double baseline = 0;
+    for (Mode mode : {Mode::Off, Mode::Spans, Mode::Finish, Mode::ServerTiming}) {
+        run(mode, threads, requests / 10 + 1, iterations); // прогрев: слоты потоков, частота CPU
+        const double ns = run(mode, threads, requests, iterations);
+        if (mode == Mode::Off) {
+            baseline = ns;
+        }
+        std::printf("%-14s %14.1f %+13.1f%%\n", kModeNames[static_cast<int>(mode)], ns,
+                    baseline > 0 ? (ns - baseline) * 100.0 / baseline : 0.0);
+    }
+    return 0;
+}
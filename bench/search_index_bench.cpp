@@ -0,0 +1,230 @@
+// bench/search_index_bench.cpp
+//
+// Поисковый индекс GET /articles/search (src/search_index.h) без сервиса.
+//
+// Синтетический корпус: BENCH_ARTICLES статей по BENCH_WORDS слов из словаря в
+// BENCH_VOCABULARY слов, слово ранга r встречается с вероятностью ~ 1 / (r + 1)^BENCH_ZIPF_S
+// (как в естественном тексте). Замеряются сборка в BENCH_THREADS потоков, память на
+// миллион элементов списков и задержки страницы поиска (limit BENCH_LIMIT) для частого,
+// среднего и редкого слова и для двух слов сразу (пересечение списков).
+//
+// BENCH_DB=on — то же на статьях из БД (заполненной seed_db): индекс строится теми же
+// запросами, что и в сервисе, а каждый из BENCH_QUERIES (через ';') сравнивается с
+// прежним способом — ILIKE '%слово%' по заголовку, тексту и комментариям. ILIKE ищет
+// подстроку, индекс — слово целиком, поэтому число найденных может отличаться.
+//
+// Запуск: search_index_bench
+// Переменные: BENCH_ARTICLES (100000), BENCH_WORDS (200), BENCH_VOCABULARY (50000),
+//             BENCH_ZIPF_S (1.0), BENCH_THREADS (4), BENCH_REPEAT (1000), BENCH_LIMIT (20),
+//             BENCH_DB (off), BENCH_DB_CONN (или DB_CONN), BENCH_DB_REPEAT (20),
+//             BENCH_QUERIES ("lorem;ipsum dolor;article 77;comment"), BENCH_OUTPUT.
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/article_queries.h"
+#include "../src/config.h"
+#include "../src/search_index.h"
+#include "bench_report.h"
+#include "zipf.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Latency {
+    double p50_us = 0;
+    double p99_us = 0;
+};
+
+// repeat вызовов fn, перцентили задержки в микросекундах
+static Latency measure(long repeat, const std::function<void()> &fn) {
+    std::vector<double> us;
+    us.reserve(static_cast<std::size_t>(repeat));
+    for (long i = 0; i < repeat; ++i) {
+        const auto start = Clock::now();
+        fn();
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    return {us[us.size() / 2], us[std::min(us.size() - 1, us.size() * 99 / 100)]};
+}
+
+static void report_index(BenchReport &report, const char *name, const SearchIndex &index, double build_ms) {
+    const SearchIndex::Stats s = index.stats();
+    const double per_million = s.postings ? s.bytes * 1e6 / static_cast<double>(s.postings) : 0;
+    std::printf("%s: %zu articles, %zu terms, %zu postings, %.1f MB (%.2f MB per million postings), built in %.1f ms\n",
+                name, s.documents, s.terms, s.postings, s.bytes / 1e6, per_million / 1e6, build_ms);
+    report.result(name)
+        .set("build_ms", build_ms)
+        .set("documents", static_cast<double>(s.documents))
+        .set("postings", static_cast<double>(s.postings))
+        .set("bytes", static_cast<double>(s.bytes))
+        .set("bytes_per_million_postings", per_million);
+}
+
+static void run_synthetic(BenchReport &report, std::size_t threads, long repeat, std::size_t limit) {
+    const std::size_t articles = static_cast<std::size_t>(std::max(1L, env_long("BENCH_ARTICLES", 100000)));
+    const std::size_t words = static_cast<std::size_t>(std::max(1L, env_long("BENCH_WORDS", 200)));
+    const std::size_t vocabulary = static_cast<std::size_t>(std::max(4L, env_long("BENCH_VOCABULARY", 50000)));
+    const double zipf_s = std::stod(env_string("BENCH_ZIPF_S", "1.0"));
+    report.param("articles", static_cast<long long>(articles));
+    report.param("words", static_cast<long long>(words));
+    report.param("vocabulary", static_cast<long long>(vocabulary));
+    report.param("zipf_s", zipf_s);
+
+    // Слово ранга r — "w<r>"; тексты пишутся заранее, чтобы сборка мерила только индекс
+    const ZipfGenerator zipf(vocabulary, zipf_s);
+    std::mt19937_64 rng(42);
+    std::vector<std::string> texts(articles);
+    for (std::string &text : texts) {
+        for (std::size_t w = 0; w < words; ++w) {
+            text += 'w';
+            text += std::to_string(zipf(rng));
+            text += ' ';
+        }
+    }
+
+    const std::size_t chunk_size = 5000;
+    SearchIndex index;
+    const auto start = Clock::now();
+    index.rebuild((articles + chunk_size - 1) / chunk_size, threads,
+                  [&texts, articles, chunk_size](std::size_t chunk, SearchIndex::Part &part) {
+                      for (std::size_t i = chunk * chunk_size; i < std::min(articles, (chunk + 1) * chunk_size); ++i) {
+                          SearchIndex::Terms terms;
+                          terms.add(texts[i]);
+                          part.add(static_cast<int>(i + 1), terms.finish());
+                      }
+                  });
+    report_index(report, "synthetic_build", index, elapsed_ms(start));
+
+    const struct {
+        const char *name;
+        std::string query;
+    } queries[] = {
+        {"query_frequent", "w0"},
+        {"query_medium", "w100"},
+        {"query_rare", "w" + std::to_string(vocabulary / 2)},
+        {"query_two_terms", "w1 w50"},
+    };
+    std::printf("%-18s %10s %10s %10s\n", "query", "matches", "p50_us", "p99_us");
+    for (const auto &q : queries) {
+        const std::vector<std::string> terms = SearchIndex::query_terms(q.query);
+        std::size_t total = 0;
+        const Latency latency = measure(repeat, [&] { total = index.search(terms, 0, limit).total; });
+        std::printf("%-18s %10zu %10.2f %10.2f\n", q.name, total, latency.p50_us, latency.p99_us);
+        report.result(q.name)
+            .set("matches", static_cast<double>(total))
+            .set("p50_us", latency.p50_us)
+            .set("p99_us", latency.p99_us);
+    }
+}
+
+// Индекс по статьям из БД против ILIKE по тем же статьям
+static void run_db(BenchReport &report, std::size_t threads, long repeat, std::size_t limit) {
+    const std::string conn_str = env_string("BENCH_DB_CONN", env_string("DB_CONN", "dbname=blogdb user=bloguser"));
+    const long db_repeat = std::max(1L, env_long("BENCH_DB_REPEAT", 20));
+    std::vector<std::string> queries;
+    const std::string list = env_string("BENCH_QUERIES", "lorem;ipsum dolor;article 77;comment");
+    for (std::size_t begin = 0; begin <= list.size();) {
+        const std::size_t end = std::min(list.find(';', begin), list.size());
+        if (end > begin) {
+            queries.push_back(list.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    pqxx::connection conn(conn_str);
+    prepare_article_statements(conn);
+    std::vector<int> ids;
+    {
+        pqxx::nontransaction tx(conn);
+        ids = fetch_article_ids(tx);
+    }
+    // Как rebuild_search_index в сервисе: части по id, у каждого потока своё соединение
+    const std::size_t chunk_size = 5000;
+    SearchIndex index;
+    const auto start = Clock::now();
+    index.rebuild((ids.size() + chunk_size - 1) / chunk_size, threads,
+                  [&ids, &conn_str, chunk_size](std::size_t chunk, SearchIndex::Part &part) {
+                      pqxx::connection worker(conn_str);
+                      prepare_article_statements(worker);
+                      pqxx::nontransaction tx(worker);
+                      const int after_id = chunk == 0 ? 0 : ids[chunk * chunk_size - 1];
+                      const int last_id = ids[std::min(ids.size(), (chunk + 1) * chunk_size) - 1];
+                      fetch_search_documents(tx, after_id, last_id,
+                                             [&part](int id, std::string_view title, std::string_view content,
+                                                     std::string_view comments) {
+                                                 SearchIndex::Terms terms;
+                                                 terms.add(title);
+                                                 terms.add(content);
+                                                 terms.add(comments);
+                                                 part.add(id, terms.finish());
+                                             });
+                  });
+    report_index(report, "db_build", index, elapsed_ms(start));
+
+    // Все слова запроса должны найтись — в заголовке, тексте или одном из комментариев
+    const char *like_sql =
+        "SELECT a.id FROM articles a WHERE NOT EXISTS ("
+        "  SELECT 1 FROM unnest($1::text[]) p WHERE NOT ("
+        "    a.title ILIKE p OR a.content ILIKE p OR"
+        "    EXISTS (SELECT 1 FROM comments c WHERE c.article_id = a.id AND c.content ILIKE p))"
+        ") ORDER BY a.id LIMIT $2";
+    pqxx::nontransaction tx(conn);
+    std::printf("%-22s %10s %10s %12s %12s\n", "query", "index", "like", "index_p50_us", "like_p50_us");
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+        const std::vector<std::string> terms = SearchIndex::query_terms(queries[q]);
+        std::vector<std::string> patterns;
+        for (const std::string &term : terms) {
+            patterns.push_back("%" + term + "%");
+        }
+        std::size_t index_found = 0;
+        const Latency index_latency =
+            measure(repeat, [&] { index_found = index.search(terms, 0, limit).ids.size(); });
+        std::size_t like_found = 0;
+        const Latency like_latency = measure(db_repeat, [&] {
+            like_found = tx.exec_params(like_sql, patterns, static_cast<int>(limit)).size();
+        });
+        std::printf("%-22s %10zu %10zu %12.2f %12.2f\n", queries[q].c_str(), index_found, like_found,
+                    index_latency.p50_us, like_latency.p50_us);
+        report.result("db_query_" + std::to_string(q + 1))
+            .set("index_p50_us", index_latency.p50_us)
+            .set("index_p99_us", index_latency.p99_us)
+            .set("like_p50_us", like_latency.p50_us)
+            .set("like_p99_us", like_latency.p99_us);
+    }
+}
+
+int main() {
+    const std::size_t threads = static_cast<std::size_t>(std::max(1L, env_long("BENCH_THREADS", 4)));
+    const long repeat = std::max(1L, env_long("BENCH_REPEAT", 1000));
+    const std::size_t limit = static_cast<std::size_t>(std::max(1L, env_long("BENCH_LIMIT", 20)));
+    const bool db = env_string("BENCH_DB", "off") == "on";
+
+    BenchReport report("search_index_bench");
+    report.param("threads", static_cast<long long>(threads));
+    report.param("limit", static_cast<long long>(limit));
+    report.param("db", db ? "on" : "off");
+
+    run_synthetic(report, threads, repeat, limit);
+    if (db) {
+        try {
+            run_db(report, threads, repeat, limit);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "DB part failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return report.write(env_string("BENCH_OUTPUT", "")) ? 0 : 1;
+}
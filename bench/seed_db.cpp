@@ -0,0 +1,96 @@
+// bench/seed_db.cpp
+//
+// Заполняет локальную БД сервиса для нагрузочных замеров: SEED_ARTICLES статей по
+// SEED_COMMENTS комментариев, текст статьи — SEED_CONTENT_BYTES байт. Содержимое
+// детерминировано (зависит только от номера), поэтому замеры на разных машинах и
+// коммитах идут на одинаковых данных. Таблицы и индекс по comments.article_id
+// создаются, если их нет. SEED_RESET=on сначала очищает таблицы (TRUNCATE, все данные
+// БД сервиса теряются), и id начинаются с 1 — как ожидает load_generator
+// (BENCH_KEYS = SEED_ARTICLES). По умолчанию таблицы не очищаются: строки добавляются к
+// имеющимся, а если статьи уже есть, печатается предупреждение.
+// Строки генерирует сам PostgreSQL (generate_series), по SEED_BATCH статей на
+// транзакцию.
+//
+// После заполнения кеш сервиса нужно сбросить (redis-cli FLUSHDB) или перезапустить
+// сервис с пустым Redis. С установленными триггерами sql/cache_invalidation.sql каждая
+// строка даёт уведомление — для больших объёмов их лучше поставить после заполнения.
+//
+// Запуск: seed_db
+// Переменные: BENCH_DB_CONN (или DB_CONN, "dbname=blogdb user=bloguser"),
+//             SEED_ARTICLES (10000), SEED_COMMENTS (10), SEED_CONTENT_BYTES (500),
+//             SEED_BATCH (5000), SEED_RESET (off).
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "../src/config.h"
+
+int main() {
+    const std::string conn_str = env_string("BENCH_DB_CONN", env_string("DB_CONN", "dbname=blogdb user=bloguser"));
+    const long articles = std::max(0L, env_long("SEED_ARTICLES", 10000));
+    const long comments = std::max(0L, env_long("SEED_COMMENTS", 10));
+    const long content_bytes = std::max(1L, env_long("SEED_CONTENT_BYTES", 500));
+    const long batch = std::max(1L, env_long("SEED_BATCH", 5000));
+    const bool reset = env_string("SEED_RESET", "off") == "on";
+
+    try {
+        pqxx::connection conn(conn_str);
+        const auto start = std::chrono::steady_clock::now();
+        {
+            pqxx::work tx(conn);
+            tx.exec("CREATE TABLE IF NOT EXISTS articles ("
+                    "id serial PRIMARY KEY, title text NOT NULL, content text NOT NULL)");
+            tx.exec("CREATE TABLE IF NOT EXISTS comments ("
+                    "id serial PRIMARY KEY, article_id int NOT NULL REFERENCES articles (id) ON DELETE CASCADE, "
+                    "content text NOT NULL)");
+            tx.exec("CREATE INDEX IF NOT EXISTS comments_article_id_idx ON comments (article_id)");
+            if (reset) {
+                tx.exec("TRUNCATE comments, articles RESTART IDENTITY");
+            }
+            else if (tx.exec("SELECT EXISTS (SELECT 1 FROM articles)")[0][0].as<bool>()) {
+                std::cerr << "Warning: articles table is not empty, new ids will not start at 1; "
+                             "set SEED_RESET=on to truncate it first" << std::endl;
+            }
+            tx.commit();
+        }
+
+        // Статьи пачки и их комментарии одним запросом: id новых статей берутся из RETURNING
+        conn.prepare("seed_batch",
+            "WITH a AS ("
+            "INSERT INTO articles (title, content) "
+            "SELECT 'Article ' || g, left(repeat('Lorem ipsum dolor sit amet, consectetur adipiscing elit ' || g || '. ', "
+            "$3 / 50 + 1), $3) "
+            "FROM generate_series($1::int, $2::int) g RETURNING id) "
+            "INSERT INTO comments (article_id, content) "
+            "SELECT a.id, 'Comment ' || c || ' on article ' || a.id FROM a, generate_series(1, $4::int) c");
+
+        for (long from = 1; from <= articles; from += batch) {
+            const long to = std::min(articles, from + batch - 1);
+            pqxx::work tx(conn);
+            tx.exec_prepared("seed_batch", from, to, content_bytes, comments);
+            tx.commit();
+            std::printf("\rArticles %ld/%ld", to, articles);
+            std::fflush(stdout);
+        }
+        std::printf("\n");
+
+        {
+            pqxx::nontransaction tx(conn);
+            tx.exec("ANALYZE articles");
+            tx.exec("ANALYZE comments");
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("Seeded %ld articles x %ld comments (%ld rows) in %.1f s; flush the Redis cache before "
+                    "benchmarking\n",
+                    articles, comments, articles * (comments + 1), seconds);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Seeding failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+// bench/write_batch_bench.cpp
+//
+// Запись под смешанной нагрузкой: WRITERS потоков добавляют комментарии (и каждую
+// десятую запись — статью) через WriteBatcher, одновременно READERS потоков читают
+// статьи через тот же пул соединений (fetch_article). Сравниваются режимы:
+//   single  — max_batch = 1: транзакция на каждую запись, как без группировки;
+//   batched — max_batch = BENCH_BATCH, окно BENCH_DELAY_US.
+// Для каждого режима печатаются записей и чтений в секунду и p50/p99 задержки записи.
+//
+// Таблицы создаются в отдельной схеме bench_writes (search_path задаётся в строке
+// подключения), после замера схема удаляется; рабочие таблицы не затрагиваются.
+//
+// Запуск: write_batch_bench
+// Переменные: BENCH_DB_CONN (или DB_CONN), BENCH_WRITERS (32), BENCH_READERS (8),
+//             BENCH_SECONDS (10), BENCH_POOL (8), BENCH_BATCH (64), BENCH_DELAY_US (1000).
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/article_queries.h"
+#include "../src/config.h"
+#include "../src/db_pool.h"
+#include "../src/metrics.h"
+#include "../src/write_batcher.h"
+
+static const char *kSchema = "bench_writes";
+static const int kSeedArticles = 1000;
+
+static void create_schema(const std::string &conn_str) {
+    pqxx::connection conn(conn_str);
+    pqxx::work tx(conn);
+    tx.exec(std::string("DROP SCHEMA IF EXISTS ") + kSchema + " CASCADE");
+    tx.exec(std::string("CREATE SCHEMA ") + kSchema);
+    tx.exec(std::string("CREATE TABLE ") + kSchema + ".articles (id serial PRIMARY KEY, title text NOT NULL, content text NOT NULL)");
+    tx.exec(std::string("CREATE TABLE ") + kSchema + ".comments (id serial PRIMARY KEY, "
+            "article_id int NOT NULL REFERENCES " + kSchema + ".articles (id), content text NOT NULL)");
+    tx.exec(std::string("CREATE INDEX ON ") + kSchema + ".comments (article_id)");
+    tx.exec(std::string("INSERT INTO ") + kSchema + ".articles (title, content) "
+            "SELECT 'Article ' || g, repeat('Lorem ipsum dolor sit amet. ', 8) "
+            "FROM generate_series(1, " + std::to_string(kSeedArticles) + ") g");
+    tx.commit();
+}
+
+static void drop_schema(const std::string &conn_str) {
+    pqxx::connection conn(conn_str);
+    pqxx::work tx(conn);
+    tx.exec(std::string("DROP SCHEMA IF EXISTS ") + kSchema + " CASCADE");
+    tx.commit();
+}
+
+struct Result {
+    double writes_per_s = 0;
+    double reads_per_s = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    std::uint64_t batches = 0;
+};
+
+static Result run_mode(DbPool &pool, const WriteBatcher::Options &options, long writers, long readers, long seconds) {
+    // Ряды: 0 — записи, 1 — чтения
+    LatencyRecorder latency("bench", {"op=\"write\"", "op=\"read\""});
+    WriteBatcher batcher(pool, options, nullptr);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+
+    for (long w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            std::mt19937 rng(static_cast<unsigned>(w));
+            std::uniform_int_distribution<int> article(1, kSeedArticles);
+            for (long i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                const auto start = std::chrono::steady_clock::now();
+                WriteResult r = (i % 10 == 0)
+                    ? batcher.add_article("Bench article", "Written by writer " + std::to_string(w)).get()
+                    : batcher.add_comment(article(rng), "Comment " + std::to_string(i)).get();
+                latency.record(0, std::chrono::steady_clock::now() - start, r.status != WriteStatus::Created);
+            }
+        });
+    }
+    for (long r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(static_cast<unsigned>(1000 + r));
+            std::uniform_int_distribution<int> article(1, kSeedArticles);
+            std::string out;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto start = std::chrono::steady_clock::now();
+                bool failed = false;
+                try {
+                    auto conn = pool.acquire();
+                    pqxx::work tx(*conn);
+                    out.clear();
+                    fetch_article(tx, article(rng), out);
+                    tx.commit();
+                }
+                catch (const std::exception &) {
+                    failed = true;
+                }
+                latency.record(1, std::chrono::steady_clock::now() - start, failed);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    const auto writes = latency.snapshot(0);
+    const auto reads = latency.snapshot(1);
+    Result result;
+    result.writes_per_s = static_cast<double>(writes.count) / seconds;
+    result.reads_per_s = static_cast<double>(reads.count) / seconds;
+    result.p50_ms = writes.percentile(0.5) / 1000.0;
+    result.p99_ms = writes.percentile(0.99) / 1000.0;
+    result.batches = batcher.stats().batches;
+    if (writes.errors || reads.errors) {
+        std::cerr << "Errors: " << writes.errors << " writes, " << reads.errors << " reads" << std::endl;
+    }
+    return result;
+}
+
+int main() {
+    const std::string base_conn = env_string("BENCH_DB_CONN", env_string("DB_CONN", "dbname=blogdb user=bloguser"));
+    const std::string conn_str = base_conn + " options=-csearch_path=" + kSchema;
+    const long writers = std::max(1L, env_long("BENCH_WRITERS", 32));
+    const long readers = std::max(0L, env_long("BENCH_READERS", 8));
+    const long seconds = std::max(1L, env_long("BENCH_SECONDS", 10));
+
+    try {
+        create_schema(base_conn);
+
+        DbPool::Options pool_options;
+        pool_options.conn_str = conn_str;
+        pool_options.size = static_cast<std::size_t>(env_long("BENCH_POOL", 8));
+        DbPool pool(pool_options, prepare_article_statements);
+
+        WriteBatcher::Options single;
+        single.max_batch = 1;
+        single.max_delay = std::chrono::microseconds(0);
+        WriteBatcher::Options batched;
+        batched.max_batch = static_cast<std::size_t>(env_long("BENCH_BATCH", 64));
+        batched.max_delay = std::chrono::microseconds(env_long("BENCH_DELAY_US", 1000));
+
+        std::printf("writers=%ld readers=%ld seconds=%ld\n", writers, readers, seconds);
+        std::printf("%-8s %12s %12s %12s %12s %10s\n", "mode", "writes/s", "reads/s", "p50_ms", "p99_ms", "batches");
+        for (const auto &[name, options] : {std::make_pair("single", single), std::make_pair("batched", batched)}) {
+            const Result r = run_mode(pool, options, writers, readers, seconds);
+            std::printf("%-8s %12.0f %12.0f %12.2f %12.2f %10llu\n", name, r.writes_per_s, r.reads_per_s,
+                        r.p50_ms, r.p99_ms, static_cast<unsigned long long>(r.batches));
+        }
+        drop_schema(base_conn);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+// bench/zipf.h
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+// Генератор рангов Ципфа по таблице накопленных вероятностей: ранг 0 — самый частый,
+// ранг r выбирается с вероятностью ~ 1 / (r + 1)^s
+class ZipfGenerator {
+public:
+    ZipfGenerator(std::size_t n, double s) : cdf_(n) {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for (double &p : cdf_) {
+            p /= sum;
+        }
+    }
+
+    template <typename Rng>
+    std::size_t operator()(Rng &rng) const {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return std::min<std::size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin(), cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
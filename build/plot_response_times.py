@@ -3,17 +3,40 @@ import numpy as np
 import argparse
 from scipy.signal import medfilt
 
+# Запись бинарного дампа сервиса (LATENCY_DUMP_FILE): задержка в мкс, номер ряда, признак ошибки
+DUMP_DTYPE = np.dtype([('latency_us', '<u4'), ('series', '<u2'), ('error', '<u2')])
+
+
+def load_times(path, series_filter):
+    # Текстовый файл: по времени отклика в мс на строку
+    if not path.endswith('.bin'):
+        with open(path, 'r') as f:
+            return np.array([float(line.strip()) for line in f])
+
+    records = np.fromfile(path, dtype=DUMP_DTYPE)
+    if series_filter:
+        # Имена рядов лежат рядом с дампом: <файл>.series, по строке на номер ряда
+        with open(path + '.series', 'r') as f:
+            labels = [line.strip() for line in f]
+        wanted = [i for i, label in enumerate(labels) if series_filter in label]
+        records = records[np.isin(records['series'], wanted)]
+    return records['latency_us'] / 1000.0
+
+
 def main():
     # Парсинг аргументов командной строки
     parser = argparse.ArgumentParser(description="Отрисовка времени отклика с сглаживанием.")
     parser.add_argument('--window', type=int, default=100, help='Размер окна для сглаживания (нечетное для медианы)')
     parser.add_argument('--method', type=str, choices=['mean', 'median'], default='mean', help='Метод сглаживания')
+    parser.add_argument('--input', type=str, default='response_times.txt',
+                        help='Файл с временами: текстовый (мс) или бинарный дамп сервиса (*.bin)')
+    parser.add_argument('--series', type=str, default='route="article_random"',
+                        help='Подстрока меток ряда для фильтрации бинарного дампа (пусто — все запросы)')
     parser.add_argument('--output', type=str, default=None, help='Имя файла для сохранения графика')
     args = parser.parse_args()
 
     # Чтение данных из файла
-    with open('response_times.txt', 'r') as f:
-        times = np.array([float(line.strip()) for line in f])
+    times = load_times(args.input, args.series)
 
     # Убедимся, что размер окна не превышает длину данных
     window = min(args.window, len(times))
@@ -0,0 +1,43 @@
+-- sql/cache_invalidation.sql
+--
+-- Триггеры, сообщающие сервису об изменениях статей и комментариев (DB_NOTIFY=on).
+-- Уведомление в канале article_changes: "<table>:<op>:<article_id>", например
+-- "comments:INSERT:42". Уведомления отправляются при COMMIT; одинаковые уведомления
+-- одной транзакции PostgreSQL схлопывает в одно.
+--
+-- Применение: psql "$DB_CONN" -f sql/cache_invalidation.sql
+
+CREATE OR REPLACE FUNCTION notify_article_change() RETURNS trigger AS $$
+DECLARE
+    article integer;
+    old_article integer;
+BEGIN
+    IF TG_TABLE_NAME = 'articles' THEN
+        IF TG_OP <> 'INSERT' THEN old_article := OLD.id; END IF;
+        IF TG_OP <> 'DELETE' THEN article := NEW.id; END IF;
+    ELSE
+        IF TG_OP <> 'INSERT' THEN old_article := OLD.article_id; END IF;
+        IF TG_OP <> 'DELETE' THEN article := NEW.article_id; END IF;
+    END IF;
+
+    -- UPDATE, сменивший статью (id статьи или article_id комментария), сообщается как
+    -- удаление из старой статьи и добавление в новую
+    IF TG_OP = 'UPDATE' AND old_article IS DISTINCT FROM article THEN
+        PERFORM pg_notify('article_changes', TG_TABLE_NAME || ':DELETE:' || old_article);
+        PERFORM pg_notify('article_changes', TG_TABLE_NAME || ':INSERT:' || article);
+    ELSE
+        PERFORM pg_notify('article_changes', TG_TABLE_NAME || ':' || TG_OP || ':' || COALESCE(article, old_article));
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS articles_notify_change ON articles;
+CREATE TRIGGER articles_notify_change
+    AFTER INSERT OR UPDATE OR DELETE ON articles
+    FOR EACH ROW EXECUTE FUNCTION notify_article_change();
+
+DROP TRIGGER IF EXISTS comments_notify_change ON comments;
+CREATE TRIGGER comments_notify_change
+    AFTER INSERT OR UPDATE OR DELETE ON comments
+    FOR EACH ROW EXECUTE FUNCTION notify_article_change();
@@ -0,0 +1,167 @@
+// src/article_index.h
+
+#pragma once
+
+#include <sw/redis++/redis++.h>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "redis_breaker.h"
+
+// Множество существующих id статей для /article/random без ORDER BY RANDOM().
+//
+// Локально id лежат плотным массивом (плюс позиция каждого id в нём), поэтому
+// выбор случайного, добавление и удаление (перестановкой с последним) — O(1).
+// Если передан redis, множество дублируется в Redis-сет `articles:ids`, общий для
+// всех экземпляров, и случайный id берётся через SRANDMEMBER; при ошибке Redis или
+// разомкнутом автомате защиты breaker — из локального массива. Изменения, пропущенные
+// без Redis, сет получает при следующей полной сверке (reset). Полная загрузка сета
+// (SADD всех id) идёт через bulk — клиент с таймаутом для многоключевых команд, если он
+// передан.
+class ArticleIdIndex {
+public:
+    explicit ArticleIdIndex(sw::redis::Redis *redis = nullptr, RedisBreaker *breaker = nullptr,
+                            sw::redis::Redis *bulk = nullptr)
+        : redis_(redis), bulk_(bulk ? bulk : redis), breaker_(breaker) {}
+
+    ArticleIdIndex(const ArticleIdIndex &) = delete;
+    ArticleIdIndex &operator=(const ArticleIdIndex &) = delete;
+
+    // Полная замена содержимого (загрузка при старте и периодическая сверка с БД)
+    void reset(const std::vector<int> &ids) {
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            ids_.clear();
+            positions_.clear();
+            ids_.reserve(ids.size());
+            positions_.reserve(ids.size());
+            for (int id : ids) {
+                if (positions_.emplace(id, ids_.size()).second) {
+                    ids_.push_back(id);
+                }
+            }
+        }
+        if (redis_available()) {
+            replace_redis_set(ids);
+        }
+    }
+
+    void add(int id) {
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            if (positions_.emplace(id, ids_.size()).second) {
+                ids_.push_back(id);
+            }
+        }
+        if (redis_available()) {
+            try {
+                redis_->sadd(kRedisKey, std::to_string(id));
+            }
+            catch (const std::exception &e) {
+                redis_error("SADD error", e);
+            }
+        }
+    }
+
+    void remove(int id) {
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto it = positions_.find(id);
+            if (it != positions_.end()) {
+                const std::size_t pos = it->second;
+                const int last = ids_.back();
+                ids_[pos] = last;
+                positions_[last] = pos;
+                ids_.pop_back();
+                positions_.erase(id);
+            }
+        }
+        if (redis_available()) {
+            try {
+                redis_->srem(kRedisKey, std::to_string(id));
+            }
+            catch (const std::exception &e) {
+                redis_error("SREM error", e);
+            }
+        }
+    }
+
+    // std::nullopt, если статей нет
+    std::optional<int> random() const {
+        if (redis_available()) {
+            try {
+                auto member = redis_->srandmember(kRedisKey);
+                if (breaker_) {
+                    breaker_->success();
+                }
+                if (member) {
+                    return std::stoi(*member);
+                }
+            }
+            catch (const std::exception &e) {
+                redis_error("SRANDMEMBER error", e);
+            }
+        }
+        thread_local std::mt19937 rng{std::random_device{}()};
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (ids_.empty()) {
+            return std::nullopt;
+        }
+        std::uniform_int_distribution<std::size_t> pick(0, ids_.size() - 1);
+        return ids_[pick(rng)];
+    }
+
+    std::size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return ids_.size();
+    }
+
+private:
+    static constexpr const char *kRedisKey = "articles:ids";
+
+    bool redis_available() const { return redis_ && (!breaker_ || breaker_->allow()); }
+
+    void redis_error(const std::string &op, const std::exception &e) const {
+        if (breaker_) {
+            breaker_->failure(op + " (" + kRedisKey + ")", e);
+        }
+        else {
+            std::cerr << "Redis " << op << " (" << kRedisKey << "): " << e.what() << std::endl;
+        }
+    }
+
+    // Новый сет собирается под временным ключом и атомарно подменяет старый через RENAME
+    void replace_redis_set(const std::vector<int> &ids) {
+        try {
+            if (ids.empty()) {
+                bulk_->del(kRedisKey);
+                return;
+            }
+            std::vector<std::string> members;
+            members.reserve(ids.size());
+            for (int id : ids) {
+                members.push_back(std::to_string(id));
+            }
+            const std::string tmp_key = std::string(kRedisKey) + ":tmp:" + std::to_string(std::random_device{}());
+            bulk_->del(tmp_key);
+            bulk_->sadd(tmp_key, members.begin(), members.end());
+            bulk_->rename(tmp_key, kRedisKey);
+        }
+        catch (const std::exception &e) {
+            redis_error("error while loading", e);
+        }
+    }
+
+    sw::redis::Redis *redis_;
+    sw::redis::Redis *bulk_;
+    RedisBreaker *breaker_;
+    mutable std::shared_mutex mutex_;
+    std::vector<int> ids_;
+    std::unordered_map<int, std::size_t> positions_;
+};
@@ -0,0 +1,443 @@
+// src/article_queries.h
+
+#pragma once
+
+#include <pqxx/pqxx>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json_writer.h"
+#include "request_trace.h"
+
+// Подготовленные запросы сервиса. Регистрируются один раз на соединение (см. DbPool).
+inline void prepare_article_statements(pqxx::connection &conn) {
+    conn.prepare("list_article_ids", "SELECT id FROM articles ORDER BY id");
+    // Самые обсуждаемые статьи — кандидаты для прогрева кеша при старте
+    conn.prepare("list_hot_article_ids",
+        "SELECT article_id FROM comments GROUP BY article_id ORDER BY count(*) DESC LIMIT $1");
+    conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
+    conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
+
+    // Список статей собирается двумя запросами вместо 1 + N (по запросу на статью)
+    conn.prepare("list_articles", "SELECT id, title, content FROM articles");
+    conn.prepare("list_all_comments", "SELECT article_id, id, content FROM comments");
+
+    // Страница списка (keyset-пагинация по id) и комментарии только к её статьям
+    conn.prepare("list_articles_page", "SELECT id, title, content FROM articles WHERE id > $1 ORDER BY id LIMIT $2");
+    conn.prepare("list_comments_for", "SELECT article_id, id, content FROM comments WHERE article_id = ANY($1::int[])");
+    // Комментарии той же страницы без списка её id — не ждёт ответа list_articles_page
+    conn.prepare("list_comments_page",
+        "SELECT article_id, id, content FROM comments WHERE article_id IN "
+        "(SELECT id FROM articles WHERE id > $1 ORDER BY id LIMIT $2)");
+
+    // Несколько статей по списку id — недостающие фрагменты при сборке списка из кеша
+    conn.prepare("list_articles_by_ids", "SELECT id, title, content FROM articles WHERE id = ANY($1::int[])");
+
+    // Тексты статей для поискового индекса: заголовок, содержимое и комментарии одной строкой
+    conn.prepare("search_documents_range",
+        "SELECT a.id, a.title, a.content, COALESCE(string_agg(c.content, ' '), '') FROM articles a "
+        "LEFT JOIN comments c ON c.article_id = a.id WHERE a.id > $1 AND a.id <= $2 GROUP BY a.id ORDER BY a.id");
+    conn.prepare("search_documents_by_ids",
+        "SELECT a.id, a.title, a.content, COALESCE(string_agg(c.content, ' '), '') FROM articles a "
+        "LEFT JOIN comments c ON c.article_id = a.id WHERE a.id = ANY($1::int[]) GROUP BY a.id ORDER BY a.id");
+
+    // Тот же список целиком в JSON на стороне PostgreSQL: один запрос, C++ только отдаёт текст
+    conn.prepare("list_articles_json",
+        "SELECT json_build_object('articles', COALESCE(json_agg(json_build_object("
+        "'id', a.id, 'title', a.title, 'content', a.content, "
+        "'comments', COALESCE(c.comments, '[]'::json))), '[]'::json))::text "
+        "FROM articles a LEFT JOIN ("
+        "SELECT article_id, json_agg(json_build_object('id', id, 'content', content)) AS comments "
+        "FROM comments GROUP BY article_id) c ON c.article_id = a.id");
+
+    // Многострочные вставки для WriteBatcher: массивы входных значений разворачиваются
+    // через unnest, id берутся из последовательности заранее, чтобы вернуть их вместе с
+    // номером входной строки n (порядок строк RETURNING не гарантирован).
+    // Комментарии к несуществующим статьям не вставляются и в результат не попадают.
+    conn.prepare("insert_articles",
+        "WITH input AS ("
+        "SELECT t.n, t.title, t.content, nextval(pg_get_serial_sequence('articles', 'id'))::int AS id "
+        "FROM unnest($1::text[], $2::text[]) WITH ORDINALITY AS t(title, content, n)), "
+        "ins AS (INSERT INTO articles (id, title, content) SELECT id, title, content FROM input) "
+        "SELECT n, id FROM input");
+    conn.prepare("insert_comments",
+        "WITH input AS ("
+        "SELECT t.n, t.article_id, t.content, nextval(pg_get_serial_sequence('comments', 'id'))::int AS id "
+        "FROM unnest($1::int[], $2::text[]) WITH ORDINALITY AS t(article_id, content, n) "
+        "WHERE EXISTS (SELECT 1 FROM articles a WHERE a.id = t.article_id)), "
+        "ins AS (INSERT INTO comments (id, article_id, content) SELECT id, article_id, content FROM input) "
+        "SELECT n, id FROM input");
+}
+
+// Транзакция для чтения: без BEGIN и COMMIT, каждый из которых стоил бы отдельного
+// сетевого круга. Запросы одной отправки ReadBatch PostgreSQL и так выполняет в одной
+// неявной транзакции.
+using ReadTransaction = pqxx::nontransaction;
+
+// Подготовленный запрос с замером этапа db_query (см. request_trace.h)
+template <typename... Args>
+inline pqxx::result exec_query(pqxx::transaction_base &tx, const char *statement, const Args &...args) {
+    StageSpan span(Stage::DbQuery);
+    return tx.exec_prepared(statement, args...);
+}
+
+// Как отправляются запросы одного чтения (DB_READ_PIPELINE)
+enum class DbReadMode {
+    Sequential, // по одному: каждый запрос — отдельный сетевой круг
+    Pipeline    // все вместе через pqxx::pipeline: один сетевой круг на чтение
+};
+
+// Независимые запросы одного чтения. add() ставит подготовленный запрос с аргументами,
+// get() возвращает его результат. В режиме Pipeline запросы уходят на сервер вместе
+// (EXECUTE по тем же подготовленным запросам) при первом get(), в режиме Sequential
+// add() выполняет запрос сразу. Пока ReadBatch жив, tx нельзя использовать напрямую.
+class ReadBatch {
+public:
+    ReadBatch(pqxx::transaction_base &tx, DbReadMode mode) : tx_(tx) {
+        if (mode == DbReadMode::Pipeline) {
+            pipeline_.emplace(tx);
+            // Без retain pqxx::pipeline отправляет накопленное, как только ожидающих
+            // запросов больше двух, — и чтение снова стоит нескольких кругов. С ним всё
+            // добавленное уходит одной отправкой при первом get().
+            pipeline_->retain(kMaxQueries);
+        }
+    }
+
+    template <typename... Args>
+    std::size_t add(const char *statement, const Args &...args) {
+        if (!pipeline_) {
+            results_.push_back(exec_query(tx_, statement, args...));
+            return results_.size() - 1;
+        }
+        std::string sql = "EXECUTE ";
+        sql += statement;
+        if constexpr (sizeof...(Args) > 0) {
+            std::string params;
+            ((params += params.empty() ? "" : ", ", params += tx_.quote(args)), ...);
+            sql += '(' + params + ')';
+        }
+        queries_.push_back(pipeline_->insert(sql));
+        return queries_.size() - 1;
+    }
+
+    pqxx::result get(std::size_t index) {
+        if (!pipeline_) {
+            return results_[index];
+        }
+        // Первый get() ждёт весь сетевой круг, остальные забирают готовые результаты
+        StageSpan span(Stage::DbQuery);
+        return pipeline_->retrieve(queries_[index]);
+    }
+
+private:
+    static constexpr int kMaxQueries = 64;
+
+    pqxx::transaction_base &tx_;
+    std::optional<pqxx::pipeline> pipeline_;
+    std::vector<pqxx::pipeline::query_id> queries_;
+    std::vector<pqxx::result> results_;
+};
+
+// Все id статей по возрастанию (для индекса случайного выбора и сборки списка из фрагментов)
+inline std::vector<int> fetch_article_ids(pqxx::transaction_base &tx) {
+    pqxx::result r = exec_query(tx, "list_article_ids");
+    std::vector<int> ids;
+    ids.reserve(r.size());
+    for (const auto &row : r) {
+        ids.push_back(row[0].as<int>());
+    }
+    return ids;
+}
+
+// До limit id статей с наибольшим числом комментариев
+inline std::vector<int> fetch_hot_article_ids(pqxx::transaction_base &tx, int limit) {
+    pqxx::result r = exec_query(tx, "list_hot_article_ids", limit);
+    std::vector<int> ids;
+    ids.reserve(r.size());
+    for (const auto &row : r) {
+        ids.push_back(row[0].as<int>());
+    }
+    return ids;
+}
+
+// Тексты статей для поискового индекса (search_index.h) по возрастанию id:
+// fn(id, title, content, comments), комментарии статьи — одной строкой через пробел.
+// Статьи с id в (after_id, last_id].
+template <typename Fn>
+inline void fetch_search_documents(pqxx::transaction_base &tx, int after_id, int last_id, Fn &&fn) {
+    for (const auto &row : exec_query(tx, "search_documents_range", after_id, last_id)) {
+        fn(row[0].as<int>(), row[1].view(), row[2].view(), row[3].view());
+    }
+}
+
+// То же для статей ids; статей, которых нет в БД, в результате нет
+template <typename Fn>
+inline void fetch_search_documents(pqxx::transaction_base &tx, const std::vector<int> &ids, Fn &&fn) {
+    for (const auto &row : exec_query(tx, "search_documents_by_ids", ids)) {
+        fn(row[0].as<int>(), row[1].view(), row[2].view(), row[3].view());
+    }
+}
+
+// Как строится ответ GET /articles
+enum class ArticleListMode {
+    Grouped, // два запроса, группировка комментариев в памяти
+    PgJson,  // json_agg на стороне PostgreSQL
+    Stream   // построчное чтение курсором прямо в текст ответа
+};
+
+inline ArticleListMode article_list_mode_from(const std::string &name) {
+    if (name == "pg_json") {
+        return ArticleListMode::PgJson;
+    }
+    if (name == "stream") {
+        return ArticleListMode::Stream;
+    }
+    return ArticleListMode::Grouped;
+}
+
+// Поля статьи до списка комментариев включительно: {"id":..,"title":..,"content":..,"comments":[
+// Закрывается вызовом end_article().
+inline void begin_article(JsonWriter &json, int id, std::string_view title, std::string_view content) {
+    json.begin_object();
+    json.key("id").value(id);
+    json.key("title").value(title);
+    json.key("content").value(content);
+    json.key("comments").begin_array();
+}
+
+inline void end_article(JsonWriter &json) {
+    json.end_array().end_object();
+}
+
+inline void write_comment(JsonWriter &json, int id, std::string_view content) {
+    json.begin_object();
+    json.key("id").value(id);
+    json.key("content").value(content);
+    json.end_object();
+}
+
+// Номера строк комментариев (article_id, id, content), сгруппированные по статье
+using CommentsByArticle = std::unordered_map<int, std::vector<pqxx::result::size_type>>;
+
+// group_comments и write_articles_list принимают pqxx::result или любой набор строк с
+// тем же интерфейсом (row[i].as<int>(), row[i].view()) — например, синтетические строки
+// bench/micro_bench.cpp
+template <typename Result>
+inline CommentsByArticle group_comments(const Result &comments, std::size_t articles_hint) {
+    CommentsByArticle comments_by_article;
+    comments_by_article.reserve(articles_hint);
+    for (pqxx::result::size_type i = 0; i < static_cast<pqxx::result::size_type>(comments.size()); ++i) {
+        comments_by_article[comments[i][0].template as<int>()].push_back(i);
+    }
+    return comments_by_article;
+}
+
+// Массив статей (id, title, content) с комментариями из comments по comments_by_article
+template <typename Result>
+inline void write_articles_list(JsonWriter &json, const Result &articles, const Result &comments,
+                                const CommentsByArticle &comments_by_article) {
+    json.begin_array();
+    for (const auto &row : articles) {
+        const int id = row[0].template as<int>();
+        begin_article(json, id, row[1].view(), row[2].view());
+        auto it = comments_by_article.find(id);
+        if (it != comments_by_article.end()) {
+            for (pqxx::result::size_type i : it->second) {
+                const auto &c = comments[i];
+                write_comment(json, c[1].template as<int>(), c[2].view());
+            }
+        }
+        end_article(json);
+    }
+    json.end_array();
+}
+
+// Список статей одним проходом по курсору: строки соединения статей с комментариями
+// (отсортированные по id статьи) сразу дописываются в текст ответа. Не держит в памяти
+// ни pqxx::result, ни промежуточных структур — только сам ответ.
+// Чтение и сборка ответа перемежаются, поэтому всё время учитывается как db_query.
+inline void fetch_articles_json_streamed(pqxx::transaction_base &tx, std::string &out) {
+    StageSpan span(Stage::DbQuery);
+    JsonWriter json(out);
+    json.begin_object().key("articles").begin_array();
+
+    int current = 0;
+    bool has_article = false;
+    for (auto [id, title, content, comment_id, comment] :
+         tx.stream<int, std::string_view, std::string_view, std::optional<int>, std::optional<std::string_view>>(
+             "SELECT a.id, a.title, a.content, c.id, c.content "
+             "FROM articles a LEFT JOIN comments c ON c.article_id = a.id ORDER BY a.id")) {
+        if (!has_article || id != current) {
+            if (has_article) {
+                end_article(json);
+            }
+            has_article = true;
+            current = id;
+            begin_article(json, id, title, content);
+        }
+        if (comment_id) {
+            write_comment(json, *comment_id, comment.value_or(std::string_view()));
+        }
+    }
+    if (has_article) {
+        end_article(json);
+    }
+    json.end_array().end_object();
+}
+
+// Одна статья с комментариями дописывается в out. Возвращает false, если статьи нет.
+// В режиме Pipeline статья и комментарии запрашиваются за один сетевой круг.
+inline bool fetch_article(pqxx::transaction_base &tx, int article_id, std::string &out,
+                          DbReadMode mode = DbReadMode::Sequential) {
+    pqxx::result art;
+    pqxx::result comments;
+    if (mode == DbReadMode::Pipeline) {
+        ReadBatch batch(tx, mode);
+        const std::size_t art_query = batch.add("get_article", article_id);
+        const std::size_t comments_query = batch.add("get_comments", article_id);
+        art = batch.get(art_query);
+        comments = batch.get(comments_query);
+        if (art.empty()) {
+            return false;
+        }
+    }
+    else {
+        // Без конвейера комментарии не запрашиваются, если статьи нет
+        art = exec_query(tx, "get_article", article_id);
+        if (art.empty()) {
+            return false;
+        }
+        comments = exec_query(tx, "get_comments", article_id);
+    }
+
+    StageSpan span(Stage::Serialize);
+    JsonWriter json(out);
+    const auto &row = art[0];
+    begin_article(json, row[0].as<int>(), row[1].view(), row[2].view());
+    for (const auto &c : comments) {
+        write_comment(json, c[0].as<int>(), c[1].view());
+    }
+    end_article(json);
+    return true;
+}
+
+// Статьи ids с комментариями двумя запросами, каждая отдельным JSON-текстом — в том же
+// виде, что и fetch_article. Статей, которых нет в БД, в результате нет.
+inline std::unordered_map<int, std::string> fetch_article_fragments(pqxx::transaction_base &tx,
+                                                                    const std::vector<int> &ids,
+                                                                    DbReadMode mode = DbReadMode::Sequential) {
+    std::unordered_map<int, std::string> fragments;
+    if (ids.empty()) {
+        return fragments;
+    }
+    pqxx::result articles;
+    pqxx::result comments;
+    {
+        ReadBatch batch(tx, mode);
+        const std::size_t articles_query = batch.add("list_articles_by_ids", ids);
+        const std::size_t comments_query = batch.add("list_comments_for", ids);
+        articles = batch.get(articles_query);
+        comments = batch.get(comments_query);
+    }
+    StageSpan span(Stage::Serialize);
+    const CommentsByArticle comments_by_article = group_comments(comments, articles.size());
+
+    fragments.reserve(articles.size());
+    for (const auto &row : articles) {
+        const int id = row[0].as<int>();
+        JsonWriter json(fragments[id]);
+        begin_article(json, id, row[1].view(), row[2].view());
+        auto it = comments_by_article.find(id);
+        if (it != comments_by_article.end()) {
+            for (pqxx::result::size_type i : it->second) {
+                const auto &c = comments[i];
+                write_comment(json, c[1].as<int>(), c[2].view());
+            }
+        }
+        end_article(json);
+    }
+    return fragments;
+}
+
+// Все статьи с комментариями в виде JSON-текста {"articles":[...]}, дописывается в out
+inline void fetch_articles_json(pqxx::transaction_base &tx, ArticleListMode mode, std::string &out,
+                                DbReadMode read_mode = DbReadMode::Sequential) {
+    if (mode == ArticleListMode::PgJson) {
+        pqxx::result r = exec_query(tx, "list_articles_json");
+        out.append(r[0][0].view());
+        return;
+    }
+
+    if (mode == ArticleListMode::Stream) {
+        fetch_articles_json_streamed(tx, out);
+        return;
+    }
+
+    pqxx::result articles;
+    pqxx::result comments;
+    {
+        ReadBatch batch(tx, read_mode);
+        const std::size_t articles_query = batch.add("list_articles");
+        const std::size_t comments_query = batch.add("list_all_comments");
+        articles = batch.get(articles_query);
+        comments = batch.get(comments_query);
+    }
+    StageSpan span(Stage::Serialize);
+    const CommentsByArticle comments_by_article = group_comments(comments, articles.size());
+
+    JsonWriter json(out);
+    json.begin_object().key("articles");
+    write_articles_list(json, articles, comments, comments_by_article);
+    json.end_object();
+}
+
+// Страница списка: не больше limit статей с id > after_id по возрастанию id.
+// next_after_id — id последней статьи страницы или null, если страница последняя.
+// В режиме Pipeline комментарии выбираются подзапросом по той же странице
+// (list_comments_page) и уходят вместе со статьями.
+inline void fetch_articles_page_json(pqxx::transaction_base &tx, int after_id, int limit, std::string &out,
+                                     DbReadMode read_mode = DbReadMode::Sequential) {
+    pqxx::result articles;
+    pqxx::result comments;
+    if (read_mode == DbReadMode::Pipeline) {
+        ReadBatch batch(tx, read_mode);
+        const std::size_t articles_query = batch.add("list_articles_page", after_id, limit);
+        const std::size_t comments_query = batch.add("list_comments_page", after_id, limit);
+        articles = batch.get(articles_query);
+        comments = batch.get(comments_query);
+    }
+    else {
+        articles = exec_query(tx, "list_articles_page", after_id, limit);
+    }
+
+    std::vector<int> ids;
+    ids.reserve(articles.size());
+    for (const auto &row : articles) {
+        ids.push_back(row[0].as<int>());
+    }
+    if (read_mode != DbReadMode::Pipeline && !ids.empty()) {
+        comments = exec_query(tx, "list_comments_for", ids);
+    }
+    StageSpan span(Stage::Serialize);
+    CommentsByArticle comments_by_article;
+    if (!ids.empty()) {
+        comments_by_article = group_comments(comments, ids.size());
+    }
+
+    JsonWriter json(out);
+    json.begin_object().key("articles");
+    write_articles_list(json, articles, comments, comments_by_article);
+    json.key("next_after_id");
+    if (!ids.empty() && static_cast<int>(ids.size()) == limit) {
+        json.value(ids.back());
+    }
+    else {
+        json.null();
+    }
+    json.end_object();
+}
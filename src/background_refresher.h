@@ -0,0 +1,145 @@
+// src/background_refresher.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Фоновое обновление ключей кеша (stale-while-revalidate).
+//
+// schedule(key, task) ставит задачу в очередь, если по этому ключу ещё нет ожидающей
+// или выполняемой задачи: пока ключ обновляется, повторные запросы к устаревшему
+// значению очередь не засоряют. Задачи выполняют workers фоновых потоков; при
+// переполнении очереди задача отбрасывается — устаревшее значение доживёт до жёсткого
+// TTL, и ключ пересоберёт обычный промах. Задача возвращает false, если ключ не
+// обновлён из-за перегрузки (503 исполнителя БД), — такие считаются отдельно (shed).
+class BackgroundRefresher {
+public:
+    struct Options {
+        std::size_t workers = 2;
+        std::size_t max_queue = 1024;
+    };
+
+    struct Stats {
+        std::uint64_t scheduled = 0;
+        std::uint64_t deduplicated = 0; // ключ уже в очереди или обновляется
+        std::uint64_t dropped = 0;      // очередь переполнена
+        std::uint64_t completed = 0;
+        std::uint64_t shed = 0; // отказ по перегрузке, ключ не обновлён
+        std::uint64_t failed = 0;
+        std::size_t queued = 0;
+    };
+
+    explicit BackgroundRefresher(Options options) : options_(options) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(options_.workers, 1); ++i) {
+            threads_.emplace_back([this] { loop(); });
+        }
+    }
+
+    ~BackgroundRefresher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    BackgroundRefresher(const BackgroundRefresher &) = delete;
+    BackgroundRefresher &operator=(const BackgroundRefresher &) = delete;
+
+    // Возвращает true, если задача поставлена в очередь
+    bool schedule(const std::string &key, std::function<bool()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return false;
+            }
+            if (active_.count(key)) {
+                deduplicated_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (queue_.size() >= options_.max_queue) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            active_.insert(key);
+            queue_.emplace_back(key, std::move(task));
+        }
+        scheduled_.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+        return true;
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.scheduled = scheduled_.load(std::memory_order_relaxed);
+        s.deduplicated = deduplicated_.load(std::memory_order_relaxed);
+        s.dropped = dropped_.load(std::memory_order_relaxed);
+        s.completed = completed_.load(std::memory_order_relaxed);
+        s.shed = shed_.load(std::memory_order_relaxed);
+        s.failed = failed_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.queued = queue_.size();
+        return s;
+    }
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return; // оставшиеся обновления не нужны: процесс завершается
+            }
+            auto [key, task] = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            try {
+                if (task()) {
+                    completed_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else {
+                    shed_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            catch (const std::exception &e) {
+                failed_.fetch_add(1, std::memory_order_relaxed);
+                std::cerr << "Background refresh of " << key << " failed: " << e.what() << std::endl;
+            }
+
+            lock.lock();
+            active_.erase(key);
+        }
+    }
+
+    const Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<std::string, std::function<bool()>>> queue_;
+    std::unordered_set<std::string> active_; // в очереди или выполняются
+    bool stopping_ = false;
+
+    std::atomic<std::uint64_t> scheduled_{0};
+    std::atomic<std::uint64_t> deduplicated_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> completed_{0};
+    std::atomic<std::uint64_t> shed_{0};
+    std::atomic<std::uint64_t> failed_{0};
+
+    std::vector<std::thread> threads_; // последним: потоки стартуют, когда остальные поля готовы
+};
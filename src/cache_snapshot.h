@@ -0,0 +1,415 @@
+// src/cache_snapshot.h
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Снимок горячих записей кеша на диске для тёплого рестарта.
+//
+// Файл: заголовок, записи подряд, завершающий блок. Запись — ключ, значение (запись
+// кеша целиком, с ETag и сжатыми вариантами, см. encode_entry) и срок жизни в unix ms,
+// выровнены на 8 байт, с CRC32 заголовка записи, ключа и значения. Формат — в порядке
+// байтов машины: снимок читает тот же сервис на том же хосте.
+//
+// Запись crash-safe: снимок пишется во временный файл рядом, fsync, rename поверх
+// старого и fsync каталога — на диске всегда целый старый или целый новый снимок.
+// Завершающий блок с числом записей отсекает файлы, оборванные не там, где ждали.
+//
+// Чтение ленивое: open() отображает файл через mmap и строит индекс ключей только по
+// заголовкам записей. Значение копируется из отображения (с проверкой CRC) при первом
+// take() — то есть при первом обращении к ключу после старта. Записи со сломанной CRC
+// и истёкшие не отдаются. Ключ выходит из снимка, когда его значение заменено (erase:
+// новая запись или инвалидация); когда ключей не осталось, отображение снимается.
+class CacheSnapshot {
+public:
+    using Value = std::shared_ptr<const std::string>;
+
+    static constexpr std::uint32_t kVersion = 1;
+
+    struct Entry {
+        std::string_view key;
+        std::string_view value;
+        std::int64_t expires_ms = 0; // unix ms
+    };
+
+    struct Stats {
+        std::size_t loaded = 0;       // записей в индексе после open()
+        std::size_t remaining = 0;    // ещё не заменены и не проверены
+        std::uint64_t hits = 0;       // отдано take()
+        std::uint64_t expired = 0;    // истекли к моменту чтения
+        std::uint64_t corrupt = 0;    // не сошлась CRC
+        std::int64_t created_ms = 0;  // когда снимок записан (unix ms)
+        std::int64_t load_us = 0;     // open(): mmap и индекс
+    };
+
+    CacheSnapshot() = default;
+    ~CacheSnapshot() { unmap(); }
+
+    CacheSnapshot(const CacheSnapshot &) = delete;
+    CacheSnapshot &operator=(const CacheSnapshot &) = delete;
+
+    static std::int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Пишет entries в path атомарно (см. выше). Ошибка — исключение с причиной.
+    static std::size_t write(const std::string &path, const std::vector<Entry> &entries) {
+        const std::string tmp_path = path + ".tmp." + std::to_string(::getpid());
+        std::FILE *file = std::fopen(tmp_path.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("cannot create " + tmp_path + ": " + std::strerror(errno));
+        }
+        std::size_t bytes = 0;
+        auto put = [&](const void *data, std::size_t size) {
+            if (size && std::fwrite(data, 1, size, file) != size) {
+                const std::string reason = std::strerror(errno);
+                std::fclose(file);
+                std::remove(tmp_path.c_str());
+                throw std::runtime_error("cannot write " + tmp_path + ": " + reason);
+            }
+            bytes += size;
+        };
+        static const char kPadding[8] = {};
+
+        FileHeader header{};
+        std::memcpy(header.magic, kHeaderMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.byte_order = kByteOrder;
+        header.count = entries.size();
+        header.created_ms = now_ms();
+        put(&header, sizeof(header));
+        for (const Entry &entry : entries) {
+            RecordHeader record{};
+            record.key_size = static_cast<std::uint32_t>(entry.key.size());
+            record.value_size = static_cast<std::uint32_t>(entry.value.size());
+            record.expires_ms = entry.expires_ms;
+            record.crc = record_crc(record, entry.key, entry.value);
+            put(&record, sizeof(record));
+            put(entry.key.data(), entry.key.size());
+            put(entry.value.data(), entry.value.size());
+            put(kPadding, padding(entry.key.size() + entry.value.size()));
+        }
+        FileTrailer trailer{};
+        std::memcpy(trailer.magic, kTrailerMagic, sizeof(trailer.magic));
+        trailer.count = entries.size();
+        trailer.header_crc = static_cast<std::uint32_t>(
+            crc32(0L, reinterpret_cast<const Bytef *>(&header), sizeof(header)));
+        put(&trailer, sizeof(trailer));
+
+        const bool flushed = std::fflush(file) == 0 && ::fsync(::fileno(file)) == 0;
+        const std::string reason = std::strerror(errno);
+        if (std::fclose(file) != 0 || !flushed) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("cannot flush " + tmp_path + ": " + reason);
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            const std::string rename_reason = std::strerror(errno);
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("cannot rename " + tmp_path + ": " + rename_reason);
+        }
+        // Переименование переживает сбой только после fsync каталога
+        const std::size_t slash = path.rfind('/');
+        const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir_fd >= 0) {
+            ::fsync(dir_fd);
+            ::close(dir_fd);
+        }
+        return bytes;
+    }
+
+    // Отображает снимок и строит индекс. false — файла нет, он старше max_age или
+    // повреждён (причина в std::cerr, кроме отсутствия файла).
+    bool open(const std::string &path, std::chrono::seconds max_age) {
+        const auto start = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        unmap_locked();
+
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                std::cerr << "Cache snapshot: cannot open " << path << ": " << std::strerror(errno) << std::endl;
+            }
+            return false;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FileHeader) + sizeof(FileTrailer)) {
+            ::close(fd);
+            std::cerr << "Cache snapshot: " << path << " is truncated, ignored" << std::endl;
+            return false;
+        }
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // отображение держит файл само
+        if (data == MAP_FAILED) {
+            std::cerr << "Cache snapshot: mmap of " << path << " failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        data_ = static_cast<const char *>(data);
+        size_ = size;
+
+        const char *reason = index_locked(max_age);
+        if (reason) {
+            std::cerr << "Cache snapshot: " << path << " " << reason << ", ignored" << std::endl;
+            unmap_locked();
+            return false;
+        }
+        loaded_ = slots_.size();
+        remaining_.store(slots_.size(), std::memory_order_relaxed);
+        load_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (slots_.empty()) {
+            unmap_locked();
+        }
+        return true;
+    }
+
+    // Значение ключа и оставшийся срок жизни; каждый ключ отдаётся один раз (дальше он
+    // живёт в L1), но остаётся в снимке до erase() — до проверки по БД
+    Value take(const std::string &key, std::chrono::milliseconds &ttl) {
+        if (untaken_.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(key);
+        if (it == slots_.end() || it->second.taken) {
+            return nullptr;
+        }
+        RecordHeader record;
+        std::memcpy(&record, it->second.record, sizeof(record));
+        const std::string_view stored_key(it->second.record + sizeof(record), record.key_size);
+        const std::string_view value(stored_key.data() + record.key_size, record.value_size);
+
+        const std::int64_t left = record.expires_ms - now_ms();
+        if (left <= 0) {
+            expired_.fetch_add(1, std::memory_order_relaxed);
+            remove_locked(it);
+            return nullptr;
+        }
+        if (record_crc(record, stored_key, value) != record.crc) {
+            corrupt_.fetch_add(1, std::memory_order_relaxed);
+            remove_locked(it);
+            return nullptr;
+        }
+        it->second.taken = true;
+        untaken_.fetch_sub(1, std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        ttl = std::chrono::milliseconds(left);
+        return std::make_shared<const std::string>(value);
+    }
+
+    // Ключ заменён новым значением или сброшен: снимок его больше не отдаёт
+    void erase(const std::string &key) {
+        if (remaining_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(key);
+        if (it != slots_.end()) {
+            remove_locked(it);
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unmap_locked();
+    }
+
+    bool contains(const std::string &key) const {
+        if (remaining_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slots_.count(key) != 0;
+    }
+
+    // Следующие (в порядке файла) до n ключей, оставшихся в снимке, — для фоновой
+    // проверки по БД; пустой вектор — ключи кончились
+    std::vector<std::string> next_keys(std::size_t n) {
+        std::vector<std::string> keys;
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (keys.size() < n && cursor_ < order_.size()) {
+            const std::string_view key = order_[cursor_++];
+            if (slots_.count(key)) {
+                keys.emplace_back(key);
+            }
+        }
+        return keys;
+    }
+
+    std::size_t remaining() const { return remaining_.load(std::memory_order_relaxed); }
+
+    Stats stats() const {
+        Stats s;
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.loaded = loaded_;
+        s.remaining = slots_.size();
+        s.hits = hits_.load(std::memory_order_relaxed);
+        s.expired = expired_.load(std::memory_order_relaxed);
+        s.corrupt = corrupt_.load(std::memory_order_relaxed);
+        s.created_ms = created_ms_;
+        s.load_us = load_us_;
+        return s;
+    }
+
+private:
+    static constexpr char kHeaderMagic[8] = {'C', 'S', 'N', 'A', 'P', '0', '0', '1'};
+    static constexpr char kTrailerMagic[8] = {'C', 'S', 'N', 'A', 'P', 'E', 'N', 'D'};
+    static constexpr std::uint32_t kByteOrder = 0x01020304;
+
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t count;
+        std::int64_t created_ms;
+    };
+
+    struct RecordHeader {
+        std::uint32_t key_size;
+        std::uint32_t value_size;
+        std::int64_t expires_ms;
+        std::uint32_t crc; // заголовок с crc = 0, ключ, значение
+        std::uint32_t reserved;
+    };
+
+    struct FileTrailer {
+        char magic[8];
+        std::uint64_t count;
+        std::uint32_t header_crc;
+        std::uint32_t reserved;
+    };
+
+    struct Slot {
+        const char *record; // RecordHeader в отображении
+        bool taken = false;
+    };
+    using SlotMap = std::unordered_map<std::string_view, Slot>;
+
+    static std::size_t padding(std::size_t size) { return (8 - size % 8) % 8; }
+
+    static std::uint32_t record_crc(RecordHeader record, std::string_view key, std::string_view value) {
+        record.crc = 0;
+        uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(&record), sizeof(record));
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(key.data()), static_cast<uInt>(key.size()));
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(value.data()), static_cast<uInt>(value.size()));
+        return static_cast<std::uint32_t>(crc);
+    }
+
+    // Проверяет заголовок и завершающий блок, строит индекс. nullptr — успех, иначе причина.
+    const char *index_locked(std::chrono::seconds max_age) {
+        FileHeader header;
+        FileTrailer trailer;
+        std::memcpy(&header, data_, sizeof(header));
+        std::memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+        if (std::memcmp(header.magic, kHeaderMagic, sizeof(header.magic)) != 0 || header.version != kVersion ||
+            header.byte_order != kByteOrder) {
+            return "has an unknown format";
+        }
+        if (std::memcmp(trailer.magic, kTrailerMagic, sizeof(trailer.magic)) != 0 || trailer.count != header.count ||
+            trailer.header_crc != crc32(0L, reinterpret_cast<const Bytef *>(&header), sizeof(header))) {
+            return "is incomplete";
+        }
+        created_ms_ = header.created_ms;
+        const std::int64_t now = now_ms();
+        if (now - header.created_ms > std::chrono::duration_cast<std::chrono::milliseconds>(max_age).count()) {
+            return "is too old";
+        }
+
+        const std::size_t end = size_ - sizeof(trailer);
+        std::size_t offset = sizeof(header);
+        slots_.reserve(static_cast<std::size_t>(header.count));
+        order_.reserve(static_cast<std::size_t>(header.count));
+        for (std::uint64_t i = 0; i < header.count; ++i) {
+            RecordHeader record;
+            if (end - offset < sizeof(record)) {
+                return "has a record past its end";
+            }
+            std::memcpy(&record, data_ + offset, sizeof(record));
+            const std::size_t body = std::size_t{record.key_size} + record.value_size;
+            if (end - offset - sizeof(record) < body + padding(body)) {
+                return "has a record past its end";
+            }
+            const std::string_view key(data_ + offset + sizeof(record), record.key_size);
+            if (record.expires_ms > now) {
+                if (slots_.emplace(key, Slot{data_ + offset}).second) {
+                    order_.push_back(key);
+                }
+            }
+            else {
+                expired_.fetch_add(1, std::memory_order_relaxed);
+            }
+            offset += sizeof(record) + body + padding(body);
+        }
+        if (offset != end) {
+            return "has trailing data";
+        }
+        untaken_.store(slots_.size(), std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void remove_locked(SlotMap::iterator it) {
+        if (!it->second.taken) {
+            untaken_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        slots_.erase(it);
+        remaining_.store(slots_.size(), std::memory_order_relaxed);
+        if (slots_.empty()) {
+            unmap_locked();
+        }
+    }
+
+    void unmap() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unmap_locked();
+    }
+
+    // Ключи индекса ссылаются на отображение, поэтому снимаются вместе с ним
+    void unmap_locked() {
+        slots_.clear();
+        order_.clear();
+        cursor_ = 0;
+        remaining_.store(0, std::memory_order_relaxed);
+        untaken_.store(0, std::memory_order_relaxed);
+        if (data_) {
+            ::munmap(const_cast<char *>(data_), size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    mutable std::mutex mutex_;
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    SlotMap slots_;
+    std::vector<std::string_view> order_; // порядок файла, для next_keys()
+    std::size_t cursor_ = 0;
+    std::atomic<std::size_t> remaining_{0}; // slots_.size(): быстрый выход без блокировки
+    std::atomic<std::size_t> untaken_{0};   // ещё не отданные take()
+
+    std::size_t loaded_ = 0;
+    std::int64_t created_ms_ = 0;
+    std::int64_t load_us_ = 0;
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> expired_{0};
+    std::atomic<std::uint64_t> corrupt_{0};
+};
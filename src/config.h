@@ -0,0 +1,30 @@
+// src/config.h
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+// Чтение настроек из переменных окружения (см. раздел «Конфигурация» в README).
+// Если переменная не задана или не разбирается, используется значение по умолчанию.
+
+inline std::string env_string(const char *name, const std::string &fallback) {
+    const char *value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    return value;
+}
+
+inline long env_long(const char *name, long fallback) {
+    const char *value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    char *end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0') {
+        return fallback;
+    }
+    return parsed;
+}
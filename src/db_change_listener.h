@@ -0,0 +1,187 @@
+// src/db_change_listener.h
+
+#pragma once
+
+#include <pqxx/pqxx>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Изменение из уведомления триггера (sql/cache_invalidation.sql): "<table>:<op>:<article_id>"
+struct DbChange {
+    int article_id = 0;
+    bool article_row = false; // изменилась сама статья, иначе — её комментарии
+    bool membership = false;  // статья добавлена (added) или удалена
+    bool added = false;
+};
+
+inline bool parse_db_change(const std::string &payload, DbChange &change) {
+    char table[16] = {};
+    char op[16] = {};
+    int article_id = 0;
+    if (std::sscanf(payload.c_str(), "%15[^:]:%15[^:]:%d", table, op, &article_id) != 3) {
+        return false;
+    }
+    change.article_id = article_id;
+    change.article_row = std::strcmp(table, "articles") == 0;
+    change.added = change.article_row && std::strcmp(op, "INSERT") == 0;
+    change.membership = change.added || (change.article_row && std::strcmp(op, "DELETE") == 0);
+    return true;
+}
+
+// Установлены и включены ли оба триггера из sql/cache_invalidation.sql. Без них LISTEN
+// молчит, и кеш устаревает до конца TTL.
+inline bool db_change_triggers_installed(pqxx::transaction_base &tx) {
+    const pqxx::result r = tx.exec(
+        "SELECT count(*) FROM pg_trigger WHERE NOT tgisinternal AND tgenabled <> 'D' AND ("
+        "(tgname = 'articles_notify_change' AND tgrelid = to_regclass('articles')) OR "
+        "(tgname = 'comments_notify_change' AND tgrelid = to_regclass('comments')))");
+    return r[0][0].as<int>() == 2;
+}
+
+// Поток, слушающий LISTEN/NOTIFY PostgreSQL на отдельном соединении.
+//
+// Уведомления, пришедшие за один проход ожидания, передаются в on_changes одной пачкой.
+// При потере соединения поток переподключается раз в reconnect_delay; после
+// переподключения (уже с активным LISTEN) вызывается on_resync: уведомления, отправленные,
+// пока соединения не было, потеряны, и кеш нужно сверить целиком. При первом
+// подключении on_resync не вызывается.
+class DbChangeListener {
+public:
+    using ChangesHandler = std::function<void(const std::vector<DbChange> &)>;
+    using ResyncHandler = std::function<void()>;
+
+    struct Options {
+        std::string conn_str;
+        std::string channel = "article_changes";
+        std::chrono::milliseconds reconnect_delay{1000};
+    };
+
+    struct Stats {
+        bool connected = false;
+        std::uint64_t notifications = 0;
+        std::uint64_t malformed = 0;
+        std::uint64_t batches = 0;
+        std::uint64_t reconnects = 0;
+        std::uint64_t resyncs = 0;
+    };
+
+    DbChangeListener(Options options, ChangesHandler on_changes, ResyncHandler on_resync)
+        : options_(std::move(options)),
+          on_changes_(std::move(on_changes)),
+          on_resync_(std::move(on_resync)),
+          thread_([this] { loop(); }) {}
+
+    ~DbChangeListener() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    DbChangeListener(const DbChangeListener &) = delete;
+    DbChangeListener &operator=(const DbChangeListener &) = delete;
+
+    Stats stats() const {
+        Stats s;
+        s.connected = connected_.load(std::memory_order_relaxed);
+        s.notifications = notifications_.load(std::memory_order_relaxed);
+        s.malformed = malformed_.load(std::memory_order_relaxed);
+        s.batches = batches_.load(std::memory_order_relaxed);
+        s.reconnects = reconnects_.load(std::memory_order_relaxed);
+        s.resyncs = resyncs_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    // Получатель уведомлений канала: копит изменения до конца прохода ожидания
+    class Receiver : public pqxx::notification_receiver {
+    public:
+        Receiver(pqxx::connection &conn, const std::string &channel, DbChangeListener &owner)
+            : pqxx::notification_receiver(conn, channel), owner_(owner) {}
+
+        void operator()(const std::string &payload, int) override {
+            owner_.notifications_.fetch_add(1, std::memory_order_relaxed);
+            DbChange change;
+            if (parse_db_change(payload, change)) {
+                pending.push_back(change);
+            }
+            else {
+                owner_.malformed_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<DbChange> pending;
+
+    private:
+        DbChangeListener &owner_;
+    };
+
+    bool stopping() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_;
+    }
+
+    void loop() {
+        bool connected_before = false;
+        while (!stopping()) {
+            try {
+                pqxx::connection conn(options_.conn_str);
+                Receiver receiver(conn, options_.channel, *this); // выполняет LISTEN
+                connected_.store(true, std::memory_order_relaxed);
+                if (connected_before) {
+                    reconnects_.fetch_add(1, std::memory_order_relaxed);
+                    resyncs_.fetch_add(1, std::memory_order_relaxed);
+                    on_resync_();
+                }
+                connected_before = true;
+
+                while (!stopping()) {
+                    // Возвращается по уведомлению или через секунду, чтобы заметить остановку
+                    conn.await_notification(1, 0);
+                    if (!receiver.pending.empty()) {
+                        batches_.fetch_add(1, std::memory_order_relaxed);
+                        on_changes_(receiver.pending);
+                        receiver.pending.clear();
+                    }
+                }
+                return;
+            }
+            catch (const std::exception &e) {
+                std::cerr << "DB change listener error: " << e.what() << std::endl;
+            }
+            connected_.store(false, std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, options_.reconnect_delay, [this] { return stopping_; });
+        }
+    }
+
+    const Options options_;
+    ChangesHandler on_changes_;
+    ResyncHandler on_resync_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    std::atomic<bool> connected_{false};
+    std::atomic<std::uint64_t> notifications_{0};
+    std::atomic<std::uint64_t> malformed_{0};
+    std::atomic<std::uint64_t> batches_{0};
+    std::atomic<std::uint64_t> reconnects_{0};
+    std::atomic<std::uint64_t> resyncs_{0};
+
+    std::thread thread_; // последним: поток стартует, когда остальные поля готовы
+};
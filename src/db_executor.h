@@ -0,0 +1,220 @@
+// src/db_executor.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+
+// Очередь DbExecutor заполнена: запрос отклоняется сразу, не дожидаясь БД.
+class DbOverloaded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Задача не успела выполниться за отведённый срок (ждала в очереди или выполнялась).
+class DbDeadlineExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Ограниченный исполнитель работы с БД.
+//
+// Обращения к PostgreSQL выполняют threads собственных потоков, а не рабочие потоки
+// Crow. Вызывающий поток ждёт результат не дольше deadline; задачи сверх max_queue
+// ожидающих отклоняются сразу (DbOverloaded). Так число потоков Crow, занятых
+// ожиданием БД, не превышает threads + max_queue, а остальные продолжают отдавать
+// ответы из кеша. Задача, чей срок истёк ещё в очереди, не выполняется; задача,
+// которую вызывающий перестал ждать во время выполнения, доводится до конца (её
+// результат, как правило, всё равно попадает в кеш).
+class DbExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::size_t threads = 4;
+        std::size_t max_queue = 64;
+        std::chrono::milliseconds deadline{1000};
+        // Необязательная гистограмма ожидания в очереди: ряд 0 — выполненные задачи,
+        // ряд 1 — снятые по сроку (см. wait_labels())
+        LatencyRecorder *queue_wait = nullptr;
+    };
+
+    struct Stats {
+        std::uint64_t submitted = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t rejected = 0;  // очередь заполнена
+        std::uint64_t expired = 0;   // срок истёк в очереди, задача не выполнялась
+        std::uint64_t timed_out = 0; // вызывающий не дождался результата
+        std::uint64_t wait_us_total = 0;
+        std::uint64_t wait_us_max = 0;
+        std::size_t queued = 0;
+        std::size_t running = 0;
+    };
+
+    static std::vector<std::string> wait_labels() {
+        return {"result=\"run\"", "result=\"expired\""};
+    }
+
+    explicit DbExecutor(Options options) : options_(options) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(options_.threads, 1); ++i) {
+            threads_.emplace_back([this] { loop(); });
+        }
+    }
+
+    ~DbExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    DbExecutor(const DbExecutor &) = delete;
+    DbExecutor &operator=(const DbExecutor &) = delete;
+
+    // Выполняет fn() в потоке исполнителя и возвращает его результат (исключения fn
+    // пробрасываются). Бросает DbOverloaded, если очередь заполнена, и
+    // DbDeadlineExceeded, если результат не получен за deadline.
+    template <typename Fn>
+    std::invoke_result_t<Fn &> run(Fn &&fn) {
+        using R = std::invoke_result_t<Fn &>;
+        static_assert(!std::is_void_v<R>, "DbExecutor::run ожидает задачу с результатом");
+
+        auto promise = std::make_shared<std::promise<R>>();
+        std::future<R> result = promise->get_future();
+        const auto now = Clock::now();
+        Job job;
+        job.enqueued = now;
+        job.deadline = now + options_.deadline;
+        job.fn = [promise, fn = std::forward<Fn>(fn)](bool expired) mutable {
+            if (expired) {
+                promise->set_exception(std::make_exception_ptr(DbDeadlineExceeded("DB deadline exceeded in queue")));
+                return;
+            }
+            try {
+                promise->set_value(fn());
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || queue_.size() >= options_.max_queue) {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                throw DbOverloaded("DB executor queue is full");
+            }
+            queue_.push_back(std::move(job));
+        }
+        submitted_.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+
+        if (result.wait_until(now + options_.deadline) != std::future_status::ready) {
+            timed_out_.fetch_add(1, std::memory_order_relaxed);
+            throw DbDeadlineExceeded("DB deadline exceeded");
+        }
+        return result.get();
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.submitted = submitted_.load(std::memory_order_relaxed);
+        s.completed = completed_.load(std::memory_order_relaxed);
+        s.rejected = rejected_.load(std::memory_order_relaxed);
+        s.expired = expired_.load(std::memory_order_relaxed);
+        s.timed_out = timed_out_.load(std::memory_order_relaxed);
+        s.wait_us_total = wait_us_total_.load(std::memory_order_relaxed);
+        s.wait_us_max = wait_us_max_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.queued = queue_.size();
+        s.running = running_;
+        return s;
+    }
+
+private:
+    struct Job {
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        std::function<void(bool expired)> fn;
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return; // stopping_ и очередь разобрана
+            }
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            const auto start = Clock::now();
+            const bool expired = stopping_ || start >= job.deadline;
+            if (!expired) {
+                ++running_;
+            }
+            lock.unlock();
+
+            record_wait(start - job.enqueued, expired);
+            job.fn(expired);
+            if (expired) {
+                expired_.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                completed_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            lock.lock();
+            if (!expired) {
+                --running_;
+            }
+        }
+    }
+
+    void record_wait(Clock::duration waited, bool expired) {
+        const auto us = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+        wait_us_total_.fetch_add(us, std::memory_order_relaxed);
+        std::uint64_t max = wait_us_max_.load(std::memory_order_relaxed);
+        while (us > max && !wait_us_max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+        }
+        if (options_.queue_wait) {
+            options_.queue_wait->record(expired ? 1 : 0, waited);
+        }
+    }
+
+    const Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    std::size_t running_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<std::uint64_t> submitted_{0};
+    std::atomic<std::uint64_t> completed_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+    std::atomic<std::uint64_t> expired_{0};
+    std::atomic<std::uint64_t> timed_out_{0};
+    std::atomic<std::uint64_t> wait_us_total_{0};
+    std::atomic<std::uint64_t> wait_us_max_{0};
+
+    std::vector<std::thread> threads_; // последним: потоки стартуют, когда остальные поля готовы
+};
@@ -0,0 +1,253 @@
+// src/db_pool.h
+
+#pragma once
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "request_trace.h"
+
+// Не удалось получить соединение из пула за отведённое время.
+class DbPoolTimeout : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Ограниченный потокобезопасный пул соединений к PostgreSQL.
+//
+// Соединения создаются лениво (не больше size) и живут всё время работы процесса,
+// поэтому подготовленные запросы регистрируются ровно один раз — в preparer при
+// создании соединения. Сломанные соединения при возврате в пул уничтожаются,
+// а долго простаивавшие перед выдачей проверяются запросом SELECT 1.
+class DbPool {
+public:
+    using Preparer = std::function<void(pqxx::connection &)>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string conn_str;
+        std::size_t size = 4;
+        // Сколько ждать свободное соединение, прежде чем вернуть ошибку
+        std::chrono::milliseconds checkout_timeout{1000};
+        // После такого простоя соединение проверяется перед выдачей
+        std::chrono::milliseconds idle_check_after{30000};
+    };
+
+    struct Stats {
+        std::size_t size = 0;        // максимальный размер пула
+        std::size_t open = 0;        // создано соединений (включая создаваемые сейчас)
+        std::size_t in_use = 0;      // выдано обработчикам
+        std::size_t idle = 0;        // свободно
+        std::size_t waiting = 0;     // потоков ждут соединение
+        std::uint64_t acquired = 0;  // всего успешных выдач
+        std::uint64_t timeouts = 0;  // выдач, завершившихся по таймауту
+        std::uint64_t created = 0;   // всего создано соединений
+        std::uint64_t replaced = 0;  // уничтожено сломанных соединений
+        std::uint64_t wait_us_total = 0;
+        std::uint64_t wait_us_max = 0;
+    };
+
+    // RAII-аренда соединения: при разрушении соединение возвращается в пул.
+    class Lease {
+    public:
+        Lease(Lease &&other) noexcept
+            : pool_(std::exchange(other.pool_, nullptr)),
+              conn_(std::move(other.conn_)) {}
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        ~Lease() {
+            if (pool_) {
+                pool_->release(std::move(conn_));
+            }
+        }
+
+        pqxx::connection &operator*() const { return *conn_; }
+        pqxx::connection *operator->() const { return conn_.get(); }
+
+    private:
+        friend class DbPool;
+        Lease(DbPool *pool, std::unique_ptr<pqxx::connection> conn)
+            : pool_(pool), conn_(std::move(conn)) {}
+
+        DbPool *pool_;
+        std::unique_ptr<pqxx::connection> conn_;
+    };
+
+    DbPool(Options options, Preparer preparer)
+        : options_(std::move(options)), preparer_(std::move(preparer)) {
+        options_.size = std::max<std::size_t>(options_.size, 1);
+    }
+
+    DbPool(const DbPool &) = delete;
+    DbPool &operator=(const DbPool &) = delete;
+
+    // Выдаёт соединение; бросает DbPoolTimeout, если за checkout_timeout свободного
+    // соединения не нашлось, и pqxx-исключение, если не удалось открыть новое.
+    Lease acquire() {
+        StageSpan span(Stage::DbConnect); // ожидание свободного соединения или открытие нового
+        const auto start = Clock::now();
+        const auto deadline = start + options_.checkout_timeout;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++waiting_;
+        bool ready = cv_.wait_until(lock, deadline, [this] {
+            return !idle_.empty() || open_ < options_.size;
+        });
+        --waiting_;
+        if (!ready) {
+            ++timeouts_;
+            throw DbPoolTimeout("DB pool checkout timeout");
+        }
+
+        std::unique_ptr<pqxx::connection> conn;
+        Clock::time_point idle_since{};
+        if (!idle_.empty()) {
+            conn = std::move(idle_.back().conn);
+            idle_since = idle_.back().since;
+            idle_.pop_back();
+        }
+        else {
+            ++open_;
+        }
+        ++in_use_;
+        lock.unlock();
+
+        try {
+            if (conn && !healthy(*conn, idle_since)) {
+                conn.reset();
+                note_replaced();
+            }
+            if (!conn) {
+                conn = open_connection();
+            }
+        }
+        catch (...) {
+            lock.lock();
+            --open_;
+            --in_use_;
+            lock.unlock();
+            cv_.notify_one();
+            throw;
+        }
+
+        record_wait(Clock::now() - start);
+        return Lease(this, std::move(conn));
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats s;
+        s.size = options_.size;
+        s.open = open_;
+        s.in_use = in_use_;
+        s.idle = idle_.size();
+        s.waiting = waiting_;
+        s.acquired = acquired_;
+        s.timeouts = timeouts_;
+        s.created = created_;
+        s.replaced = replaced_;
+        s.wait_us_total = wait_us_total_;
+        s.wait_us_max = wait_us_max_;
+        return s;
+    }
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<pqxx::connection> conn;
+        Clock::time_point since;
+    };
+
+    std::unique_ptr<pqxx::connection> open_connection() {
+        auto conn = std::make_unique<pqxx::connection>(options_.conn_str);
+        if (preparer_) {
+            preparer_(*conn);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++created_;
+        return conn;
+    }
+
+    bool healthy(pqxx::connection &conn, Clock::time_point idle_since) const {
+        if (!conn.is_open()) {
+            return false;
+        }
+        if (Clock::now() - idle_since < options_.idle_check_after) {
+            return true;
+        }
+        try {
+            pqxx::nontransaction tx(conn);
+            tx.exec("SELECT 1");
+            return true;
+        }
+        catch (const std::exception &) {
+            return false;
+        }
+    }
+
+    // Соединение, потерявшее связь с сервером (после pqxx::broken_connection
+    // is_open() возвращает false), не возвращается в пул, а освобождает слот.
+    void release(std::unique_ptr<pqxx::connection> conn) {
+        if (!conn) {
+            return;
+        }
+        if (!conn->is_open()) {
+            conn.reset();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --open_;
+                --in_use_;
+                ++replaced_;
+            }
+            cv_.notify_one();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --in_use_;
+            idle_.push_back({std::move(conn), Clock::now()});
+        }
+        cv_.notify_one();
+    }
+
+    void note_replaced() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++replaced_;
+    }
+
+    void record_wait(Clock::duration waited) {
+        auto us = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++acquired_;
+        wait_us_total_ += us;
+        wait_us_max_ = std::max(wait_us_max_, us);
+    }
+
+    Options options_;
+    Preparer preparer_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<IdleConnection> idle_;
+    std::size_t open_ = 0;
+    std::size_t in_use_ = 0;
+    std::size_t waiting_ = 0;
+    std::uint64_t acquired_ = 0;
+    std::uint64_t timeouts_ = 0;
+    std::uint64_t created_ = 0;
+    std::uint64_t replaced_ = 0;
+    std::uint64_t wait_us_total_ = 0;
+    std::uint64_t wait_us_max_ = 0;
+};
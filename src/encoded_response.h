@@ -0,0 +1,293 @@
+// src/encoded_response.h
+
+#pragma once
+
+#include <zlib.h>
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "request_trace.h"
+
+// Закешированный ответ, закодированный один раз при заполнении кеша.
+//
+// Вместе с JSON хранятся сильный ETag и заранее сжатые варианты (gzip и, если сервис
+// собран с ними, br/zstd), поэтому при попадании в кеш ничего не сжимается повторно.
+// В Redis и L1 запись лежит одной строкой:
+//
+//   "ENC1 <etag> <len identity> <len gzip> <len br> <len zstd> <fresh until>\n" + тела подряд
+//
+// fresh until — момент (мс Unix-времени), после которого запись считается устаревшей
+// и обновляется в фоне, хотя ещё отдаётся (мягкий TTL); 0 — без мягкого TTL. Записи
+// без этого поля (от прежних версий сервиса) читаются как записи с 0.
+//
+// decode_entry() не копирует данные, а только нарезает строку на string_view.
+// Значение без префикса ENC1 (например, записанное старыми версиями сервиса)
+// считается несжатым JSON, ETag для него вычисляется на лету.
+
+struct EncodedView {
+    std::string_view identity;
+    std::string_view gzip; // пусто, если сжатие не дало выигрыша
+    std::string_view br;
+    std::string_view zstd;
+    std::string etag;
+    std::int64_t fresh_until_ms = 0; // 0 — запись не устаревает до жёсткого TTL
+};
+
+// Текущее Unix-время в мс: мягкий TTL общий для всех экземпляров, поэтому часы системные
+inline std::int64_t unix_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Запись «статьи нет» (negative caching): пока она жива, 404 отдаётся без БД — и тем
+// экземплярам, что ждали блокировку промаха. Не начинается с ENC1, поэтому проверяется
+// до decode_entry().
+inline constexpr std::string_view kNotFoundEntry = "NOTFOUND";
+
+inline bool is_not_found_entry(std::string_view entry) {
+    return entry == kNotFoundEntry;
+}
+
+inline bool is_stale(const EncodedView &view, std::int64_t now_ms = unix_time_ms()) {
+    return view.fresh_until_ms != 0 && view.fresh_until_ms <= now_ms;
+}
+
+struct EncodeOptions {
+    int gzip_level = 6;
+    int brotli_quality = 9;
+    int zstd_level = 9;
+    std::size_t min_size = 256; // меньшие ответы не сжимаются
+};
+
+// Сильный ETag: FNV-1a 64 от тела и его длина
+inline std::string make_etag(std::string_view body) {
+    std::uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "\"%016llx-%zx\"", static_cast<unsigned long long>(hash), body.size());
+    return buf;
+}
+
+// Сжатые варианты — разные представления, и сильный ETag у каждого свой (RFC 9110,
+// 8.8.3): к ETag тела добавляется кодирование, "<etag>-gzip" и т. п.
+inline std::string variant_etag(std::string_view etag, std::string_view content_encoding) {
+    if (content_encoding.empty() || etag.size() < 2 || etag.back() != '"') {
+        return std::string(etag);
+    }
+    std::string result(etag.substr(0, etag.size() - 1));
+    result += '-';
+    result += content_encoding;
+    result += '"';
+    return result;
+}
+
+inline std::string gzip_compress(std::string_view input, int level) {
+    z_stream zs{};
+    // 15 + 16: окно 32 КБ и заголовок gzip вместо zlib
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return {};
+    }
+    std::string out(deflateBound(&zs, static_cast<uLong>(input.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    zs.avail_in = static_cast<uInt>(input.size());
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : std::string();
+}
+
+inline std::string brotli_compress(std::string_view input, int quality) {
+#ifdef HAVE_BROTLI
+    std::size_t size = BrotliEncoderMaxCompressedSize(input.size());
+    std::string out(size, '\0');
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, input.size(),
+                               reinterpret_cast<const std::uint8_t *>(input.data()), &size,
+                               reinterpret_cast<std::uint8_t *>(&out[0]))) {
+        return {};
+    }
+    out.resize(size);
+    return out;
+#else
+    (void)input;
+    (void)quality;
+    return {};
+#endif
+}
+
+inline std::string zstd_compress(std::string_view input, int level) {
+#ifdef HAVE_ZSTD
+    std::string out(ZSTD_compressBound(input.size()), '\0');
+    std::size_t size = ZSTD_compress(&out[0], out.size(), input.data(), input.size(), level);
+    if (ZSTD_isError(size)) {
+        return {};
+    }
+    out.resize(size);
+    return out;
+#else
+    (void)input;
+    (void)level;
+    return {};
+#endif
+}
+
+// Кодирует JSON в запись кеша со всеми вариантами
+inline std::string encode_entry(std::string_view body, const EncodeOptions &options = {},
+                                std::int64_t fresh_until_ms = 0) {
+    StageSpan span(Stage::Encode);
+    std::string gzip, br, zstd;
+    if (body.size() >= options.min_size) {
+        gzip = gzip_compress(body, options.gzip_level);
+        br = brotli_compress(body, options.brotli_quality);
+        zstd = zstd_compress(body, options.zstd_level);
+        // Вариант, который не меньше исходного, не хранится
+        for (std::string *variant : {&gzip, &br, &zstd}) {
+            if (variant->size() >= body.size()) {
+                variant->clear();
+            }
+        }
+    }
+
+    std::string entry = "ENC1 " + make_etag(body) + " " + std::to_string(body.size()) + " " +
+                        std::to_string(gzip.size()) + " " + std::to_string(br.size()) + " " +
+                        std::to_string(zstd.size()) + " " + std::to_string(fresh_until_ms) + "\n";
+    entry.reserve(entry.size() + body.size() + gzip.size() + br.size() + zstd.size());
+    entry.append(body);
+    entry += gzip;
+    entry += br;
+    entry += zstd;
+    return entry;
+}
+
+// Нарезает запись кеша на варианты; entry должна жить дольше результата
+inline EncodedView decode_entry(std::string_view entry) {
+    EncodedView view;
+    const std::size_t header_end = entry.find('\n');
+    if (entry.substr(0, 5) != "ENC1 " || header_end == std::string_view::npos) {
+        view.identity = entry;
+        view.etag = make_etag(entry);
+        return view;
+    }
+
+    const std::string header(entry.substr(5, header_end - 5));
+    const std::size_t etag_end = header.find(' ');
+    unsigned long long lengths[4] = {0, 0, 0, 0};
+    long long fresh_until = 0;
+    if (etag_end == std::string::npos ||
+        std::sscanf(header.c_str() + etag_end, "%llu %llu %llu %llu %lld",
+                    &lengths[0], &lengths[1], &lengths[2], &lengths[3], &fresh_until) < 4 ||
+        header_end + 1 + lengths[0] + lengths[1] + lengths[2] + lengths[3] != entry.size()) {
+        // Повреждённая запись: отдаём как есть, лишь бы не упасть
+        view.identity = entry;
+        view.etag = make_etag(entry);
+        return view;
+    }
+
+    view.etag = header.substr(0, etag_end);
+    view.fresh_until_ms = fresh_until;
+    std::size_t offset = header_end + 1;
+    std::string_view *parts[4] = {&view.identity, &view.gzip, &view.br, &view.zstd};
+    for (int i = 0; i < 4; ++i) {
+        *parts[i] = entry.substr(offset, lengths[i]);
+        offset += lengths[i];
+    }
+    return view;
+}
+
+// Проверка If-None-Match: список ETag через запятую или "*"; слабые W/ сравниваются по значению.
+// etag — ETag тела без кодирования; ETag любого его сжатого варианта (variant_etag) тоже
+// подходит: сравнение для If-None-Match слабое, содержимое вариантов одно и то же.
+inline bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    std::size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        std::size_t comma = if_none_match.find(',', pos);
+        std::string_view token = if_none_match.substr(pos, comma == std::string_view::npos ? std::string_view::npos : comma - pos);
+        while (!token.empty() && std::isspace(static_cast<unsigned char>(token.front()))) {
+            token.remove_prefix(1);
+        }
+        while (!token.empty() && std::isspace(static_cast<unsigned char>(token.back()))) {
+            token.remove_suffix(1);
+        }
+        if (token.substr(0, 2) == "W/") {
+            token.remove_prefix(2);
+        }
+        if (token == "*" || token == etag) {
+            return true;
+        }
+        for (std::string_view coding : {"gzip", "br", "zstd"}) {
+            if (token == variant_etag(etag, coding)) {
+                return true;
+            }
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// Принимает ли клиент кодирование name (по Accept-Encoding, с учётом q=0)
+inline bool accepts_encoding(std::string_view accept_encoding, std::string_view name) {
+    std::size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        std::size_t comma = accept_encoding.find(',', pos);
+        std::string_view item = accept_encoding.substr(pos, comma == std::string_view::npos ? std::string_view::npos : comma - pos);
+        std::size_t semi = item.find(';');
+        std::string_view token = item.substr(0, semi);
+        while (!token.empty() && std::isspace(static_cast<unsigned char>(token.front()))) {
+            token.remove_prefix(1);
+        }
+        while (!token.empty() && std::isspace(static_cast<unsigned char>(token.back()))) {
+            token.remove_suffix(1);
+        }
+        if (token == name) {
+            if (semi == std::string_view::npos) {
+                return true;
+            }
+            std::string_view params = item.substr(semi + 1);
+            std::size_t q = params.find("q=");
+            return q == std::string_view::npos || std::atof(std::string(params.substr(q + 2)).c_str()) > 0.0;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// Выбор варианта тела: zstd, br, gzip (из тех, что есть и принимаются клиентом), иначе JSON
+inline std::string_view choose_encoding(const EncodedView &view, std::string_view accept_encoding,
+                                        std::string_view &content_encoding) {
+    content_encoding = {};
+    if (!view.zstd.empty() && accepts_encoding(accept_encoding, "zstd")) {
+        content_encoding = "zstd";
+        return view.zstd;
+    }
+    if (!view.br.empty() && accepts_encoding(accept_encoding, "br")) {
+        content_encoding = "br";
+        return view.br;
+    }
+    if (!view.gzip.empty() && accepts_encoding(accept_encoding, "gzip")) {
+        content_encoding = "gzip";
+        return view.gzip;
+    }
+    return view.identity;
+}
@@ -0,0 +1,243 @@
+// src/hot_keys.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Приближённая частота обращений к ключам: count-min sketch в духе TinyLFU.
+//
+// kDepth строк по width 16-битных счётчиков (width — степень двойки). Обращение
+// увеличивает только минимальные из счётчиков ключа (conservative update), оценка —
+// минимум по строкам, поэтому частота завышается лишь коллизиями. После sample_size
+// обращений все счётчики делятся пополам: старая популярность затухает, и оценка
+// отражает последние ~sample_size запросов. Делит не обращение, а фоновый вызов
+// age_if_due(): проход по width × kDepth счётчикам не должен задерживать запрос.
+// Потокобезопасен без блокировок; деление пополам параллельно с обращениями допускает
+// небольшую погрешность.
+class FrequencySketch {
+public:
+    static constexpr int kDepth = 4;
+    static constexpr std::uint16_t kMaxCount = 65535;
+
+    explicit FrequencySketch(std::size_t width, std::size_t sample_size = 0)
+        : width_(round_up_pow2(std::max<std::size_t>(width, 64))),
+          sample_size_(sample_size ? sample_size : width_ * 10),
+          counters_(new std::atomic<std::uint16_t>[width_ * kDepth]) {
+        for (std::size_t i = 0; i < width_ * kDepth; ++i) {
+            counters_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Учитывает обращение и возвращает новую оценку частоты
+    std::uint32_t increment(std::string_view key) {
+        std::size_t index[kDepth];
+        indexes(key, index);
+        std::uint16_t min = kMaxCount;
+        for (int row = 0; row < kDepth; ++row) {
+            min = std::min(min, counters_[index[row]].load(std::memory_order_relaxed));
+        }
+        if (min < kMaxCount) {
+            for (int row = 0; row < kDepth; ++row) {
+                std::uint16_t expected = min;
+                counters_[index[row]].compare_exchange_strong(expected, static_cast<std::uint16_t>(min + 1),
+                                                              std::memory_order_relaxed);
+            }
+        }
+        additions_.fetch_add(1, std::memory_order_relaxed);
+        return min < kMaxCount ? min + 1u : kMaxCount;
+    }
+
+    std::uint32_t estimate(std::string_view key) const {
+        std::size_t index[kDepth];
+        indexes(key, index);
+        std::uint16_t min = kMaxCount;
+        for (int row = 0; row < kDepth; ++row) {
+            min = std::min(min, counters_[index[row]].load(std::memory_order_relaxed));
+        }
+        return min;
+    }
+
+    // Делит счётчики пополам, если с прошлого деления набралось sample_size обращений
+    bool age_if_due() {
+        if (additions_.load(std::memory_order_relaxed) < sample_size_) {
+            return false;
+        }
+        age();
+        return true;
+    }
+
+    std::size_t width() const { return width_; }
+    std::size_t sample_size() const { return sample_size_; }
+    std::uint64_t resets() const { return resets_.load(std::memory_order_relaxed); }
+
+    // Вызывается после каждого деления счётчиков (см. HotKeyTracker)
+    void on_age(std::function<void()> fn) { on_age_ = std::move(fn); }
+
+private:
+    static std::size_t round_up_pow2(std::size_t n) {
+        std::size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    // Индексы строк из одного 64-битного хеша после перемешивания (finalizer murmur3)
+    void indexes(std::string_view key, std::size_t (&index)[kDepth]) const {
+        std::uint64_t h = std::hash<std::string_view>{}(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        for (int row = 0; row < kDepth; ++row) {
+            // Двойное хеширование: h1 + row * h2 — своя позиция в каждой строке
+            const std::uint64_t mixed = (h & 0xffffffffULL) + static_cast<std::uint64_t>(row) * ((h >> 32) | 1);
+            index[row] = static_cast<std::size_t>(row) * width_ + (mixed & (width_ - 1));
+        }
+    }
+
+    void age() {
+        for (std::size_t i = 0; i < width_ * kDepth; ++i) {
+            counters_[i].store(counters_[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+        }
+        additions_.store(0, std::memory_order_relaxed);
+        resets_.fetch_add(1, std::memory_order_relaxed);
+        if (on_age_) {
+            on_age_();
+        }
+    }
+
+    const std::size_t width_;
+    const std::size_t sample_size_;
+    std::unique_ptr<std::atomic<std::uint16_t>[]> counters_;
+    std::atomic<std::size_t> additions_{0};
+    std::atomic<std::uint64_t> resets_{0};
+    std::function<void()> on_age_;
+};
+
+// Частоты ключей на пути чтения и производные решения кеша.
+//
+// record(key) учитывает обращение; temperature(key) делит ключи на холодные (реже
+// admit_min_hits обращений за окно — в кеш не пишутся), обычные и горячие (от
+// hot_min_hits — живут дольше). top(k) — самые частые ключи: кандидаты отбираются,
+// когда оценка ключа достигает очередной степени двойки и превышает минимум текущего
+// списка, так что блокировка берётся редко даже для самых горячих ключей.
+class HotKeyTracker {
+public:
+    enum class Temperature { Cold, Warm, Hot };
+
+    struct Options {
+        std::size_t sketch_width = 65536;
+        std::size_t sample_size = 0; // 0 — 10 × sketch_width
+        std::uint32_t admit_min_hits = 1;
+        std::uint32_t hot_min_hits = 8;
+        std::size_t top_k = 32;
+    };
+
+    struct HotKey {
+        std::string key;
+        std::uint32_t hits = 0; // оценка частоты за текущее окно
+    };
+
+    explicit HotKeyTracker(Options options)
+        : options_(options), sketch_(options.sketch_width, options.sample_size) {
+        sketch_.on_age([this] { age_top(); });
+    }
+
+    HotKeyTracker(const HotKeyTracker &) = delete;
+    HotKeyTracker &operator=(const HotKeyTracker &) = delete;
+
+    std::uint32_t record(std::string_view key) {
+        const std::uint32_t hits = sketch_.increment(key);
+        if ((hits & (hits - 1)) == 0 && hits > top_min_.load(std::memory_order_relaxed)) {
+            offer(key, hits);
+        }
+        return hits;
+    }
+
+    std::uint32_t estimate(std::string_view key) const { return sketch_.estimate(key); }
+
+    // Фоновое деление частот (см. FrequencySketch::age_if_due), не на пути запроса
+    bool age_if_due() { return sketch_.age_if_due(); }
+
+    Temperature temperature(std::string_view key) const {
+        const std::uint32_t hits = sketch_.estimate(key);
+        if (hits >= options_.hot_min_hits) {
+            return Temperature::Hot;
+        }
+        return hits >= options_.admit_min_hits ? Temperature::Warm : Temperature::Cold;
+    }
+
+    // До k самых частых ключей по убыванию текущей оценки
+    std::vector<HotKey> top(std::size_t k) const {
+        std::vector<HotKey> result;
+        {
+            std::lock_guard<std::mutex> lock(top_mutex_);
+            result.reserve(top_.size());
+            for (const auto &[key, hits] : top_) {
+                result.push_back({key, sketch_.estimate(key)});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const HotKey &a, const HotKey &b) { return a.hits > b.hits; });
+        if (result.size() > k) {
+            result.resize(k);
+        }
+        return result;
+    }
+
+    const Options &options() const { return options_; }
+    const FrequencySketch &sketch() const { return sketch_; }
+
+private:
+    void offer(std::string_view key, std::uint32_t hits) {
+        std::lock_guard<std::mutex> lock(top_mutex_);
+        auto it = top_.find(std::string(key));
+        if (it != top_.end()) {
+            it->second = hits;
+        }
+        else {
+            top_.emplace(std::string(key), hits);
+            if (top_.size() > options_.top_k) {
+                auto victim = std::min_element(top_.begin(), top_.end(),
+                                               [](const auto &a, const auto &b) { return a.second < b.second; });
+                top_.erase(victim);
+            }
+        }
+        update_min();
+    }
+
+    void age_top() {
+        std::lock_guard<std::mutex> lock(top_mutex_);
+        for (auto &entry : top_) {
+            entry.second >>= 1;
+        }
+        update_min();
+    }
+
+    void update_min() {
+        std::uint32_t min = 0;
+        if (top_.size() >= options_.top_k) {
+            min = std::min_element(top_.begin(), top_.end(),
+                                   [](const auto &a, const auto &b) { return a.second < b.second; })->second;
+        }
+        top_min_.store(min, std::memory_order_relaxed);
+    }
+
+    const Options options_;
+    FrequencySketch sketch_;
+
+    mutable std::mutex top_mutex_;
+    std::unordered_map<std::string, std::uint32_t> top_;
+    std::atomic<std::uint32_t> top_min_{0}; // ниже этой оценки ключ в top_ не попадёт
+};
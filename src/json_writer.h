@@ -0,0 +1,233 @@
+// src/json_writer.h
+
+#pragma once
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Потоковая запись JSON прямо в строку, без промежуточного дерева crow::json::wvalue.
+//
+// Строки экранируются так же, как crow::json::escape: ", \, \n, \b, \f, \r, \t —
+// короткими последовательностями, прочие управляющие символы — \u00xx (строчные hex),
+// остальные байты (в том числе UTF-8) — как есть. Участки без спецсимволов копируются
+// целиком; поиск спецсимвола идёт по 16 байт за раз, если доступен SSE2.
+
+inline bool json_needs_escape(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+// Позиция первого символа, требующего экранирования, или size, если таких нет
+inline std::size_t json_find_escape(const char *data, std::size_t size) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // max(c, 0x1f) == 0x1f  <=>  c <= 0x1f (беззнаковое сравнение)
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (json_needs_escape(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return size;
+}
+
+inline void json_escape_append(std::string &out, std::string_view value) {
+    while (!value.empty()) {
+        const std::size_t clean = json_find_escape(value.data(), value.size());
+        out.append(value.data(), clean);
+        if (clean == value.size()) {
+            return;
+        }
+        const unsigned char c = static_cast<unsigned char>(value[clean]);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+                break;
+            }
+        }
+        value.remove_prefix(clean + 1);
+    }
+}
+
+// Запись JSON-значений с расстановкой запятых. Структура не проверяется: вызывающий
+// сам следит за парностью begin_/end_ и за тем, что в объекте перед значением идёт key().
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string &out) : out_(out) {}
+
+    JsonWriter &begin_object() {
+        open('{');
+        return *this;
+    }
+
+    JsonWriter &end_object() {
+        close('}');
+        return *this;
+    }
+
+    JsonWriter &begin_array() {
+        open('[');
+        return *this;
+    }
+
+    JsonWriter &end_array() {
+        close(']');
+        return *this;
+    }
+
+    JsonWriter &key(std::string_view name) {
+        separate();
+        append_string(name);
+        out_ += ':';
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter &value(long long number) {
+        separate();
+        char buf[24];
+        const auto result = std::to_chars(buf, buf + sizeof(buf), number);
+        out_.append(buf, result.ptr);
+        return *this;
+    }
+
+    JsonWriter &value(int number) { return value(static_cast<long long>(number)); }
+
+    JsonWriter &value(std::string_view text) {
+        separate();
+        append_string(text);
+        return *this;
+    }
+
+    JsonWriter &value(const char *text) { return value(std::string_view(text)); }
+
+    JsonWriter &null() {
+        separate();
+        out_ += "null";
+        return *this;
+    }
+
+    // Уже готовый JSON-текст (например, значение, собранное в другом месте)
+    JsonWriter &raw(std::string_view json) {
+        separate();
+        out_.append(json);
+        return *this;
+    }
+
+private:
+    static constexpr int kMaxDepth = 32;
+
+    void append_string(std::string_view text) {
+        out_ += '"';
+        json_escape_append(out_, text);
+        out_ += '"';
+    }
+
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ > 0 && depth_ <= kMaxDepth) {
+            if (!first_[depth_ - 1]) {
+                out_ += ',';
+            }
+            first_[depth_ - 1] = false;
+        }
+    }
+
+    void open(char bracket) {
+        separate();
+        out_ += bracket;
+        if (depth_ < kMaxDepth) {
+            first_[depth_] = true;
+        }
+        ++depth_;
+    }
+
+    void close(char bracket) {
+        out_ += bracket;
+        --depth_;
+    }
+
+    std::string &out_;
+    bool first_[kMaxDepth] = {};
+    int depth_ = 0;
+    bool after_key_ = false;
+};
+
+// Буфер для сборки ответа, переиспользуемый потоком между запросами: ёмкость остаётся
+// от предыдущих ответов, так что сборка обычно обходится без выделения памяти. Буфер
+// больше max_retained после использования освобождается, чтобы редкий огромный ответ
+// не держал память потока. Вложенный ScratchBuffer в том же потоке получает свою строку.
+class ScratchBuffer {
+public:
+    explicit ScratchBuffer(std::size_t max_retained = 8 * 1024 * 1024)
+        : state_(thread_state()), owned_(!state_.in_use), max_retained_(max_retained) {
+        if (owned_) {
+            state_.in_use = true;
+            state_.buffer.clear();
+        }
+    }
+
+    ~ScratchBuffer() {
+        if (owned_) {
+            if (state_.buffer.capacity() > max_retained_) {
+                std::string().swap(state_.buffer);
+            }
+            else {
+                state_.buffer.clear();
+            }
+            state_.in_use = false;
+        }
+    }
+
+    ScratchBuffer(const ScratchBuffer &) = delete;
+    ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+    std::string &str() { return owned_ ? state_.buffer : own_; }
+
+private:
+    struct State {
+        std::string buffer;
+        bool in_use = false;
+    };
+
+    static State &thread_state() {
+        thread_local State state;
+        return state;
+    }
+
+    State &state_;
+    const bool owned_;
+    const std::size_t max_retained_;
+    std::string own_;
+};
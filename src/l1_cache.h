@@ -0,0 +1,201 @@
+// src/l1_cache.h
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Внутрипроцессный кеш первого уровня перед Redis.
+//
+// Ключи те же, что и в Redis (`article:{id}`, `articles_all`). Пространство ключей
+// разбито на шарды со своим мьютексом и своей частью бюджета памяти, чтобы рабочие
+// потоки Crow не сталкивались на одной блокировке. Внутри шарда — LRU-вытеснение;
+// значения крупнее max_entry_bytes не допускаются в кеш, чтобы один большой ответ
+// не вымывал весь шард. Значения хранятся в shared_ptr и отдаются без копирования.
+class L1Cache {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Value = std::shared_ptr<const std::string>;
+
+    struct Options {
+        std::size_t max_bytes = 64 * 1024 * 1024; // общий бюджет памяти
+        std::size_t shards = 16;                  // округляется вверх до степени двойки
+        std::size_t max_entry_bytes = 0;          // 0 — половина бюджета шарда
+    };
+
+    struct Stats {
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+        std::size_t max_bytes = 0;
+        std::uint64_t evictions = 0; // вытеснено по бюджету
+        std::uint64_t expired = 0;   // удалено по истечении TTL
+        std::uint64_t rejected = 0;  // не допущено из-за размера
+    };
+
+    // Живая запись для выгрузки (см. entries())
+    struct Exported {
+        std::string key;
+        Value value;
+        std::chrono::milliseconds ttl; // сколько ещё осталось жить
+    };
+
+    explicit L1Cache(Options options) {
+        std::size_t shards = 1;
+        while (shards < std::max<std::size_t>(options.shards, 1)) {
+            shards <<= 1;
+        }
+        shard_mask_ = shards - 1;
+        shard_budget_ = std::max<std::size_t>(options.max_bytes / shards, 1);
+        max_entry_bytes_ = options.max_entry_bytes ? options.max_entry_bytes : shard_budget_ / 2;
+        shards_.reserve(shards);
+        for (std::size_t i = 0; i < shards; ++i) {
+            shards_.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    L1Cache(const L1Cache &) = delete;
+    L1Cache &operator=(const L1Cache &) = delete;
+
+    // nullptr, если ключа нет или его TTL истёк
+    Value get(const std::string &key) {
+        Shard &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return nullptr;
+        }
+        auto entry = it->second;
+        if (entry->expires <= Clock::now()) {
+            ++shard.expired;
+            remove(shard, entry);
+            return nullptr;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+        return entry->value;
+    }
+
+    // Возвращает false, если значение не допущено в кеш
+    bool put(const std::string &key, Value value, std::chrono::milliseconds ttl) {
+        if (!value || ttl.count() <= 0) {
+            return false;
+        }
+        const std::size_t charge = charge_of(key, *value);
+        Shard &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            remove(shard, it->second);
+        }
+        if (charge > max_entry_bytes_) {
+            ++shard.rejected;
+            return false;
+        }
+
+        while (!shard.lru.empty() && shard.bytes + charge > shard_budget_) {
+            ++shard.evictions;
+            remove(shard, std::prev(shard.lru.end()));
+        }
+        shard.lru.push_front(Entry{key, std::move(value), Clock::now() + ttl, charge});
+        shard.index.emplace(key, shard.lru.begin());
+        shard.bytes += charge;
+        return true;
+    }
+
+    void erase(const std::string &key) {
+        Shard &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            remove(shard, it->second);
+        }
+    }
+
+    void clear() {
+        for (auto &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->lru.clear();
+            shard->index.clear();
+            shard->bytes = 0;
+        }
+    }
+
+    // Живые записи, для которых filter(key) == true, — например, для снимка на диск.
+    // Значения не копируются; filter вызывается под блокировкой шарда.
+    template <typename Filter>
+    std::vector<Exported> entries(Filter &&filter) const {
+        std::vector<Exported> result;
+        const auto now = Clock::now();
+        for (const auto &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            for (const Entry &entry : shard->lru) {
+                if (entry.expires > now && filter(entry.key)) {
+                    result.push_back({entry.key, entry.value,
+                                      std::chrono::duration_cast<std::chrono::milliseconds>(entry.expires - now)});
+                }
+            }
+        }
+        return result;
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.max_bytes = shard_budget_ * shards_.size();
+        for (const auto &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            s.entries += shard->index.size();
+            s.bytes += shard->bytes;
+            s.evictions += shard->evictions;
+            s.expired += shard->expired;
+            s.rejected += shard->rejected;
+        }
+        return s;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        Value value;
+        Clock::time_point expires;
+        std::size_t charge;
+    };
+    using EntryList = std::list<Entry>;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        EntryList lru; // в начале — самые свежие
+        std::unordered_map<std::string, EntryList::iterator> index;
+        std::size_t bytes = 0;
+        std::uint64_t evictions = 0;
+        std::uint64_t expired = 0;
+        std::uint64_t rejected = 0;
+    };
+
+    // Ключ хранится дважды (в списке и в индексе) плюс служебные структуры
+    static std::size_t charge_of(const std::string &key, const std::string &value) {
+        return 2 * key.size() + value.size() + 96;
+    }
+
+    Shard &shard_for(const std::string &key) {
+        return *shards_[std::hash<std::string>{}(key) & shard_mask_];
+    }
+
+    static void remove(Shard &shard, EntryList::iterator entry) {
+        shard.bytes -= entry->charge;
+        shard.index.erase(entry->key);
+        shard.lru.erase(entry);
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::size_t shard_mask_ = 0;
+    std::size_t shard_budget_ = 0;
+    std::size_t max_entry_bytes_ = 0;
+};
@@ -1,147 +1,1871 @@
 #include <crow.h>
 #include <pqxx/pqxx>
 #include <sw/redis++/redis++.h>
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <memory>
 #include <chrono>
-#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <optional>
+#include <map>
+#include <unordered_map>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+
+#include "article_index.h"
+#include "article_queries.h"
+#include "background_refresher.h"
+#include "cache_snapshot.h"
+#include "config.h"
+#include "db_change_listener.h"
+#include "db_executor.h"
+#include "db_pool.h"
+#include "encoded_response.h"
+#include "hot_keys.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "periodic_task.h"
+#include "redis_breaker.h"
+#include "redis_lock.h"
+#include "request_trace.h"
+#include "search_index.h"
+#include "single_flight.h"
+#include "tiered_cache.h"
+#include "write_batcher.h"
 
 using namespace sw::redis;
 
+// Результат пересборки ключа при промахе; одинаков для всех объединённых запросов.
+// При code == 200 body — запись кеша (encode_entry), иначе текст ошибки.
+struct LoadResult {
+    int code = 200;
+    std::string body;
+};
+
+// Ряды метрик задержки: маршрут × откуда взят ответ
+enum class Route {
+    Articles, ArticlesPage, ArticlesBatch, ArticlesSearch, Article, ArticleRandom, CreateArticle, CreateComment, Count
+};
+// None — отказ до обращения к кешу (400, 404); Snapshot — снимок кеша прошлого запуска
+enum class ServedFrom { L1, Redis, Snapshot, Db, None, Count };
+
+static const char *const kRouteNames[] = {"articles", "articles_page", "articles_batch", "articles_search", "article",
+                                            "article_random", "post_article", "post_comment"};
+static const char *const kServedFromNames[] = {"l1", "redis", "snapshot", "db", "none"};
+
+static std::size_t latency_series(Route route, ServedFrom from) {
+    return static_cast<std::size_t>(route) * static_cast<std::size_t>(ServedFrom::Count) +
+           static_cast<std::size_t>(from);
+}
+
+static std::vector<std::string> latency_series_labels() {
+    std::vector<std::string> labels;
+    for (const char *route : kRouteNames) {
+        for (const char *from : kServedFromNames) {
+            labels.push_back(std::string("route=\"") + route + "\",path=\"" + from + "\"");
+        }
+    }
+    return labels;
+}
+
+static ServedFrom served_from(CacheSource source) {
+    switch (source) {
+        case CacheSource::L1:
+            return ServedFrom::L1;
+        case CacheSource::Snapshot:
+            return ServedFrom::Snapshot;
+        default:
+            return ServedFrom::Redis;
+    }
+}
+
+// Время от старта процесса до первого ответа из кеша — насколько быстро рестарт
+// становится тёплым. Фиксируется один раз и пишется в лог.
+class FirstWarmHit {
+public:
+    explicit FirstWarmHit(std::chrono::steady_clock::time_point start) : start_(start) {}
+
+    void hit(ServedFrom from) {
+        if (elapsed_us_.load(std::memory_order_relaxed) >= 0) {
+            return;
+        }
+        const std::int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        std::int64_t expected = -1;
+        if (elapsed_us_.compare_exchange_strong(expected, elapsed)) {
+            from_.store(from, std::memory_order_relaxed);
+            std::cout << "First warm cache hit (" << kServedFromNames[static_cast<std::size_t>(from)] << ") "
+                      << elapsed / 1000.0 << "ms after start" << std::endl;
+        }
+    }
+
+    // -1, пока попадания не было
+    std::int64_t elapsed_us() const { return elapsed_us_.load(std::memory_order_relaxed); }
+    ServedFrom from() const { return from_.load(std::memory_order_relaxed); }
+
+private:
+    const std::chrono::steady_clock::time_point start_;
+    std::atomic<std::int64_t> elapsed_us_{-1};
+    std::atomic<ServedFrom> from_{ServedFrom::None};
+};
+
+// Замер одного запроса: время от создания до done(), ошибка — ответ 5xx. Пока таймер
+// жив, этапы обработки в потоке запроса пишутся в его трассировку; done() добавляет
+// заголовок Server-Timing и передаёт разбивку в RequestTracer.
+class RequestTimer {
+public:
+    RequestTimer(LatencyRecorder &recorder, RequestTracer &tracer, Route route, const crow::request &req)
+        : recorder_(recorder), tracer_(tracer), route_(route), req_(req),
+          scope_(tracer.enabled() ? &stages_ : nullptr), start_(std::chrono::steady_clock::now()) {}
+
+    crow::response done(crow::response res, ServedFrom from) {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        recorder_.record(latency_series(route_, from), elapsed, res.code >= 500);
+        if (tracer_.enabled()) {
+            if (tracer_.server_timing()) {
+                res.set_header("Server-Timing", stages_.server_timing(elapsed));
+            }
+            tracer_.finish(stages_, elapsed, [&] {
+                return crow::method_name(req_.method) + " " + req_.raw_url + " -> " + std::to_string(res.code) +
+                       " (" + kRouteNames[static_cast<std::size_t>(route_)] + ", " +
+                       kServedFromNames[static_cast<std::size_t>(from)] + ")";
+            });
+        }
+        return res;
+    }
+
+private:
+    LatencyRecorder &recorder_;
+    RequestTracer &tracer_;
+    const Route route_;
+    const crow::request &req_;
+    StageTimes stages_;
+    TraceScope scope_;
+    const std::chrono::steady_clock::time_point start_;
+};
+
+// Счётчик поколения страниц списка: входит в ключ страницы, любая запись его увеличивает,
+// и все закешированные страницы разом становятся недостижимы (дотлевают по TTL)
+static const std::string kPagesGeneration = "articles:pages:gen";
+
+// Упорядоченный список id статей для сборки articles_all из фрагментов: "1,2,5,..."
+static const std::string kArticleIdsKey = "articles_all:ids";
+
+// Сроки жизни записи: fresh — мягкий TTL (после него запись обновляется в фоне, но ещё
+// отдаётся), hard — TTL в Redis, после которого ключ пересобирает обычный промах.
+// store == false — ключ холодный и в кеш не пишется (см. HotKeyTracker).
+struct CacheTtl {
+    std::chrono::seconds fresh;
+    std::chrono::seconds hard;
+    bool store = true;
+    std::chrono::seconds not_found{0}; // сколько помнить, что статьи нет; 0 — не помнить
+
+    std::int64_t fresh_until_ms() const {
+        return unix_time_ms() + std::chrono::duration_cast<std::chrono::milliseconds>(fresh).count();
+    }
+};
+
+// Ответ из записи кеша: ETag/304 по If-None-Match и готовый сжатый вариант по Accept-Encoding.
+// ETag — свой у каждого варианта (variant_etag), 304 несёт ETag варианта, который был бы отдан.
+static crow::response make_cached_response(const crow::request &req, const EncodedView &view) {
+    std::string_view content_encoding;
+    std::string_view body = choose_encoding(view, req.get_header_value("Accept-Encoding"), content_encoding);
+    if (etag_matches(req.get_header_value("If-None-Match"), view.etag)) {
+        crow::response res(304);
+        res.set_header("ETag", variant_etag(view.etag, content_encoding));
+        res.set_header("Vary", "Accept-Encoding");
+        return res;
+    }
+
+    crow::response res{std::string(body)};
+    res.set_header("Content-Type", "application/json");
+    res.set_header("ETag", variant_etag(view.etag, content_encoding));
+    res.set_header("Vary", "Accept-Encoding");
+    if (!content_encoding.empty()) {
+        res.set_header("Content-Encoding", std::string(content_encoding));
+    }
+    return res;
+}
+
+// Отказ из-за перегрузки: клиенту предлагается повторить запрос позже
+static crow::response make_overloaded_response(std::string body) {
+    crow::response res(503, std::move(body));
+    res.set_header("Retry-After", "1");
+    return res;
+}
+
+static crow::response make_response(const crow::request &req, const LoadResult &result) {
+    if (result.code == 503) {
+        return make_overloaded_response(result.body);
+    }
+    if (result.code != 200) {
+        return crow::response(result.code, result.body);
+    }
+    return make_cached_response(req, decode_entry(result.body));
+}
+
+// Статья с комментариями из БД; при успехе кладётся в кеш
+static LoadResult load_article(DbPool &db_pool, TieredCache &cache, const std::string &cache_key,
+                               int article_id, CacheTtl ttl, const EncodeOptions &encoding, DbReadMode read_mode) {
+    // JSON собирается в буфер потока, переиспользуемый между запросами
+    ScratchBuffer json;
+    // До чтения БД: инвалидация после него отменяет запись в кеш (см. TieredCache::put)
+    const TieredCache::FillEpoch since = cache.fill_epoch();
+    try {
+        auto conn = db_pool.acquire();
+        ReadTransaction tx(*conn);
+        if (!fetch_article(tx, article_id, json.str(), read_mode)) {
+            if (ttl.not_found.count() > 0) {
+                cache.put(cache_key, std::string(kNotFoundEntry), ttl.not_found, since);
+            }
+            return {404, "Article not found"};
+        }
+    }
+    catch (const DbPoolTimeout &) {
+        return {503, "DB pool exhausted"};
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Exception in article DB fetch (" << cache_key << "): " << e.what() << std::endl;
+        return {500, std::string("Exception: ") + e.what()};
+    }
+
+    std::string entry = encode_entry(json.str(), encoding, ttl.fresh_until_ms());
+    if (ttl.store) {
+        cache.put(cache_key, entry, ttl.hard, since);
+    }
+    return {200, std::move(entry)};
+}
+
+// executor.run с трассировкой: если у запроса есть трассировка, этапы, пройденные в
+// потоке исполнителя, и ожидание в очереди (db_queue) добавляются к ней
+template <typename Fn>
+static auto run_traced(DbExecutor &executor, Fn &&fn) {
+    StageTimes *trace = TraceScope::current();
+    if (!trace) {
+        return executor.run(std::forward<Fn>(fn));
+    }
+    const auto enqueued = std::chrono::steady_clock::now();
+    auto [result, stages] = executor.run([fn = std::forward<Fn>(fn), enqueued]() mutable {
+        StageTimes stages;
+        stages.add(Stage::DbQueue, std::chrono::steady_clock::now() - enqueued);
+        TraceScope scope(&stages);
+        auto result = fn();
+        return std::make_pair(std::move(result), stages);
+    });
+    trace->merge(stages);
+    return std::move(result);
+}
+
+// Пересборка ключа в DbExecutor: при заполненной очереди или истёкшем сроке запрос
+// сразу получает 503, не занимая рабочий поток Crow ожиданием БД
+template <typename Load>
+static LoadResult run_db(DbExecutor &executor, Load &&load) {
+    try {
+        return run_traced(executor, std::forward<Load>(load));
+    }
+    catch (const DbOverloaded &) {
+        return {503, "DB queue is full"};
+    }
+    catch (const DbDeadlineExceeded &) {
+        return {503, "DB deadline exceeded"};
+    }
+}
+
+// Перечитывает множество id статей из БД
+static void reload_article_ids(DbPool &db_pool, ArticleIdIndex &article_ids) {
+    auto conn = db_pool.acquire();
+    ReadTransaction tx(*conn);
+    article_ids.reset(fetch_article_ids(tx));
+}
+
+// Полная пересборка поискового индекса: статьи делятся на части по chunk_size id, части
+// читаются из БД в threads потоках, каждая своим соединением из пула
+static void rebuild_search_index(DbPool &db_pool, SearchIndex &index, std::size_t threads, std::size_t chunk_size) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<int> ids;
+    {
+        auto conn = db_pool.acquire();
+        ReadTransaction tx(*conn);
+        ids = fetch_article_ids(tx);
+    }
+    const std::size_t chunks = (ids.size() + chunk_size - 1) / chunk_size;
+    index.rebuild(chunks, threads, [&db_pool, &ids, chunk_size](std::size_t chunk, SearchIndex::Part &part) {
+        const int after_id = chunk == 0 ? 0 : ids[chunk * chunk_size - 1];
+        const int last_id = ids[std::min(ids.size(), (chunk + 1) * chunk_size) - 1];
+        auto conn = db_pool.acquire();
+        ReadTransaction tx(*conn);
+        fetch_search_documents(tx, after_id, last_id,
+                               [&part](int id, std::string_view title, std::string_view content,
+                                       std::string_view comments) {
+                                   SearchIndex::Terms terms;
+                                   terms.add(title);
+                                   terms.add(content);
+                                   terms.add(comments);
+                                   part.add(id, terms.finish());
+                               });
+    });
+    const SearchIndex::Stats s = index.stats();
+    std::cout << "Search index: " << s.documents << " articles, " << s.terms << " terms, " << s.postings
+              << " postings (" << s.bytes / (1024 * 1024) << " MB) built in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - start).count()
+              << "ms by " << threads << " threads" << std::endl;
+}
+
+// Перечитывает тексты изменившихся статей (ids по возрастанию); статьи, которых уже нет
+// в БД, уходят из индекса
+static void update_search_index(DbPool &db_pool, SearchIndex &index, const std::vector<int> &ids) {
+    auto conn = db_pool.acquire();
+    ReadTransaction tx(*conn);
+    for (std::size_t begin = 0; begin < ids.size(); begin += 1000) {
+        const std::vector<int> part(ids.begin() + static_cast<std::ptrdiff_t>(begin),
+                                    ids.begin() + static_cast<std::ptrdiff_t>(std::min(begin + 1000, ids.size())));
+        std::vector<int> found;
+        fetch_search_documents(tx, part,
+                               [&index, &found](int id, std::string_view title, std::string_view content,
+                                                std::string_view comments) {
+                                   SearchIndex::Terms terms;
+                                   terms.add(title);
+                                   terms.add(content);
+                                   terms.add(comments);
+                                   index.replace(id, terms.finish());
+                                   found.push_back(id);
+                               });
+        for (int id : part) {
+            if (!std::binary_search(found.begin(), found.end(), id)) {
+                index.remove(id);
+            }
+        }
+    }
+}
+
+// Список статей (целиком или страница) из БД; fetch(tx, out) дописывает JSON-текст в out
+template <typename Fetch>
+static LoadResult load_list(DbPool &db_pool, TieredCache &cache, const std::string &cache_key,
+                            CacheTtl ttl, const EncodeOptions &encoding, Fetch &&fetch) {
+    ScratchBuffer json;
+    std::string &json_str = json.str();
+    const TieredCache::FillEpoch since = cache.fill_epoch();
+    try {
+        auto conn = db_pool.acquire();
+        ReadTransaction tx(*conn);
+        fetch(tx, json_str);
+    }
+    catch (const DbPoolTimeout &) {
+        return {503, "DB pool exhausted"};
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Exception in /articles handler: " << e.what() << std::endl;
+        return {500, std::string("Exception: ") + e.what()};
+    }
+
+    std::string entry = encode_entry(json_str, encoding, ttl.fresh_until_ms());
+    if (ttl.store) {
+        cache.put(cache_key, entry, ttl.hard, since);
+    }
+    return {200, std::move(entry)};
+}
+
+static std::vector<int> parse_id_list(const std::string &text) {
+    std::vector<int> ids;
+    const char *p = text.c_str();
+    while (*p) {
+        char *end = nullptr;
+        const long id = std::strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        ids.push_back(static_cast<int>(id));
+        p = *end == ',' ? end + 1 : end;
+    }
+    return ids;
+}
+
+static std::string format_id_list(const std::vector<int> &ids) {
+    std::string text;
+    text.reserve(ids.size() * 8);
+    for (int id : ids) {
+        if (!text.empty()) {
+            text += ',';
+        }
+        text += std::to_string(id);
+    }
+    return text;
+}
+
+// Фрагменты article:{id} (те же записи, что кеширует /article/<id>) для списка id:
+// из кеша одним MGET, недостающие — через fetch(missing_ids), то есть одним запросом
+// к БД, с записью в кеш одним конвейером. Id, которых нет в БД, запоминаются в кеше
+// меткой 404 на ttl.not_found. Устаревшие фрагменты с reload_stale тоже читаются из
+// БД, иначе отдаются как есть и перечисляются в stale — для фонового обновления.
+struct ArticleFragments {
+    std::vector<int> ids;
+    std::vector<CacheLookup> cached;              // по порядку ids
+    std::unordered_map<int, std::string> loaded;  // прочитанные из БД
+    std::size_t missing = 0;                      // сколько не нашлось в кеше
+    std::vector<int> stale;                       // отданы из кеша устаревшими
+
+    // JSON статьи ids[i]; пусто, если статьи нет в БД
+    std::string_view json(std::size_t i) const {
+        if (cached[i].value) {
+            if (is_not_found_entry(*cached[i].value)) {
+                return {};
+            }
+            return decode_entry(*cached[i].value).identity;
+        }
+        auto it = loaded.find(ids[i]);
+        return it == loaded.end() ? std::string_view() : std::string_view(it->second);
+    }
+};
+
+// ttl_of(id) -> CacheTtl — сроки прочитанного из БД фрагмента (и решение, класть ли его
+// в кеш); fetch(missing) -> std::optional<std::unordered_map<int, std::string>>; nullopt —
+// ошибка БД, и ни один id не считается отсутствующим
+template <typename TtlOf, typename Fetch>
+static ArticleFragments load_article_fragments(TieredCache &cache, std::vector<int> ids, TtlOf &&ttl_of,
+                                               const EncodeOptions &encoding, bool reload_stale, Fetch &&fetch) {
+    ArticleFragments fragments;
+    fragments.ids = std::move(ids);
+    std::vector<std::string> keys;
+    keys.reserve(fragments.ids.size());
+    for (int id : fragments.ids) {
+        keys.push_back("article:" + std::to_string(id));
+    }
+    fragments.cached = cache.get_many(keys);
+
+    std::vector<int> missing;
+    const std::int64_t now_ms = unix_time_ms();
+    for (std::size_t i = 0; i < fragments.ids.size(); ++i) {
+        L1Cache::Value &value = fragments.cached[i].value;
+        if (value && !is_not_found_entry(*value) && is_stale(decode_entry(*value), now_ms)) {
+            if (reload_stale) {
+                value.reset();
+            }
+            else {
+                fragments.stale.push_back(fragments.ids[i]);
+            }
+        }
+        if (!value) {
+            missing.push_back(fragments.ids[i]);
+        }
+    }
+    fragments.missing = missing.size();
+    if (missing.empty()) {
+        return fragments;
+    }
+    const TieredCache::FillEpoch since = cache.fill_epoch();
+    std::optional<std::unordered_map<int, std::string>> loaded = fetch(missing);
+    if (!loaded) {
+        return fragments;
+    }
+    fragments.loaded = std::move(*loaded);
+
+    // Записи с одинаковым сроком жизни — одним конвейером (обычно их одна-две группы)
+    std::map<std::chrono::seconds, std::vector<std::pair<std::string, std::string>>> by_ttl;
+    for (int id : missing) {
+        const CacheTtl ttl = ttl_of(id);
+        auto it = fragments.loaded.find(id);
+        if (it == fragments.loaded.end()) {
+            if (ttl.not_found.count() > 0) {
+                by_ttl[ttl.not_found].emplace_back("article:" + std::to_string(id), std::string(kNotFoundEntry));
+            }
+        }
+        else if (ttl.store) {
+            by_ttl[ttl.hard].emplace_back("article:" + std::to_string(id),
+                                          encode_entry(it->second, encoding, ttl.fresh_until_ms()));
+        }
+    }
+    for (const auto &[ttl, entries] : by_ttl) {
+        cache.put_many(entries, ttl, since);
+    }
+    return fragments;
+}
+
+// Недостающие фрагменты из БД: статьи и их комментарии двумя запросами
+static std::unordered_map<int, std::string> fetch_missing_fragments(DbPool &db_pool, const std::vector<int> &ids,
+                                                                    DbReadMode read_mode) {
+    auto conn = db_pool.acquire();
+    ReadTransaction tx(*conn);
+    return fetch_article_fragments(tx, ids, read_mode);
+}
+
+// Недостающие фрагменты из обработчика: запрос идёт в db_executor, отказ или ошибка —
+// пустой результат и ответ клиенту в failed. Задача может пережить обработчик (истёк
+// срок), поэтому missing копируется в неё.
+static std::optional<std::unordered_map<int, std::string>>
+fetch_fragments_for_request(DbExecutor &db_executor, DbPool &db_pool, const std::vector<int> &missing,
+                            DbReadMode read_mode, const char *handler, LoadResult &failed) {
+    try {
+        return run_traced(db_executor, [&db_pool, missing, read_mode]() {
+            return fetch_missing_fragments(db_pool, missing, read_mode);
+        });
+    }
+    catch (const DbOverloaded &) {
+        failed = {503, "DB queue is full"};
+    }
+    catch (const DbDeadlineExceeded &) {
+        failed = {503, "DB deadline exceeded"};
+    }
+    catch (const DbPoolTimeout &) {
+        failed = {503, "DB pool exhausted"};
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Exception in " << handler << " handler: " << e.what() << std::endl;
+        failed = {500, std::string("Exception: ") + e.what()};
+    }
+    return std::nullopt;
+}
+
+// Откуда взят ответ из фрагментов: БД, если хоть один читался из неё, иначе самый
+// дальний из уровней кеша
+static ServedFrom fragments_served_from(const ArticleFragments &fragments) {
+    auto any_from = [&fragments](CacheSource source) {
+        return std::any_of(fragments.cached.begin(), fragments.cached.end(),
+                           [source](const CacheLookup &c) { return c.value && c.source == source; });
+    };
+    if (fragments.missing > 0) {
+        return ServedFrom::Db;
+    }
+    if (any_from(CacheSource::Redis)) {
+        return ServedFrom::Redis;
+    }
+    return any_from(CacheSource::Snapshot) ? ServedFrom::Snapshot : ServedFrom::L1;
+}
+
+// articles_all из фрагментов article:{id}: список id берётся из kArticleIdsKey (или БД),
+// фрагменты — load_article_fragments. Новый комментарий стоит пересборки одного
+// фрагмента, а не всего списка.
+static LoadResult load_composed_list(DbPool &db_pool, TieredCache &cache, CacheTtl ttl,
+                                     const EncodeOptions &encoding, DbReadMode read_mode) {
+    ArticleFragments fragments;
+    // Список собирается и из кеша, и из БД: инвалидация любого из них сбрасывает и articles_all
+    const TieredCache::FillEpoch since = cache.fill_epoch();
+    try {
+        std::vector<int> ids;
+        const CacheLookup cached_ids = cache.get(kArticleIdsKey);
+        if (cached_ids.value) {
+            ids = parse_id_list(*cached_ids.value);
+        }
+        else {
+            auto conn = db_pool.acquire();
+            ReadTransaction tx(*conn);
+            ids = fetch_article_ids(tx);
+            cache.put(kArticleIdsKey, format_id_list(ids), ttl.hard, since);
+        }
+        // Список пересобирается в фоне или на промахе — устаревшие фрагменты читаются заодно
+        fragments = load_article_fragments(
+            cache, std::move(ids), [ttl](int) { return ttl; }, encoding, true,
+            [&db_pool, read_mode](const std::vector<int> &missing) -> std::optional<std::unordered_map<int, std::string>> {
+                return fetch_missing_fragments(db_pool, missing, read_mode);
+            });
+    }
+    catch (const DbPoolTimeout &) {
+        return {503, "DB pool exhausted"};
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Exception in /articles handler: " << e.what() << std::endl;
+        return {500, std::string("Exception: ") + e.what()};
+    }
+
+    ScratchBuffer json;
+    std::string &json_str = json.str();
+    std::optional<StageSpan> serialize(Stage::Serialize);
+    JsonWriter writer(json_str);
+    writer.begin_object().key("articles").begin_array();
+    for (std::size_t i = 0; i < fragments.ids.size(); ++i) {
+        const std::string_view article = fragments.json(i);
+        if (!article.empty()) { // пусто — статью удалили после сборки списка id
+            writer.raw(article);
+        }
+    }
+    writer.end_array().end_object();
+    serialize.reset();
+
+    std::string entry = encode_entry(json_str, encoding, ttl.fresh_until_ms());
+    cache.put("articles_all", entry, ttl.hard, since);
+    return {200, std::move(entry)};
+}
+
+// Список id из параметра ids=1,2,3: только неотрицательные целые через запятую
+static bool parse_ids_param(const char *value, std::vector<int> &out) {
+    if (!value || !*value) {
+        return false;
+    }
+    const char *p = value;
+    while (true) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        char *end = nullptr;
+        const long parsed = std::strtol(p, &end, 10);
+        if (parsed > std::numeric_limits<int>::max()) {
+            return false;
+        }
+        out.push_back(static_cast<int>(parsed));
+        if (*end == '\0') {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        p = end + 1;
+    }
+}
+
+// Строковое поле JSON-тела запроса; false, если поля нет, оно не строка или пустое
+static bool json_string_field(const crow::json::rvalue &body, const char *name, std::string &out) {
+    if (!body.has(name) || body[name].t() != crow::json::type::String) {
+        return false;
+    }
+    out = body[name].s();
+    return !out.empty();
+}
+
+// Ответ на запись: 201 с id или ошибка по статусу
+static crow::response make_write_response(const WriteResult &result) {
+    switch (result.status) {
+        case WriteStatus::Created: {
+            std::string body;
+            JsonWriter json(body);
+            json.begin_object().key("id").value(result.id).end_object();
+            crow::response res(201, body);
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        case WriteStatus::ArticleNotFound:
+            return crow::response(404, "Article not found");
+        case WriteStatus::Overloaded:
+            return make_overloaded_response("Write queue is full");
+        case WriteStatus::Failed:
+            break;
+    }
+    return crow::response(500, "DB error");
+}
+
+// Ответ групповой записи ждётся не дольше срока БД, как и промахи: зависшая фиксация не
+// занимает поток Crow. Запись при этом ещё может зафиксироваться, поэтому Retry-After не
+// ставится — повтор мог бы её продублировать.
+static crow::response await_write(std::future<WriteResult> result, std::chrono::milliseconds deadline) {
+    if (result.wait_for(deadline) != std::future_status::ready) {
+        return crow::response(503, "Write deadline exceeded");
+    }
+    return make_write_response(result.get());
+}
+
+// Разбор неотрицательного целого параметра запроса
+static bool parse_int_param(const char *value, int &out) {
+    if (!value || !*value) {
+        return false;
+    }
+    char *end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    if (*end != '\0' || parsed < 0 || parsed > std::numeric_limits<int>::max()) {
+        return false;
+    }
+    out = static_cast<int>(parsed);
+    return true;
+}
+
 int main() {
+    const auto process_start = std::chrono::steady_clock::now();
     crow::SimpleApp app;
 
-    const std::string conn_str = "dbname=blogdb user=bloguser";
+    // Пул соединений к PostgreSQL размером с число рабочих потоков Crow
+    const unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    DbPool::Options pool_options;
+    pool_options.conn_str = env_string("DB_CONN", "dbname=blogdb user=bloguser");
+    pool_options.size = static_cast<std::size_t>(std::max(1L, env_long("DB_POOL_SIZE", workers)));
+    pool_options.checkout_timeout = std::chrono::milliseconds(env_long("DB_POOL_TIMEOUT_MS", 1000));
+    DbPool db_pool(pool_options, prepare_article_statements);
+
+    // Запросы к БД при промахах выполняются в отдельных потоках. Потоков Crow вдвое больше
+    // ядер, а ждать БД одновременно могут не больше DB_EXECUTOR_THREADS + DB_QUEUE_MAX
+    // из них — остальные отдают ответы из кеша, даже когда БД не успевает.
+    const unsigned server_threads = static_cast<unsigned>(std::max(1L, env_long("SERVER_THREADS", 2L * workers)));
+    LatencyRecorder db_queue_wait("db_executor_queue_wait", DbExecutor::wait_labels());
+    DbExecutor::Options executor_options;
+    executor_options.threads =
+        static_cast<std::size_t>(std::max(1L, env_long("DB_EXECUTOR_THREADS", static_cast<long>(pool_options.size))));
+    executor_options.max_queue =
+        static_cast<std::size_t>(std::max(1L, env_long("DB_QUEUE_MAX", std::max(1u, workers / 2))));
+    executor_options.deadline = std::chrono::milliseconds(env_long("DB_DEADLINE_MS", 1000));
+    executor_options.queue_wait = &db_queue_wait;
+    if (executor_options.threads + executor_options.max_queue >= server_threads) {
+        std::cerr << "Warning: DB_EXECUTOR_THREADS + DB_QUEUE_MAX >= SERVER_THREADS, "
+                     "misses can occupy every server thread" << std::endl;
+    }
+
+    // ARTICLES_JSON_MODE=pg_json — собирать список статей в JSON силами PostgreSQL
+    const ArticleListMode list_mode = article_list_mode_from(env_string("ARTICLES_JSON_MODE", "grouped"));
+    // DB_READ_PIPELINE=off — отправлять запросы одного чтения по одному (для сравнения)
+    const DbReadMode read_mode =
+        env_string("DB_READ_PIPELINE", "on") == "on" ? DbReadMode::Pipeline : DbReadMode::Sequential;
+    // ARTICLES_COMPOSE=off — собирать articles_all целиком из БД (ARTICLES_JSON_MODE), а не из фрагментов
+    const bool compose_list = env_string("ARTICLES_COMPOSE", "on") == "on";
+    // CACHE_TTL — мягкий TTL; ещё CACHE_STALE_TTL секунд после него запись отдаётся
+    // устаревшей, пока фоновый поток её обновляет. С DB_NOTIFY=on записи сбрасываются по
+    // уведомлениям триггеров, и TTL по умолчанию — час, а не минута; если триггеры не
+    // установлены, уведомлений не будет, и TTL по умолчанию остаётся минутой. Загрузка,
+    // прочитавшая БД до записи, не кладёт ответ после её инвалидации (TieredCache::put с
+    // fill_epoch), поэтому час не продлевает жизнь старых записей.
+    const bool db_notify = env_string("DB_NOTIFY", "off") == "on";
+    bool notify_triggers = false;
+    if (db_notify) {
+        try {
+            auto conn = db_pool.acquire();
+            ReadTransaction tx(*conn);
+            notify_triggers = db_change_triggers_installed(tx);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "DB_NOTIFY: failed to check triggers: " << e.what() << std::endl;
+        }
+        if (!notify_triggers) {
+            std::cerr << "Warning: DB_NOTIFY=on, but triggers from sql/cache_invalidation.sql are not installed; "
+                         "default CACHE_TTL stays 60 s" << std::endl;
+        }
+    }
+    const long cache_ttl = env_long("CACHE_TTL", notify_triggers ? 3600 : 60);
+    const long stale_ttl = env_long("CACHE_STALE_TTL", 60);
+    const long random_fresh = std::max(110L, cache_ttl);
+    // CACHE_NOT_FOUND_TTL — сколько секунд помнить 404 (несуществующие id не идут в БД)
+    const std::chrono::seconds not_found_ttl(std::max(0L, env_long("CACHE_NOT_FOUND_TTL", 5)));
+    const CacheTtl default_ttl{std::chrono::seconds(cache_ttl), std::chrono::seconds(cache_ttl + stale_ttl), true,
+                               not_found_ttl};
+    const CacheTtl random_ttl{std::chrono::seconds(random_fresh), std::chrono::seconds(random_fresh + stale_ttl), true,
+                              not_found_ttl};
+    const int max_page_size = static_cast<int>(env_long("ARTICLES_MAX_PAGE", 1000));
+    const std::size_t max_batch_ids = static_cast<std::size_t>(env_long("ARTICLES_MAX_IDS", 100));
+
+    // Закешированные ответы хранятся с ETag и заранее сжатыми вариантами
+    EncodeOptions encoding;
+    encoding.gzip_level = static_cast<int>(env_long("CACHE_GZIP_LEVEL", 6));
+    encoding.min_size = static_cast<std::size_t>(env_long("CACHE_COMPRESS_MIN_BYTES", 256));
+
+    // Пул соединений к Redis: по умолчанию по соединению на рабочий поток Crow. Короткие
+    // таймауты подключения и команд: медленный Redis должен стоить промаха, а не секунд.
+    // Соединения пула создаются по требованию, так что недоступный при старте Redis
+    // подхватывается, когда поднимется.
+    const std::string redis_uri = env_string("REDIS_URI", "tcp://127.0.0.1:6379");
+    ConnectionOptions redis_connection(redis_uri);
+    redis_connection.connect_timeout = std::chrono::milliseconds(env_long("REDIS_CONNECT_TIMEOUT_MS", 100));
+    redis_connection.socket_timeout = std::chrono::milliseconds(env_long("REDIS_COMMAND_TIMEOUT_MS", 50));
+    ConnectionPoolOptions redis_pool_options;
+    redis_pool_options.size = static_cast<std::size_t>(std::max(1L, env_long("REDIS_POOL_SIZE", workers)));
+    // Ожидание свободного соединения тоже ограничено: занятый пул — промах, а не зависший поток
+    redis_pool_options.wait_timeout = std::chrono::milliseconds(std::max(1L, env_long("REDIS_POOL_WAIT_MS", 100)));
     std::unique_ptr<Redis> redis_client;
     try {
-        redis_client = std::make_unique<Redis>("tcp://127.0.0.1:6379");
+        redis_client = std::make_unique<Redis>(redis_connection, redis_pool_options);
     }
     catch (const std::exception &e) {
         std::cerr << "Ошибка подключения к Valkey: " << e.what() << std::endl;
     }
 
-    CROW_ROUTE(app, "/article/random")([&conn_str, &redis_client]() {
-        auto start = std::chrono::high_resolution_clock::now();
+    // Многоключевые команды (сборка списка из фрагментов, загрузка articles:ids, повтор
+    // инвалидаций) — через отдельный небольшой пул с REDIS_BULK_TIMEOUT_MS: ответ на тысячи
+    // ключей не укладывается в таймаут одиночной команды, а поднимать его для всех нельзя.
+    std::unique_ptr<Redis> redis_bulk_client;
+    if (redis_client) {
+        ConnectionOptions bulk_connection = redis_connection;
+        bulk_connection.socket_timeout = std::chrono::milliseconds(std::max(1L, env_long("REDIS_BULK_TIMEOUT_MS", 1000)));
+        ConnectionPoolOptions bulk_pool_options = redis_pool_options;
+        bulk_pool_options.size = static_cast<std::size_t>(std::max(1L, env_long("REDIS_BULK_POOL_SIZE", 2)));
+        bulk_pool_options.wait_timeout = bulk_connection.socket_timeout;
+        try {
+            redis_bulk_client = std::make_unique<Redis>(bulk_connection, bulk_pool_options);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Redis bulk client unavailable, using the main pool: " << e.what() << std::endl;
+        }
+    }
+
+    // Автомат защиты: после REDIS_BREAKER_FAILURES ошибок подряд кеш, блокировка промахов
+    // и индекс id обходят Redis, пока фоновый PING раз в REDIS_BREAKER_OPEN_MS не покажет,
+    // что он снова доступен. Ошибки Redis — не чаще строки в REDIS_LOG_INTERVAL_MS.
+    std::unique_ptr<RedisBreaker> redis_breaker;
+    if (redis_client) {
+        RedisBreaker::Options breaker_options;
+        breaker_options.failure_threshold =
+            static_cast<std::uint32_t>(std::max(1L, env_long("REDIS_BREAKER_FAILURES", 5)));
+        breaker_options.open_duration = std::chrono::milliseconds(env_long("REDIS_BREAKER_OPEN_MS", 1000));
+        breaker_options.log_interval = std::chrono::milliseconds(env_long("REDIS_LOG_INTERVAL_MS", 5000));
+        redis_breaker = std::make_unique<RedisBreaker>(breaker_options, [&redis_client] { redis_client->ping(); });
+    }
+
+    // Задержки команд Redis из кеша (/metrics, redis_command_duration_seconds)
+    LatencyRecorder redis_latency("redis_command_duration", TieredCache::command_labels());
+
+    // L1-кеш в процессе перед Redis, согласованный между экземплярами через pub/sub
+    TieredCache::Options cache_options;
+    cache_options.redis_uri = redis_uri;
+    cache_options.channel = env_string("CACHE_INVALIDATION_CHANNEL", "cache_invalidation");
+    cache_options.l1.max_bytes = static_cast<std::size_t>(env_long("L1_CACHE_MB", 64)) * 1024 * 1024;
+    cache_options.l1_ttl = std::chrono::seconds(env_long("L1_CACHE_TTL", cache_ttl + stale_ttl));
+    cache_options.command_latency = &redis_latency;
+    cache_options.connect_timeout = redis_connection.connect_timeout;
 
-        int article_id = -1;
+    // CACHE_SNAPSHOT_FILE — снимок горячих записей для тёплого рестарта (cache_snapshot.h):
+    // при старте отображается через mmap, его записи отдаются с первого запроса и в фоне
+    // сверяются с БД; пишется раз в CACHE_SNAPSHOT_INTERVAL_S и при остановке. Снимок
+    // старше CACHE_SNAPSHOT_MAX_AGE_S не загружается. Объявлен до кеша: живёт дольше него.
+    const std::string snapshot_path = env_string("CACHE_SNAPSHOT_FILE", "");
+    CacheSnapshot snapshot;
+    if (!snapshot_path.empty() &&
+        snapshot.open(snapshot_path, std::chrono::seconds(env_long("CACHE_SNAPSHOT_MAX_AGE_S", 3600)))) {
+        const CacheSnapshot::Stats loaded = snapshot.stats();
+        std::cout << "Cache snapshot: " << loaded.loaded << " entries (" << loaded.expired << " expired) from "
+                  << snapshot_path << ", written " << (CacheSnapshot::now_ms() - loaded.created_ms) / 1000
+                  << "s ago, mapped in " << loaded.load_us / 1000.0 << "ms" << std::endl;
+    }
+
+    TieredCache cache(redis_client.get(), cache_options);
+    cache.use_breaker(redis_breaker.get());
+    cache.use_bulk(redis_bulk_client.get());
+    if (!snapshot_path.empty()) {
+        cache.use_snapshot(&snapshot);
+    }
+
+    cache.start_invalidation_listener();
+
+#ifdef HAVE_REDIS_ASYNC
+    // CACHE_REDIS_ASYNC=on: заполнение кеша не ждёт Redis, чтение ждёт не дольше CACHE_REDIS_ASYNC_TIMEOUT_MS
+    std::unique_ptr<AsyncRedis> async_redis;
+    if (redis_client && env_string("CACHE_REDIS_ASYNC", "off") == "on") {
         try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "DB connection failed");
+            async_redis = std::make_unique<AsyncRedis>(redis_connection, redis_pool_options);
+            cache.use_async(async_redis.get(), std::chrono::milliseconds(env_long("CACHE_REDIS_ASYNC_TIMEOUT_MS", 50)));
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Async Redis client unavailable, using blocking client: " << e.what() << std::endl;
+        }
+    }
+#endif
+
+    // Промах по ключу пересобирает только один запрос в процессе, остальные ждут его результат.
+    // CACHE_MISS_LOCK=redis дополнительно объединяет промахи всех экземпляров через SET NX PX.
+    // Оба ожидания — вне DbExecutor, поэтому по умолчанию ограничены тем же DB_DEADLINE_MS,
+    // а не дождавшийся запрос получает 503, как и при истёкшем сроке БД.
+    const long db_deadline_ms = static_cast<long>(executor_options.deadline.count());
+    SingleFlight<LoadResult> misses(std::chrono::milliseconds(env_long("SINGLE_FLIGHT_WAIT_MS", db_deadline_ms)));
+    RedisMissLock::Options lock_options;
+    lock_options.lock_ttl = std::chrono::milliseconds(env_long("CACHE_LOCK_TTL_MS", 5000));
+    lock_options.max_wait = std::chrono::milliseconds(env_long("CACHE_LOCK_WAIT_MS", db_deadline_ms));
+    const bool use_miss_lock = env_string("CACHE_MISS_LOCK", "off") == "redis";
+    RedisMissLock miss_lock(use_miss_lock ? redis_client.get() : nullptr, lock_options, redis_breaker.get());
+
+    // Индекс id статей для /article/random: загружается при старте и периодически
+    // сверяется с БД; ARTICLE_IDS_SOURCE=redis — общий Redis-сет с SRANDMEMBER
+    const bool shared_ids = env_string("ARTICLE_IDS_SOURCE", "local") == "redis";
+    ArticleIdIndex article_ids(shared_ids ? redis_client.get() : nullptr, redis_breaker.get(),
+                               redis_bulk_client.get());
+    try {
+        reload_article_ids(db_pool, article_ids);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Failed to load article ids: " << e.what() << std::endl;
+    }
+    PeriodicTask article_ids_refresher("article_ids",
+        std::chrono::milliseconds(std::max(1L, env_long("ARTICLE_IDS_REFRESH_S", 60)) * 1000),
+        [&db_pool, &article_ids] { reload_article_ids(db_pool, article_ids); });
+
+    // Поисковый индекс для GET /articles/search (search_index.h). Собирается фоновой
+    // задачей в SEARCH_INDEX_THREADS потоков, чтобы не задерживать старт (до готовности —
+    // 503), затем обновляется по изменившимся статьям раз в SEARCH_INDEX_UPDATE_MS;
+    // SEARCH_INDEX_REBUILD_S > 0 — ещё и периодическая полная пересборка. Каждый поток
+    // сборки держит соединение пула на всё чтение своей части, поэтому их по умолчанию
+    // 1–2 и не больше половины пула: запросы во время пересборки не ждут соединений.
+    const bool search_enabled = env_string("SEARCH_INDEX", "on") == "on";
+    const long search_max_threads = std::max<long>(1, static_cast<long>(pool_options.size / 2));
+    const std::size_t search_threads = static_cast<std::size_t>(std::clamp(
+        env_long("SEARCH_INDEX_THREADS", std::min(2L, search_max_threads)), 1L, search_max_threads));
+    const std::size_t search_chunk = static_cast<std::size_t>(std::max(1L, env_long("SEARCH_INDEX_CHUNK", 5000)));
+    const std::chrono::seconds search_rebuild_every(std::max(0L, env_long("SEARCH_INDEX_REBUILD_S", 0)));
+    SearchIndex search_index;
+    // Хуки записи и уведомлений БД отмечают статьи только при включённом поиске
+    SearchIndex *search_updates = search_enabled ? &search_index : nullptr;
+    std::unique_ptr<PeriodicTask> search_updater;
+    if (search_enabled) {
+        search_index.mark_all_changed();
+        search_updater = std::make_unique<PeriodicTask>("search_index",
+            std::chrono::milliseconds(std::max(1L, env_long("SEARCH_INDEX_UPDATE_MS", 500))),
+            [&db_pool, &search_index, search_threads, search_chunk, search_rebuild_every,
+             last_rebuild = std::chrono::steady_clock::now()]() mutable {
+                bool rebuild = false;
+                std::vector<int> ids = search_index.take_changed(rebuild);
+                const auto now = std::chrono::steady_clock::now();
+                if (search_rebuild_every.count() > 0 && now - last_rebuild >= search_rebuild_every) {
+                    rebuild = true;
+                }
+                try {
+                    if (rebuild) {
+                        rebuild_search_index(db_pool, search_index, search_threads, search_chunk);
+                        last_rebuild = now;
+                    }
+                    update_search_index(db_pool, search_index, ids);
+                }
+                catch (...) {
+                    // Не потерять изменения: повторить на следующем такте
+                    if (rebuild) {
+                        search_index.mark_all_changed();
+                    }
+                    for (int id : ids) {
+                        search_index.mark_changed(id);
+                    }
+                    throw;
+                }
+            });
+    }
+
+    // Задержки запросов по маршрутам и источникам ответа (/metrics). LATENCY_DUMP_FILE —
+    // дополнительно писать каждый запрос в бинарный файл для build/plot_response_times.py;
+    // записи копятся в буферах потоков и сбрасываются на диск фоновой задачей.
+    const std::string dump_path = env_string("LATENCY_DUMP_FILE", "");
+    LatencyRecorder latency("http_request_duration", latency_series_labels(),
+                            dump_path.empty() ? 0 : static_cast<std::size_t>(env_long("LATENCY_DUMP_BUFFER", 65536)));
+    std::unique_ptr<PeriodicTask> latency_dumper;
+    if (!dump_path.empty()) {
+        // Рядом с дампом — имена рядов по номеру, чтобы скрипт мог фильтровать по маршруту
+        if (std::FILE *series = std::fopen((dump_path + ".series").c_str(), "w")) {
+            for (std::size_t i = 0; i < latency.series_count(); ++i) {
+                std::fprintf(series, "%s\n", latency.labels(i).c_str());
             }
-            try {
-                conn.prepare("get_random_id", "SELECT id FROM articles ORDER BY RANDOM() LIMIT 1");
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
-                conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
+            std::fclose(series);
+        }
+        std::FILE *dump = std::fopen(dump_path.c_str(), "ab");
+        if (!dump) {
+            std::cerr << "Cannot open latency dump file " << dump_path << std::endl;
+        }
+        else {
+            latency_dumper = std::make_unique<PeriodicTask>("latency_dump",
+                std::chrono::milliseconds(std::max(1L, env_long("LATENCY_DUMP_INTERVAL_MS", 1000))), [&latency, dump] {
+                    if (std::uint64_t dropped = latency.drain_dump(dump)) {
+                        std::cerr << "Latency dump: " << dropped << " records dropped" << std::endl;
+                    }
+                });
+        }
+    }
+
+    // Трассировка этапов запроса (request_trace.h): заголовок Server-Timing, гистограммы
+    // request_stage_duration и журнал запросов дольше SLOW_REQUEST_MS (каждый
+    // SLOW_REQUEST_SAMPLE-й из них) с разбивкой по этапам
+    RequestTracer::Options trace_options;
+    trace_options.enabled = env_string("REQUEST_TRACE", "on") == "on";
+    trace_options.server_timing = env_string("SERVER_TIMING", "on") == "on";
+    trace_options.slow_threshold = std::chrono::milliseconds(std::max(0L, env_long("SLOW_REQUEST_MS", 200)));
+    trace_options.slow_log_sample = static_cast<std::uint32_t>(std::max(1L, env_long("SLOW_REQUEST_SAMPLE", 1)));
+    RequestTracer tracer(trace_options);
+
+    // Запись статей и комментариев пачками (group commit). После фиксации пачки одним
+    // конвейером в Redis сбрасываются только затронутые ключи и поколение страниц списка.
+    WriteBatcher::Options write_options;
+    write_options.max_batch = static_cast<std::size_t>(std::max(1L, env_long("WRITE_BATCH_MAX", 64)));
+    write_options.max_delay = std::chrono::microseconds(std::max(1L, env_long("WRITE_BATCH_DELAY_US", 1000)));
+    write_options.max_pending = static_cast<std::size_t>(std::max(1L, env_long("WRITE_QUEUE_MAX", 10000)));
+    // Новый комментарий сбрасывает фрагмент своей статьи и articles_all (который затем
+    // собирается из фрагментов), новая статья — ещё список id и свою запись article:{id}:
+    // если id запрашивали до вставки, там лежит «статьи нет» (kNotFoundEntry).
+    WriteBatcher writes(db_pool, write_options, [&cache, &article_ids, search_updates](
+                                                    const std::vector<PendingWrite> &batch,
+                                                    const std::vector<WriteResult> &results) {
+        std::vector<std::string> keys;
+        bool created = false;
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (results[i].status != WriteStatus::Created) {
+                continue;
             }
-            catch (...) {}
-            pqxx::work tx(conn);
+            created = true;
+            if (search_updates) {
+                search_updates->mark_changed(batch[i].kind == PendingWrite::Kind::Article ? results[i].id
+                                                                                           : results[i].article_id);
+            }
+            if (batch[i].kind == PendingWrite::Kind::Article) {
+                article_ids.add(results[i].id);
+                keys.push_back(kArticleIdsKey);
+                keys.push_back("article:" + std::to_string(results[i].id));
+            }
+            else {
+                keys.push_back("article:" + std::to_string(results[i].article_id));
+            }
+        }
+        if (!created) {
+            return;
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        keys.push_back("articles_all");
+        cache.invalidate(keys, {kPagesGeneration});
+    });
+
+    // Инвалидация по LISTEN/NOTIFY (триггеры из sql/cache_invalidation.sql): видит и записи
+    // в обход сервиса. Свои записи сбрасываются ещё и хуком WriteBatcher — это идемпотентно.
+    std::unique_ptr<DbChangeListener> db_changes;
+    if (db_notify) {
+        auto on_changes = [&cache, &article_ids, search_updates](const std::vector<DbChange> &changes) {
+            std::vector<std::string> keys = {"articles_all"};
+            for (const DbChange &change : changes) {
+                if (search_updates) {
+                    search_updates->mark_changed(change.article_id);
+                }
+                keys.push_back("article:" + std::to_string(change.article_id));
+                if (change.membership) {
+                    keys.push_back(kArticleIdsKey);
+                    if (change.added) {
+                        article_ids.add(change.article_id);
+                    }
+                    else {
+                        article_ids.remove(change.article_id);
+                    }
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            cache.invalidate(keys, {kPagesGeneration});
+        };
 
-            pqxx::result rnd = tx.exec_prepared("get_random_id");
-            if (rnd.empty()) {
-                return crow::response(404, "No articles available");
+        // Уведомления могли потеряться: сбрасываются все статьи — и из БД, и из последнего
+        // закешированного списка id (так находятся статьи, удалённые за время разрыва)
+        auto resync = [&cache, &db_pool, &article_ids, search_updates]() {
+            if (search_updates) {
+                search_updates->mark_all_changed();
+            }
+            std::vector<int> ids;
+            if (auto cached_ids = cache.get(kArticleIdsKey).value) {
+                ids = parse_id_list(*cached_ids);
             }
-            article_id = rnd[0][0].as<int>();
-            tx.commit();
+            std::vector<int> current;
+            {
+                auto conn = db_pool.acquire();
+                ReadTransaction tx(*conn);
+                current = fetch_article_ids(tx);
+            }
+            article_ids.reset(current);
+            ids.insert(ids.end(), current.begin(), current.end());
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+            std::vector<std::string> keys = {"articles_all", kArticleIdsKey};
+            for (int id : ids) {
+                keys.push_back("article:" + std::to_string(id));
+                if (keys.size() == 1000) {
+                    cache.invalidate(keys);
+                    keys.clear();
+                }
+            }
+            cache.invalidate(keys, {kPagesGeneration});
+            std::cerr << "DB change listener: resync invalidated " << ids.size() << " articles" << std::endl;
+        };
+
+        DbChangeListener::Options listener_options;
+        listener_options.conn_str = pool_options.conn_str;
+        listener_options.channel = env_string("DB_NOTIFY_CHANNEL", "article_changes");
+        db_changes = std::make_unique<DbChangeListener>(listener_options, on_changes, resync);
+    }
+
+    // shared == false — ключ холодный, и значение в кеш не попадёт: другим экземплярам
+    // ждать его нечего, поэтому блокировка в Redis не ставится
+    auto load_coalesced = [&misses, &miss_lock, &cache](const std::string &cache_key, auto &&load,
+                                                        bool shared = true) {
+        auto wait_exceeded = []() { return LoadResult{503, "Cache rebuild wait exceeded"}; };
+        return misses.run(cache_key, [&]() {
+            if (!shared) {
+                return load();
+            }
+            auto probe = [&]() -> std::optional<LoadResult> {
+                if (auto cached = cache.get_from_redis(cache_key)) {
+                    if (is_not_found_entry(*cached)) {
+                        return LoadResult{404, "Article not found"};
+                    }
+                    return LoadResult{200, *cached};
+                }
+                return std::nullopt;
+            };
+            return miss_lock.run<LoadResult>(cache_key, load, probe, wait_exceeded);
+        }, wait_exceeded);
+    };
+
+    // Исполнитель объявлен после кеша и всего, что захватывают его задачи: задача, которую
+    // перестали ждать, доводится до конца, и при выходе из main() деструктор исполнителя
+    // дожидается её раньше, чем разрушатся cache, encoding и db_pool.
+    DbExecutor db_executor(executor_options);
+
+    // Пересборка ключей из БД. Всё, кроме объектов main(), захватывается по значению:
+    // те же функции выполняет и фоновое обновление уже после выхода из обработчика.
+    // Сами запросы к БД выполняются в db_executor.
+    auto article_loader = [&db_pool, &db_executor, &cache, &encoding, read_mode](int article_id, CacheTtl ttl) {
+        return [&db_pool, &db_executor, &cache, &encoding, read_mode, article_id, ttl]() {
+            return run_db(db_executor, [&db_pool, &cache, &encoding, read_mode, article_id, ttl]() {
+                return load_article(db_pool, cache, "article:" + std::to_string(article_id), article_id, ttl, encoding,
+                                    read_mode);
+            });
+        };
+    };
+    auto list_loader = [&db_pool, &db_executor, &cache, &encoding, compose_list, list_mode, read_mode, default_ttl]() {
+        return run_db(db_executor, [&db_pool, &cache, &encoding, compose_list, list_mode, read_mode, default_ttl]() {
+            if (compose_list) {
+                return load_composed_list(db_pool, cache, default_ttl, encoding, read_mode);
+            }
+            return load_list(db_pool, cache, "articles_all", default_ttl, encoding,
+                             [list_mode, read_mode](pqxx::transaction_base &tx, std::string &out) {
+                                 fetch_articles_json(tx, list_mode, out, read_mode);
+                             });
+        });
+    };
+    auto page_loader = [&db_pool, &db_executor, &cache, &encoding, read_mode](std::string cache_key, int after_id,
+                                                                            int limit, CacheTtl ttl) {
+        return [&db_pool, &db_executor, &cache, &encoding, read_mode, ttl, cache_key = std::move(cache_key), after_id,
+                limit]() {
+            return run_db(db_executor, [&db_pool, &cache, &encoding, read_mode, ttl, cache_key, after_id, limit]() {
+                return load_list(db_pool, cache, cache_key, ttl, encoding,
+                                 [after_id, limit, read_mode](pqxx::transaction_base &tx, std::string &out) {
+                                     fetch_articles_page_json(tx, after_id, limit, out, read_mode);
+                                 });
+            });
+        };
+    };
+
+    // Сверка записи снимка с БД: ключ пересобирается и выходит из снимка (и если статью
+    // удалили). При ошибке БД остаётся до конца прохода проверки.
+    auto revalidate_snapshot_key = [&snapshot, &load_coalesced, &article_loader, &list_loader,
+                                    default_ttl](const std::string &key) -> LoadResult {
+        int article_id = 0;
+        LoadResult loaded;
+        if (key == "articles_all") {
+            loaded = load_coalesced(key, list_loader);
         }
-        catch (const std::exception &e) {
-            std::cerr << "Exception selecting random id: " << e.what() << std::endl;
-            return crow::response(500, std::string("Exception: ") + e.what());
+        else if (key.compare(0, 8, "article:") == 0 && parse_int_param(key.c_str() + 8, article_id)) {
+            loaded = load_coalesced(key, article_loader(article_id, default_ttl));
+        }
+        if (loaded.code == 200 || loaded.code == 404) {
+            snapshot.erase(key);
         }
+        return loaded;
+    };
 
-        const std::string cache_key = "article:" + std::to_string(article_id);
+    // Stale-while-revalidate: запись старше мягкого TTL отдаётся сразу, а ключ ставится
+    // в очередь фонового обновления (по одной задаче на ключ)
+    BackgroundRefresher::Options refresh_options;
+    refresh_options.workers = static_cast<std::size_t>(std::max(1L, env_long("CACHE_REFRESH_WORKERS", 2)));
+    refresh_options.max_queue = static_cast<std::size_t>(std::max(1L, env_long("CACHE_REFRESH_QUEUE", 1024)));
+    BackgroundRefresher refresher(refresh_options);
 
-        if (redis_client) {
-            try {
-                if (auto cached = redis_client->get(cache_key)) {
-                    std::string json_str = *cached;
-                    crow::response res(json_str);
-                    res.set_header("Content-Type", "application/json");
-
-                    auto end = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                    std::cout << "Request (cached) took " << duration << "ms" << std::endl;
-                    std::ofstream ofs("response_times.txt", std::ios::app);
-                    ofs << duration << "\n";
-                    return res;
+    // Проход проверки снимка: до CACHE_SNAPSHOT_REVALIDATE_BATCH ключей раз в 100 мс, по
+    // одному, чтобы не отнимать БД у запросов; ключи, к которым обращаются, проверяются
+    // вне очереди (serve_cached). Что не удалось проверить к концу прохода, сбрасывается.
+    std::unique_ptr<PeriodicTask> snapshot_revalidator;
+    if (snapshot.remaining() > 0) {
+        const std::size_t batch =
+            static_cast<std::size_t>(std::max(1L, env_long("CACHE_SNAPSHOT_REVALIDATE_BATCH", 16)));
+        snapshot_revalidator = std::make_unique<PeriodicTask>("snapshot_revalidate", std::chrono::milliseconds(100),
+            [&snapshot, &revalidate_snapshot_key, batch] {
+                if (snapshot.remaining() == 0) {
+                    return;
+                }
+                const std::vector<std::string> keys = snapshot.next_keys(batch);
+                if (keys.empty()) {
+                    snapshot.clear();
+                    return;
+                }
+                for (const std::string &key : keys) {
+                    revalidate_snapshot_key(key);
                 }
+            });
+    }
+
+    // Частоты чтения ключей: холодные ключи (реже CACHE_ADMIT_MIN_HITS обращений за окно
+    // sketch) в кеш не пишутся, горячие (от CACHE_HOT_MIN_HITS) живут в CACHE_HOT_TTL_FACTOR
+    // раз дольше. Статьи и страницы; articles_all и фрагменты списка — всегда по default_ttl.
+    HotKeyTracker::Options hot_options;
+    hot_options.sketch_width = static_cast<std::size_t>(env_long("CACHE_SKETCH_WIDTH", 65536));
+    hot_options.admit_min_hits = static_cast<std::uint32_t>(env_long("CACHE_ADMIT_MIN_HITS", 2));
+    hot_options.hot_min_hits = static_cast<std::uint32_t>(env_long("CACHE_HOT_MIN_HITS", 16));
+    hot_options.top_k = static_cast<std::size_t>(env_long("HOT_KEYS_TOP", 32));
+    HotKeyTracker hot_keys(hot_options);
+    PeriodicTask hot_keys_aging("hot_keys_age", std::chrono::milliseconds(100), [&hot_keys] { hot_keys.age_if_due(); });
+    const long hot_ttl_factor = std::max(1L, env_long("CACHE_HOT_TTL_FACTOR", 4));
+    // Чтения статей и страниц, пришедшиеся на холодные и горячие ключи
+    std::atomic<std::uint64_t> cold_reads{0};
+    std::atomic<std::uint64_t> hot_reads{0};
+
+    auto ttl_for = [&hot_keys, &cold_reads, &hot_reads, hot_ttl_factor, stale_ttl](const std::string &cache_key,
+                                                                                   CacheTtl ttl) {
+        switch (hot_keys.temperature(cache_key)) {
+            case HotKeyTracker::Temperature::Cold:
+                cold_reads.fetch_add(1, std::memory_order_relaxed);
+                ttl.store = false;
+                break;
+            case HotKeyTracker::Temperature::Hot:
+                hot_reads.fetch_add(1, std::memory_order_relaxed);
+                ttl.fresh *= hot_ttl_factor;
+                ttl.hard = ttl.fresh + std::chrono::seconds(stale_ttl);
+                break;
+            case HotKeyTracker::Temperature::Warm:
+                break;
+        }
+        return ttl;
+    };
+
+    // Снимок горячих записей: статьи и articles_all из L1, самые частые по sketch первыми,
+    // до CACHE_SNAPSHOT_MAX_MB. articles_all — последним: проход проверки доходит до него,
+    // когда фрагменты уже сверены с БД. Страницы (в ключе — поколение) и список id не
+    // пишутся. Пустой L1 (например, сразу после старта) не затирает прошлый снимок.
+    const std::size_t snapshot_max_bytes =
+        static_cast<std::size_t>(std::max(1L, env_long("CACHE_SNAPSHOT_MAX_MB", 32))) * 1024 * 1024;
+    auto write_snapshot = [&cache, &hot_keys, &snapshot_path, snapshot_max_bytes]() {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<L1Cache::Exported> exported = cache.l1_entries([](const std::string &key) {
+            return key == "articles_all" || key.compare(0, 8, "article:") == 0;
+        });
+        if (exported.empty()) {
+            return;
+        }
+        std::vector<std::pair<std::uint32_t, std::size_t>> order; // оценка частоты, индекс
+        order.reserve(exported.size());
+        for (std::size_t i = 0; i < exported.size(); ++i) {
+            const bool list = exported[i].key == "articles_all";
+            order.emplace_back(list ? 0 : hot_keys.estimate(exported[i].key) + 1, i);
+        }
+        std::sort(order.begin(), order.end(), std::greater<>());
+
+        const std::int64_t now_ms = CacheSnapshot::now_ms();
+        std::vector<CacheSnapshot::Entry> entries;
+        std::size_t bytes = 0;
+        for (const auto &[hits, i] : order) {
+            const L1Cache::Exported &entry = exported[i];
+            if (is_not_found_entry(*entry.value)) {
+                continue;
             }
-            catch (const std::exception &e) {
-                std::cerr << "Redis GET error (" << cache_key << "): " << e.what() << std::endl;
+            // Крупная запись, не влезающая в остаток, не закрывает место для следующих
+            const std::size_t entry_bytes = entry.key.size() + entry.value->size();
+            if (bytes + entry_bytes > snapshot_max_bytes) {
+                continue;
             }
+            bytes += entry_bytes;
+            entries.push_back({entry.key, *entry.value, now_ms + entry.ttl.count()});
         }
+        const std::size_t written = CacheSnapshot::write(snapshot_path, entries);
+        std::cout << "Cache snapshot: " << entries.size() << " entries, " << written << " bytes written in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start).count()
+                  << "ms" << std::endl;
+    };
+    std::unique_ptr<PeriodicTask> snapshot_writer;
+    if (!snapshot_path.empty()) {
+        snapshot_writer = std::make_unique<PeriodicTask>("cache_snapshot",
+            std::chrono::milliseconds(std::max(1L, env_long("CACHE_SNAPSHOT_INTERVAL_S", 60)) * 1000), write_snapshot);
+    }
 
-        crow::json::wvalue result;
-        try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "DB connection failed");
+    // Записи из снимка ещё не сверены с БД: обращение к такой записи ставит её проверку
+    // в очередь фонового обновления, не дожидаясь прохода проверки
+    FirstWarmHit first_warm_hit(process_start);
+    auto serve_cached = [&refresher, &load_coalesced, &revalidate_snapshot_key, &first_warm_hit](
+                            const crow::request &req, const std::string &cache_key, const CacheLookup &cached,
+                            const auto &load) {
+        first_warm_hit.hit(served_from(cached.source));
+        if (is_not_found_entry(*cached.value)) {
+            return crow::response(404, "Article not found");
+        }
+        const EncodedView view = decode_entry(*cached.value);
+        if (cached.source == CacheSource::Snapshot) {
+            refresher.schedule(cache_key, [&revalidate_snapshot_key, cache_key]() {
+                return revalidate_snapshot_key(cache_key).code != 503;
+            });
+        }
+        else if (is_stale(view)) {
+            refresher.schedule(cache_key, [&load_coalesced, cache_key, load]() {
+                return load_coalesced(cache_key, load).code != 503;
+            });
+        }
+        return make_cached_response(req, view);
+    };
+
+    // Фрагменты выборок (?ids, поиск) кешируются, как /article/{id}: по частоте ключа
+    auto fragment_ttl = [&ttl_for, default_ttl](int id) { return ttl_for("article:" + std::to_string(id), default_ttl); };
+
+    // Устаревшие фрагменты выборок отданы как есть и обновляются в фоне
+    auto refresh_fragments = [&refresher, &load_coalesced, &article_loader, &fragment_ttl](const std::vector<int> &stale) {
+        for (int id : stale) {
+            const std::string key = "article:" + std::to_string(id);
+            const CacheTtl ttl = fragment_ttl(id);
+            if (!ttl.store) {
+                continue; // холодный: обновлённое значение в кеш всё равно не попадёт
+            }
+            refresher.schedule(key, [&load_coalesced, &article_loader, key, id, ttl]() {
+                return load_coalesced(key, article_loader(id, ttl)).code != 503;
+            });
+        }
+    };
+
+    // GET /articles: все статьи с комментариями, страница ?limit=N[&after_id=M] или
+    // выборка ?ids=1,2,3
+    CROW_ROUTE(app, "/articles")([&cache, &load_coalesced, &serve_cached, &list_loader, &page_loader,
+                                  &fragment_ttl, &refresh_fragments, &latency, &tracer, &db_pool, &db_executor, &encoding, &hot_keys,
+                                  &ttl_for, &first_warm_hit,
+                                  read_mode, default_ttl, max_page_size, max_batch_ids](const crow::request &req) {
+        if (const char *ids_param = req.url_params.get("ids")) {
+            RequestTimer timer(latency, tracer, Route::ArticlesBatch, req);
+            std::vector<int> requested;
+            if (!parse_ids_param(ids_param, requested) || requested.size() > max_batch_ids) {
+                return timer.done(crow::response(400, "Invalid ids"), ServedFrom::None);
             }
-            try {
-                conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
+            // Повторы запрашиваются один раз, но в ответе стоят на своих местах
+            std::vector<int> ids = requested;
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            for (int id : ids) {
+                hot_keys.record("article:" + std::to_string(id));
             }
-            catch (...) {}
-            pqxx::work tx(conn);
 
-            pqxx::result art = tx.exec_prepared("get_article", article_id);
-            if (art.empty()) {
-                return crow::response(404, "Article not found");
+            // Попадания — одним MGET в потоке Crow, промахи — одним запросом в db_executor
+            LoadResult failed;
+            ArticleFragments fragments = load_article_fragments(
+                cache, ids, fragment_ttl, encoding, false, [&](const std::vector<int> &missing) {
+                    return fetch_fragments_for_request(db_executor, db_pool, missing, read_mode, "/articles?ids",
+                                                       failed);
+                });
+            if (failed.code != 200) {
+                return timer.done(make_response(req, failed), ServedFrom::Db);
             }
-            const auto &row = art[0];
-            result["id"] = row[0].as<int>();
-            result["title"] = row[1].c_str();
-            result["content"] = row[2].c_str();
+            refresh_fragments(fragments.stale);
 
-            pqxx::result comments = tx.exec_prepared("get_comments", article_id);
-            std::vector<crow::json::wvalue> comments_list;
-            for (const auto &c : comments) {
-                crow::json::wvalue cm;
-                cm["id"] = c[0].as<int>();
-                cm["content"] = c[1].c_str();
-                comments_list.push_back(cm);
+            ScratchBuffer body;
+            std::optional<StageSpan> serialize(Stage::Serialize);
+            JsonWriter json(body.str());
+            json.begin_object().key("articles").begin_array();
+            std::vector<int> not_found;
+            for (int id : requested) {
+                const std::size_t i = std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+                const std::string_view article = fragments.json(i);
+                if (article.empty()) {
+                    json.null();
+                    not_found.push_back(id);
+                }
+                else {
+                    json.raw(article);
+                }
             }
-            result["comments"] = std::move(comments_list);
+            json.end_array().key("not_found").begin_array();
+            for (int id : not_found) {
+                json.value(id);
+            }
+            json.end_array().end_object();
+            serialize.reset();
 
-            tx.commit();
+            crow::response res{body.str()};
+            res.set_header("Content-Type", "application/json");
+            const ServedFrom from = fragments_served_from(fragments);
+            if (from != ServedFrom::Db) {
+                first_warm_hit.hit(from);
+            }
+            return timer.done(std::move(res), from);
         }
-        catch (const std::exception &e) {
-            std::cerr << "Exception in /article/random DB fetch: " << e.what() << std::endl;
-            return crow::response(500, std::string("Exception: ") + e.what());
+
+        const char *limit_param = req.url_params.get("limit");
+        if (limit_param) {
+            RequestTimer timer(latency, tracer, Route::ArticlesPage, req);
+
+            // Keyset-пагинация: страница определяется последним id предыдущей страницы
+            int limit = 0;
+            int after_id = 0;
+            if (!parse_int_param(limit_param, limit) || limit == 0 || limit > max_page_size) {
+                return timer.done(crow::response(400, "Invalid limit"), ServedFrom::None);
+            }
+            const char *after_param = req.url_params.get("after_id");
+            if (after_param && !parse_int_param(after_param, after_id)) {
+                return timer.done(crow::response(400, "Invalid after_id"), ServedFrom::None);
+            }
+            const std::string cache_key = "articles:page:" + cache.generation(kPagesGeneration) + ":" +
+                                          std::to_string(after_id) + ":" + std::to_string(limit);
+            hot_keys.record(cache_key);
+            const CacheTtl ttl = ttl_for(cache_key, default_ttl);
+            const auto load = page_loader(cache_key, after_id, limit, ttl);
+
+            const CacheLookup cached = cache.get(cache_key);
+            if (cached.value) {
+                return timer.done(serve_cached(req, cache_key, cached, load), served_from(cached.source));
+            }
+            return timer.done(make_response(req, load_coalesced(cache_key, load, ttl.store)), ServedFrom::Db);
         }
 
-        std::string json_str;
-        try {
-            json_str = result.dump();
+        RequestTimer timer(latency, tracer, Route::Articles, req);
+        const std::string cache_key = "articles_all";
+        hot_keys.record(cache_key);
+
+        // 1) Попытка взять из кеша (L1, затем Redis); устаревшая запись обновляется в фоне
+        const CacheLookup cached = cache.get(cache_key);
+        if (cached.value) {
+            return timer.done(serve_cached(req, cache_key, cached, list_loader), served_from(cached.source));
         }
-        catch (const std::exception &e) {
-            std::cerr << "JSON dump error in /article/random: " << e.what() << std::endl;
-            return crow::response(500, "JSON serialization error");
+
+        // 2) Промах: список пересобирает один запрос, остальные ждут его результат
+        return timer.done(make_response(req, load_coalesced(cache_key, list_loader)), ServedFrom::Db);
+    });
+
+    // GET /articles/search?q=...[&limit=N][&after_id=M]: статьи, в которых есть все слова
+    // запроса, по возрастанию id. Id берутся из индекса, сами статьи — как в выборке
+    // ?ids: фрагменты article:{id} из кеша, недостающие одним запросом к БД.
+    CROW_ROUTE(app, "/articles/search")([&cache, &search_index, &fragment_ttl, &refresh_fragments, &latency, &tracer, &db_pool,
+                                         &db_executor, &encoding, &first_warm_hit, search_enabled, read_mode, default_ttl,
+                                         max_batch_ids](const crow::request &req) {
+        RequestTimer timer(latency, tracer, Route::ArticlesSearch, req);
+        if (!search_enabled) {
+            return timer.done(crow::response(404, "Search is disabled"), ServedFrom::None);
+        }
+        const char *query = req.url_params.get("q");
+        const std::vector<std::string> terms = SearchIndex::query_terms(query ? query : "");
+        if (terms.empty()) {
+            return timer.done(crow::response(400, "Invalid q"), ServedFrom::None);
+        }
+        int limit = 20;
+        int after_id = 0;
+        const char *limit_param = req.url_params.get("limit");
+        if (limit_param && (!parse_int_param(limit_param, limit) || limit == 0 ||
+                            static_cast<std::size_t>(limit) > max_batch_ids)) {
+            return timer.done(crow::response(400, "Invalid limit"), ServedFrom::None);
+        }
+        const char *after_param = req.url_params.get("after_id");
+        if (after_param && !parse_int_param(after_param, after_id)) {
+            return timer.done(crow::response(400, "Invalid after_id"), ServedFrom::None);
         }
+        if (!search_index.ready()) {
+            return timer.done(crow::response(503, "Search index is not built yet"), ServedFrom::None);
+        }
+
+        const SearchIndex::Page page = search_index.search(terms, after_id, static_cast<std::size_t>(limit));
+        LoadResult failed;
+        ArticleFragments fragments = load_article_fragments(
+            cache, page.ids, fragment_ttl, encoding, false, [&](const std::vector<int> &missing) {
+                return fetch_fragments_for_request(db_executor, db_pool, missing, read_mode, "/articles/search",
+                                                   failed);
+            });
+        if (failed.code != 200) {
+            return timer.done(make_response(req, failed), ServedFrom::Db);
+        }
+        refresh_fragments(fragments.stale);
 
-        if (redis_client) {
-            try {
-                redis_client->set(cache_key, json_str);
-                redis_client->expire(cache_key, 110);
+        ScratchBuffer body;
+        std::optional<StageSpan> serialize(Stage::Serialize);
+        JsonWriter json(body.str());
+        json.begin_object().key("articles").begin_array();
+        for (std::size_t i = 0; i < page.ids.size(); ++i) {
+            // Статья могла быть удалена после обновления индекса
+            const std::string_view article = fragments.json(i);
+            if (!article.empty()) {
+                json.raw(article);
             }
-            catch (const std::exception &e) {
-                std::cerr << "Redis SET error (" << cache_key << "): " << e.what() << std::endl;
+        }
+        json.end_array().key("total").value(static_cast<long long>(page.total)).key("next_after_id");
+        if (page.more) {
+            json.value(page.ids.back());
+        }
+        else {
+            json.null();
+        }
+        json.end_object();
+        serialize.reset();
+
+        crow::response res{body.str()};
+        res.set_header("Content-Type", "application/json");
+        const ServedFrom from = fragments_served_from(fragments);
+        if (from != ServedFrom::Db && !page.ids.empty()) {
+            first_warm_hit.hit(from);
+        }
+        return timer.done(std::move(res), from);
+    });
+
+    // GET /article/<id>
+    CROW_ROUTE(app, "/article/<int>")([&cache, &load_coalesced, &serve_cached, &article_loader, &latency, &tracer,
+                                       &hot_keys, &ttl_for, default_ttl](const crow::request &req, int article_id) {
+        RequestTimer timer(latency, tracer, Route::Article, req);
+        const std::string cache_key = "article:" + std::to_string(article_id);
+        hot_keys.record(cache_key);
+        const CacheTtl ttl = ttl_for(cache_key, default_ttl);
+        const auto load = article_loader(article_id, ttl);
+
+        // 1) Попытка взять из кеша (L1, затем Redis); устаревшая запись обновляется в фоне
+        const CacheLookup cached = cache.get(cache_key);
+        if (cached.value) {
+            return timer.done(serve_cached(req, cache_key, cached, load), served_from(cached.source));
+        }
+
+        // 2) Промах: статью пересобирает один запрос, остальные ждут его результат
+        return timer.done(make_response(req, load_coalesced(cache_key, load, ttl.store)), ServedFrom::Db);
+    });
+
+    CROW_ROUTE(app, "/article/random")([&cache, &load_coalesced, &serve_cached, &article_loader, &article_ids,
+                                        &latency, &tracer, &hot_keys, &ttl_for, random_ttl](const crow::request &req) {
+        RequestTimer timer(latency, tracer, Route::ArticleRandom, req);
+
+        // Случайный id берётся из индекса в памяти, без обращения к БД
+        const std::optional<int> random_id = article_ids.random();
+        if (!random_id) {
+            return timer.done(crow::response(404, "No articles available"), ServedFrom::None);
+        }
+        const int article_id = *random_id;
+
+        const std::string cache_key = "article:" + std::to_string(article_id);
+        hot_keys.record(cache_key);
+        const CacheTtl ttl = ttl_for(cache_key, random_ttl);
+        const auto load = article_loader(article_id, ttl);
+
+        const CacheLookup cached = cache.get(cache_key);
+        if (cached.value) {
+            if (is_not_found_entry(*cached.value)) {
+                article_ids.remove(article_id);
             }
+            return timer.done(serve_cached(req, cache_key, cached, load), served_from(cached.source));
         }
 
-        crow::response res(json_str);
+        const LoadResult loaded = load_coalesced(cache_key, load, ttl.store);
+        if (loaded.code == 404) {
+            // Статью удалили после последней сверки индекса
+            article_ids.remove(article_id);
+        }
+        return timer.done(make_response(req, loaded), ServedFrom::Db);
+    });
+
+    // POST /article: {"title": "...", "content": "..."} -> 201 {"id": ...}
+    CROW_ROUTE(app, "/article").methods(crow::HTTPMethod::Post)([&writes, &latency, &tracer,
+                                                                  &executor_options](const crow::request &req) {
+        RequestTimer timer(latency, tracer, Route::CreateArticle, req);
+        const crow::json::rvalue body = crow::json::load(req.body);
+        std::string title, content;
+        if (!body || !json_string_field(body, "title", title) || !json_string_field(body, "content", content)) {
+            return timer.done(crow::response(400, "Expected JSON {\"title\": ..., \"content\": ...}"), ServedFrom::None);
+        }
+        return timer.done(await_write(writes.add_article(std::move(title), std::move(content)), executor_options.deadline),
+                          ServedFrom::Db);
+    });
+
+    // POST /comment: {"article_id": N, "content": "..."} -> 201 {"id": ...}
+    CROW_ROUTE(app, "/comment").methods(crow::HTTPMethod::Post)([&writes, &latency, &tracer,
+                                                                  &executor_options](const crow::request &req) {
+        RequestTimer timer(latency, tracer, Route::CreateComment, req);
+        const crow::json::rvalue body = crow::json::load(req.body);
+        std::string content;
+        if (!body || !body.has("article_id") || body["article_id"].t() != crow::json::type::Number ||
+            body["article_id"].i() <= 0 || body["article_id"].i() > std::numeric_limits<int>::max() ||
+            !json_string_field(body, "content", content)) {
+            return timer.done(crow::response(400, "Expected JSON {\"article_id\": ..., \"content\": ...}"),
+                              ServedFrom::None);
+        }
+        const int article_id = static_cast<int>(body["article_id"].i());
+        return timer.done(await_write(writes.add_comment(article_id, std::move(content)), executor_options.deadline),
+                          ServedFrom::Db);
+    });
+
+    // Состояние пула соединений: занятость и время ожидания выдачи
+    CROW_ROUTE(app, "/stats/db_pool")([&db_pool]() {
+        const DbPool::Stats s = db_pool.stats();
+        crow::json::wvalue result;
+        result["size"] = s.size;
+        result["open"] = s.open;
+        result["in_use"] = s.in_use;
+        result["idle"] = s.idle;
+        result["waiting"] = s.waiting;
+        result["acquired"] = s.acquired;
+        result["timeouts"] = s.timeouts;
+        result["created"] = s.created;
+        result["replaced"] = s.replaced;
+        result["wait_us_total"] = s.wait_us_total;
+        result["wait_us_max"] = s.wait_us_max;
+        return crow::response(result);
+    });
+
+    // Самые частые ключи по оценке sketch: GET /stats/hot_keys[?k=N]
+    CROW_ROUTE(app, "/stats/hot_keys")([&hot_keys, &cold_reads, &hot_reads](const crow::request &req) {
+        int k = static_cast<int>(hot_keys.options().top_k);
+        if (const char *k_param = req.url_params.get("k")) {
+            if (!parse_int_param(k_param, k)) {
+                return crow::response(400, "Invalid k");
+            }
+        }
+        std::string body;
+        JsonWriter json(body);
+        json.begin_object();
+        json.key("sketch_width").value(static_cast<long long>(hot_keys.sketch().width()));
+        json.key("sample_size").value(static_cast<long long>(hot_keys.sketch().sample_size()));
+        json.key("resets").value(static_cast<long long>(hot_keys.sketch().resets()));
+        json.key("admit_min_hits").value(static_cast<long long>(hot_keys.options().admit_min_hits));
+        json.key("hot_min_hits").value(static_cast<long long>(hot_keys.options().hot_min_hits));
+        json.key("cold_reads").value(static_cast<long long>(cold_reads.load(std::memory_order_relaxed)));
+        json.key("hot_reads").value(static_cast<long long>(hot_reads.load(std::memory_order_relaxed)));
+        json.key("keys").begin_array();
+        for (const auto &hot : hot_keys.top(static_cast<std::size_t>(k))) {
+            json.begin_object();
+            json.key("key").value(hot.key);
+            json.key("hits").value(static_cast<long long>(hot.hits));
+            json.end_object();
+        }
+        json.end_array().end_object();
+        crow::response res{std::move(body)};
         res.set_header("Content-Type", "application/json");
+        return res;
+    });
 
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-        std::cout << "Request (DB) took " << duration << "ms" << std::endl;
-        std::ofstream ofs("response_times.txt", std::ios::app);
-        ofs << duration << "\n";
+    // Исполнитель запросов к БД: очередь, отказы, ожидание в очереди
+    CROW_ROUTE(app, "/stats/db_executor")([&db_executor, &executor_options]() {
+        const DbExecutor::Stats s = db_executor.stats();
+        crow::json::wvalue result;
+        result["threads"] = executor_options.threads;
+        result["max_queue"] = executor_options.max_queue;
+        result["deadline_ms"] = static_cast<std::int64_t>(executor_options.deadline.count());
+        result["queued"] = s.queued;
+        result["running"] = s.running;
+        result["submitted"] = s.submitted;
+        result["completed"] = s.completed;
+        result["rejected"] = s.rejected;
+        result["expired"] = s.expired;
+        result["timed_out"] = s.timed_out;
+        result["wait_us_total"] = s.wait_us_total;
+        result["wait_us_max"] = s.wait_us_max;
+        return crow::response(result);
+    });
+
+    // Групповая запись: число пачек и записей, размер наибольшей пачки, очередь
+    CROW_ROUTE(app, "/stats/writes")([&writes]() {
+        const WriteBatcher::Stats s = writes.stats();
+        crow::json::wvalue result;
+        result["batches"] = s.batches;
+        result["writes"] = s.writes;
+        result["max_batch_seen"] = s.max_batch_seen;
+        result["failed_batches"] = s.failed_batches;
+        result["in_doubt"] = s.in_doubt;
+        result["rejected"] = s.rejected;
+        result["pending"] = s.pending;
+        return crow::response(result);
+    });
+
+    // Поисковый индекс: статьи, термы, элементы списков и оценка занимаемой памяти
+    CROW_ROUTE(app, "/stats/search_index")([&search_index, search_enabled, search_threads]() {
+        const SearchIndex::Stats s = search_index.stats();
+        crow::json::wvalue result;
+        result["enabled"] = search_enabled;
+        result["ready"] = search_index.ready();
+        result["threads"] = search_threads;
+        result["documents"] = s.documents;
+        result["terms"] = s.terms;
+        result["postings"] = s.postings;
+        result["bytes"] = s.bytes;
+        result["queries"] = s.queries;
+        result["updates"] = s.updates;
+        result["rebuilds"] = s.rebuilds;
+        return crow::response(result);
+    });
+
+    // Попадания по уровням кеша и состояние L1
+    CROW_ROUTE(app, "/stats/cache")([&cache, &misses, &miss_lock, &refresher, &db_changes, &redis_breaker, &snapshot,
+                                     &snapshot_path, &first_warm_hit]() {
+        const TieredCache::Stats s = cache.stats();
+        crow::json::wvalue result;
+        result["l1_hits"] = s.l1_hits;
+        result["l2_hits"] = s.l2_hits;
+        result["snapshot_hits"] = s.snapshot_hits;
+        result["misses"] = s.misses;
+        result["invalidations_sent"] = s.invalidations_sent;
+        result["invalidations_received"] = s.invalidations_received;
+        result["invalidations_skipped"] = s.invalidations_skipped;
+        result["invalidations_replayed"] = s.invalidations_replayed;
+        result["invalidations_lost"] = s.invalidations_lost;
+        result["fills_skipped"] = s.fills_skipped;
+        result["l1"]["entries"] = s.l1.entries;
+        result["l1"]["bytes"] = s.l1.bytes;
+        result["l1"]["max_bytes"] = s.l1.max_bytes;
+        result["l1"]["evictions"] = s.l1.evictions;
+        result["l1"]["expired"] = s.l1.expired;
+        result["l1"]["rejected"] = s.l1.rejected;
+
+        if (!snapshot_path.empty()) {
+            const CacheSnapshot::Stats snap = snapshot.stats();
+            result["snapshot"]["file"] = snapshot_path;
+            result["snapshot"]["loaded"] = snap.loaded;
+            result["snapshot"]["remaining"] = snap.remaining;
+            result["snapshot"]["hits"] = snap.hits;
+            result["snapshot"]["expired"] = snap.expired;
+            result["snapshot"]["corrupt"] = snap.corrupt;
+            result["snapshot"]["load_us"] = snap.load_us;
+        }
+        // Старт процесса -> первый ответ из кеша (-1 — ещё не было)
+        result["first_warm_hit_us"] = first_warm_hit.elapsed_us();
+        if (first_warm_hit.elapsed_us() >= 0) {
+            result["first_warm_hit_from"] = kServedFromNames[static_cast<std::size_t>(first_warm_hit.from())];
+        }
+
+        if (redis_breaker) {
+            const auto breaker = redis_breaker->stats();
+            result["redis_breaker"]["state"] = RedisBreaker::state_name(breaker.state);
+            result["redis_breaker"]["failures"] = breaker.failures;
+            result["redis_breaker"]["opened"] = breaker.opened;
+            result["redis_breaker"]["skipped"] = breaker.skipped;
+            result["redis_breaker"]["probes"] = breaker.probes;
+            result["redis_breaker"]["probe_failures"] = breaker.probe_failures;
+            result["redis_breaker"]["suppressed_logs"] = breaker.suppressed_logs;
+        }
+
+        const auto flight = misses.stats();
+        result["single_flight"]["leaders"] = flight.leaders;
+        result["single_flight"]["coalesced"] = flight.coalesced;
+        result["single_flight"]["wait_timeouts"] = flight.wait_timeouts;
+
+        const auto lock = miss_lock.stats();
+        result["miss_lock"]["acquired"] = lock.acquired;
+        result["miss_lock"]["contended"] = lock.contended;
+        result["miss_lock"]["served_after_wait"] = lock.served_after_wait;
+        result["miss_lock"]["timeouts"] = lock.timeouts;
+        result["miss_lock"]["released_empty"] = lock.released_empty;
+        result["miss_lock"]["errors"] = lock.errors;
+
+        const auto refresh = refresher.stats();
+        result["refresh"]["scheduled"] = refresh.scheduled;
+        result["refresh"]["deduplicated"] = refresh.deduplicated;
+        result["refresh"]["dropped"] = refresh.dropped;
+        result["refresh"]["completed"] = refresh.completed;
+        result["refresh"]["shed"] = refresh.shed;
+        result["refresh"]["failed"] = refresh.failed;
+        result["refresh"]["queued"] = refresh.queued;
+
+        if (db_changes) {
+            const auto notify = db_changes->stats();
+            result["db_notify"]["connected"] = notify.connected;
+            result["db_notify"]["notifications"] = notify.notifications;
+            result["db_notify"]["malformed"] = notify.malformed;
+            result["db_notify"]["batches"] = notify.batches;
+            result["db_notify"]["reconnects"] = notify.reconnects;
+            result["db_notify"]["resyncs"] = notify.resyncs;
+        }
+        return crow::response(result);
+    });
+
+    // Метрики в формате Prometheus: задержки по маршрутам, пул соединений и кеш
+    CROW_ROUTE(app, "/metrics")([&latency, &tracer, &redis_latency, &db_queue_wait, &db_pool, &db_executor, &cache,
+                                 &cold_reads, &hot_reads, &redis_breaker, &snapshot, &first_warm_hit,
+                                 &search_index]() {
+        std::string out;
+        out.reserve(64 * 1024);
+        latency.write_prometheus(out);
+        tracer.stages().write_prometheus(out);
+        redis_latency.write_prometheus(out);
+        db_queue_wait.write_prometheus(out);
+
+        auto metric = [&out](const char *type, const char *name, unsigned long long value) {
+            out += "# TYPE ";
+            out += name;
+            out += ' ';
+            out += type;
+            out += '\n';
+            out += name;
+            out += ' ';
+            out += std::to_string(value);
+            out += '\n';
+        };
+        const DbPool::Stats pool = db_pool.stats();
+        metric("gauge", "db_pool_in_use", pool.in_use);
+        metric("gauge", "db_pool_waiting", pool.waiting);
+        metric("counter", "db_pool_timeouts_total", pool.timeouts);
+        metric("counter", "db_pool_wait_microseconds_total", pool.wait_us_total);
+        metric("counter", "http_slow_requests_total", tracer.slow_requests());
+
+        const DbExecutor::Stats executor = db_executor.stats();
+        metric("gauge", "db_executor_queue_depth", executor.queued);
+        metric("gauge", "db_executor_running", executor.running);
+        metric("counter", "db_executor_rejected_total", executor.rejected);
+        metric("counter", "db_executor_expired_total", executor.expired);
+        metric("counter", "db_executor_timed_out_total", executor.timed_out);
+
+        const TieredCache::Stats c = cache.stats();
+        metric("counter", "cache_l1_hits_total", c.l1_hits);
+        metric("counter", "cache_redis_hits_total", c.l2_hits);
+        metric("counter", "cache_snapshot_hits_total", c.snapshot_hits);
+        metric("gauge", "cache_snapshot_remaining", snapshot.remaining());
+        if (first_warm_hit.elapsed_us() >= 0) {
+            metric("gauge", "startup_first_warm_hit_microseconds",
+                   static_cast<unsigned long long>(first_warm_hit.elapsed_us()));
+        }
+        metric("counter", "cache_misses_total", c.misses);
+        metric("gauge", "cache_l1_bytes", c.l1.bytes);
+        metric("counter", "cache_cold_reads_total", cold_reads.load(std::memory_order_relaxed));
+        metric("counter", "cache_hot_reads_total", hot_reads.load(std::memory_order_relaxed));
+        const SearchIndex::Stats search = search_index.stats();
+        metric("gauge", "search_index_documents", search.documents);
+        metric("gauge", "search_index_terms", search.terms);
+        metric("gauge", "search_index_postings", search.postings);
+        metric("gauge", "search_index_bytes", search.bytes);
+        metric("counter", "search_index_queries_total", search.queries);
+        if (redis_breaker) {
+            const RedisBreaker::Stats breaker = redis_breaker->stats();
+            metric("gauge", "redis_breaker_open", breaker.state != RedisBreaker::State::Closed);
+            metric("counter", "redis_breaker_opened_total", breaker.opened);
+            metric("counter", "redis_breaker_skipped_total", breaker.skipped);
+            metric("counter", "redis_errors_total", breaker.failures);
+        }
+
+        crow::response res{std::move(out)};
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
         return res;
     });
 
-    app.port(18080).multithreaded().run();
+    // Прогрев до приёма запросов (порт открывается только после него): articles_all и
+    // CACHE_WARMUP_ARTICLES самых обсуждаемых статей. Что уже есть в Redis, попадает в L1
+    // одним MGET, остальное пересобирается из БД. Со снимком кеша прогрев не нужен: его
+    // записи отдаются сразу, а проверяются в фоне.
+    if (snapshot.remaining() > 0) {
+        std::cout << "Cache warm-up: skipped, " << snapshot.remaining() << " entries from snapshot" << std::endl;
+    }
+    else if (env_string("CACHE_WARMUP", "on") == "on") {
+        const long warmup_articles = std::max(0L, env_long("CACHE_WARMUP_ARTICLES", 100));
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<int> hot_ids;
+        try {
+            auto conn = db_pool.acquire();
+            ReadTransaction tx(*conn);
+            hot_ids = fetch_hot_article_ids(tx, static_cast<int>(warmup_articles));
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Cache warm-up: failed to load hot articles: " << e.what() << std::endl;
+        }
+        std::vector<std::string> keys = {"articles_all"};
+        for (int id : hot_ids) {
+            keys.push_back("article:" + std::to_string(id));
+        }
+        const std::vector<CacheLookup> cached = cache.get_many(keys);
+        std::size_t rebuilt = 0;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            // Сборка articles_all из фрагментов уже могла положить статью в кеш
+            if (cached[i].value || (i > 0 && compose_list && cache.get(keys[i]).value)) {
+                continue;
+            }
+            ++rebuilt;
+            if (i == 0) {
+                load_coalesced(keys[i], list_loader);
+            }
+            else {
+                load_coalesced(keys[i], article_loader(hot_ids[i - 1], default_ttl));
+            }
+        }
+        std::cout << "Cache warm-up: " << keys.size() << " keys, " << rebuilt << " rebuilt from DB in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start).count()
+                  << "ms" << std::endl;
+        // Попадания и промахи прогрева — не трафик: /stats/cache считает с нуля
+        cache.reset_hit_stats();
+    }
+
+    const auto port = static_cast<std::uint16_t>(env_long("SERVER_PORT", 18080));
+    app.port(port).concurrency(server_threads).run();
+
+    // Последний снимок при остановке; периодическая запись останавливается первой, чтобы
+    // не писать тот же файл одновременно
+    if (snapshot_writer) {
+        snapshot_writer.reset();
+        try {
+            write_snapshot();
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Cache snapshot: final write failed: " << e.what() << std::endl;
+        }
+    }
     return 0;
 }
\ No newline at end of file
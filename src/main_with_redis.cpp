@@ -7,15 +7,33 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "config.h"
+#include "db_pool.h"
 
 using namespace sw::redis;
 
+// Подготовленные запросы регистрируются один раз при создании соединения пула
+static void prepare_statements(pqxx::connection &conn) {
+    conn.prepare("get_random_id", "SELECT id FROM articles ORDER BY RANDOM() LIMIT 1");
+    conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
+    conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
+}
+
 int main() {
     crow::SimpleApp app;
 
-    // Строка подключения к PostgreSQL. Скорректируйте под своё окружение:
-    // например: "dbname=blogdb user=bloguser host=127.0.0.1 port=5432 password=..."
-    const std::string conn_str = "dbname=blogdb user=bloguser";
+    // Строка подключения к PostgreSQL берётся из DB_CONN, например:
+    // "dbname=blogdb user=bloguser host=127.0.0.1 port=5432 password=..."
+    // Пул соединений размером с число рабочих потоков Crow.
+    const unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    DbPool::Options pool_options;
+    pool_options.conn_str = env_string("DB_CONN", "dbname=blogdb user=bloguser");
+    pool_options.size = static_cast<std::size_t>(std::max(1L, env_long("DB_POOL_SIZE", workers)));
+    pool_options.checkout_timeout = std::chrono::milliseconds(env_long("DB_POOL_TIMEOUT_MS", 1000));
+    DbPool db_pool(pool_options, prepare_statements);
 
     // Инициализация клиента Valkey/Redis: используем уникальный указатель
     std::unique_ptr<Redis> redis_client;
@@ -29,7 +47,7 @@ int main() {
     }
 
     // GET /articles
-    CROW_ROUTE(app, "/articles")([&conn_str, &redis_client]() {
+    CROW_ROUTE(app, "/articles")([&db_pool, &redis_client]() {
         const std::string cache_key = "articles_all";
 
         // 1) Попытка взять из кеша
@@ -53,16 +71,8 @@ int main() {
         crow::json::wvalue result;
         std::vector<crow::json::wvalue> articles_list;
         try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "Failed to open DB connection");
-            }
-            // Подготовка запроса комментариев
-            try {
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
-            }
-            catch (...) {}
-            pqxx::work tx(conn);
+            auto conn = db_pool.acquire();
+            pqxx::work tx(*conn);
 
             pqxx::result articles = tx.exec("SELECT id, title, content FROM articles");
             for (const auto &row : articles) {
@@ -87,6 +97,9 @@ int main() {
             }
             tx.commit();
         }
+        catch (const DbPoolTimeout &) {
+            return crow::response(503, "DB pool exhausted");
+        }
         catch (const std::exception &e) {
             std::cerr << "Exception in /articles handler: " << e.what() << std::endl;
             return crow::response(500, std::string("Exception: ") + e.what());
@@ -121,7 +134,7 @@ int main() {
     });
 
     // GET /article/<id>
-    CROW_ROUTE(app, "/article/<int>")([&conn_str, &redis_client](int article_id) {
+    CROW_ROUTE(app, "/article/<int>")([&db_pool, &redis_client](int article_id) {
         const std::string cache_key = "article:" + std::to_string(article_id);
 
         // 1) Попытка взять из кеша
@@ -143,16 +156,8 @@ int main() {
         // 2) Запрос к БД
         crow::json::wvalue result;
         try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "DB connection failed");
-            }
-            try {
-                conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
-            }
-            catch (...) {}
-            pqxx::work tx(conn);
+            auto conn = db_pool.acquire();
+            pqxx::work tx(*conn);
 
             pqxx::result art = tx.exec_prepared("get_article", article_id);
             if (art.empty()) {
@@ -175,6 +180,9 @@ int main() {
 
             tx.commit();
         }
+        catch (const DbPoolTimeout &) {
+            return crow::response(503, "DB pool exhausted");
+        }
         catch (const std::exception &e) {
             std::cerr << "Exception in /article handler: " << e.what() << std::endl;
             return crow::response(500, std::string("Exception: ") + e.what());
@@ -207,23 +215,12 @@ int main() {
     });
 
     // GET /article/random с кэшированием конкретной статьи
-    CROW_ROUTE(app, "/article/random")([&conn_str, &redis_client]() {
+    CROW_ROUTE(app, "/article/random")([&db_pool, &redis_client]() {
         // 1) Открываем соединение к БД, получаем случайный id
         int article_id = -1;
         try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "DB connection failed");
-            }
-            // Подготовка запроса на случайный id
-            try {
-                // Если уже подготовлено ранее, catch проигнорит повтор
-                conn.prepare("get_random_id", "SELECT id FROM articles ORDER BY RANDOM() LIMIT 1");
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
-                conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
-            }
-            catch (...) {}
-            pqxx::work tx(conn);
+            auto conn = db_pool.acquire();
+            pqxx::work tx(*conn);
 
             pqxx::result rnd = tx.exec_prepared("get_random_id");
             if (rnd.empty()) {
@@ -233,6 +230,9 @@ int main() {
             article_id = rnd[0][0].as<int>();
             tx.commit();
         }
+        catch (const DbPoolTimeout &) {
+            return crow::response(503, "DB pool exhausted");
+        }
         catch (const std::exception &e) {
             std::cerr << "Exception selecting random id: " << e.what() << std::endl;
             return crow::response(500, std::string("Exception: ") + e.what());
@@ -261,17 +261,8 @@ int main() {
         // 4) Если не в кеше, запрашиваем из БД статью и комментарии
         crow::json::wvalue result;
         try {
-            pqxx::connection conn(conn_str);
-            if (!conn.is_open()) {
-                return crow::response(500, "DB connection failed");
-            }
-            // Подготовка запросов (если не подготовлены ранее)
-            try {
-                conn.prepare("get_article", "SELECT id, title, content FROM articles WHERE id = $1");
-                conn.prepare("get_comments", "SELECT id, content FROM comments WHERE article_id = $1");
-            }
-            catch (...) {}
-            pqxx::work tx(conn);
+            auto conn = db_pool.acquire();
+            pqxx::work tx(*conn);
 
             pqxx::result art = tx.exec_prepared("get_article", article_id);
             if (art.empty()) {
@@ -295,6 +286,9 @@ int main() {
 
             tx.commit();
         }
+        catch (const DbPoolTimeout &) {
+            return crow::response(503, "DB pool exhausted");
+        }
         catch (const std::exception &e) {
             std::cerr << "Exception in /article/random DB fetch: " << e.what() << std::endl;
             return crow::response(500, std::string("Exception: ") + e.what());
@@ -331,7 +325,7 @@ int main() {
 
 
     // Запуск сервера на порту 18080
-    app.port(18080).multithreaded().run();
+    app.port(18080).concurrency(workers).run();
     return 0;
 }
 
@@ -0,0 +1,276 @@
+// src/metrics.h
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Гистограмма задержек в стиле HDR: значения в микросекундах, до 64 мкс — точно,
+// дальше на каждую степень двойки по 32 корзины (относительная погрешность ~3%).
+// Верхняя граница — 2^36 мкс (~19 ч), большие значения попадают в последнюю корзину.
+struct LatencyBuckets {
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;     // 32
+    static constexpr int kLinear = 2 * kSubBuckets;             // 0..63 — по одной корзине
+    static constexpr int kMaxMsb = 35;
+    static constexpr int kCount = kLinear + (kMaxMsb - kSubBucketBits) * kSubBuckets;
+
+    static int index_of(std::uint64_t us) {
+        if (us < static_cast<std::uint64_t>(kLinear)) {
+            return static_cast<int>(us);
+        }
+        int msb = 63 - __builtin_clzll(us);
+        if (msb > kMaxMsb) {
+            return kCount - 1;
+        }
+        int shift = msb - kSubBucketBits;
+        int sub = static_cast<int>(us >> shift) - kSubBuckets;
+        return kLinear + (msb - kSubBucketBits - 1) * kSubBuckets + sub;
+    }
+
+    // Верхняя граница значений корзины (для оценки перцентилей)
+    static std::uint64_t upper_bound_of(int index) {
+        if (index < kLinear) {
+            return static_cast<std::uint64_t>(index);
+        }
+        int rel = index - kLinear;
+        int msb = rel / kSubBuckets + kSubBucketBits + 1;
+        int sub = rel % kSubBuckets;
+        int shift = msb - kSubBucketBits;
+        return ((static_cast<std::uint64_t>(kSubBuckets + sub) + 1) << shift) - 1;
+    }
+};
+
+// Запись о запросе для бинарного дампа (см. LatencyRecorder::drain_dump)
+struct LatencyDumpRecord {
+    std::uint32_t latency_us;
+    std::uint16_t series;
+    std::uint16_t error;
+};
+
+// Регистратор задержек по фиксированному набору рядов (например, маршрут × источник ответа).
+//
+// Каждый поток пишет в собственный слот: счётчики атомарные, но у каждого один писатель,
+// поэтому запись — relaxed load/store без блокировок и без выделения памяти (слот
+// создаётся при первой записи потока). Слоты сводятся только при чтении (snapshot /
+// write_prometheus). Если включён дамп, каждый запрос дополнительно кладётся в кольцевой
+// буфер потока, откуда его забирает фоновая задача.
+class LatencyRecorder {
+public:
+    struct Snapshot {
+        std::uint64_t count = 0;
+        std::uint64_t errors = 0;
+        std::uint64_t sum_us = 0;
+        std::uint64_t max_us = 0;
+        std::array<std::uint64_t, LatencyBuckets::kCount> buckets{};
+
+        // Оценка перцентиля q (0..1) в микросекундах
+        std::uint64_t percentile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (int i = 0; i < LatencyBuckets::kCount; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return std::min(LatencyBuckets::upper_bound_of(i), max_us);
+                }
+            }
+            return max_us;
+        }
+    };
+
+    // labels[i] — метки Prometheus ряда i, например `route="article",path="l1"`
+    LatencyRecorder(std::string metric_name, std::vector<std::string> labels, std::size_t dump_capacity = 0)
+        : metric_name_(std::move(metric_name)), labels_(std::move(labels)),
+          dump_capacity_(dump_capacity), id_(next_id()) {}
+
+    LatencyRecorder(const LatencyRecorder &) = delete;
+    LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+    std::size_t series_count() const { return labels_.size(); }
+
+    void record(std::size_t series, std::chrono::nanoseconds latency, bool error = false) {
+        if (series >= labels_.size()) {
+            return;
+        }
+        Slot &slot = local_slot();
+        auto us = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count() / 1000, 0));
+        Counters &c = slot.series[series];
+        bump(c.buckets[LatencyBuckets::index_of(us)], 1);
+        bump(c.count, 1);
+        bump(c.sum_us, us);
+        if (error) {
+            bump(c.errors, 1);
+        }
+        if (us > c.max_us.load(std::memory_order_relaxed)) {
+            c.max_us.store(us, std::memory_order_relaxed);
+        }
+        if (slot.dump) {
+            slot.dump->push({static_cast<std::uint32_t>(std::min<std::uint64_t>(us, UINT32_MAX)),
+                             static_cast<std::uint16_t>(series), static_cast<std::uint16_t>(error)});
+        }
+    }
+
+    Snapshot snapshot(std::size_t series) const {
+        Snapshot s;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &slot : slots_) {
+            const Counters &c = slot->series[series];
+            s.count += c.count.load(std::memory_order_relaxed);
+            s.errors += c.errors.load(std::memory_order_relaxed);
+            s.sum_us += c.sum_us.load(std::memory_order_relaxed);
+            s.max_us = std::max(s.max_us, c.max_us.load(std::memory_order_relaxed));
+            for (int i = 0; i < LatencyBuckets::kCount; ++i) {
+                s.buckets[i] += c.buckets[i].load(std::memory_order_relaxed);
+            }
+        }
+        return s;
+    }
+
+    // Сводка в текстовом формате Prometheus: summary с p50/p99/p999 по каждому ряду и
+    // число ошибок. Поток запросов — rate() от монотонного _seconds_count на стороне
+    // Prometheus: чтение метрик ничего не меняет, и несколько читателей не мешают друг другу.
+    void write_prometheus(std::string &out) const {
+        std::vector<Snapshot> snapshots;
+        snapshots.reserve(labels_.size());
+        for (std::size_t i = 0; i < labels_.size(); ++i) {
+            snapshots.push_back(snapshot(i));
+        }
+
+        char buf[256];
+        out += "# TYPE " + metric_name_ + "_seconds summary\n";
+        for (std::size_t i = 0; i < labels_.size(); ++i) {
+            const Snapshot &s = snapshots[i];
+            for (double q : {0.5, 0.99, 0.999}) {
+                std::snprintf(buf, sizeof(buf), "%s_seconds{%s,quantile=\"%g\"} %.6f\n",
+                              metric_name_.c_str(), labels_[i].c_str(), q, s.percentile(q) / 1e6);
+                out += buf;
+            }
+            std::snprintf(buf, sizeof(buf), "%s_seconds_sum{%s} %.6f\n%s_seconds_count{%s} %llu\n",
+                          metric_name_.c_str(), labels_[i].c_str(), s.sum_us / 1e6,
+                          metric_name_.c_str(), labels_[i].c_str(), static_cast<unsigned long long>(s.count));
+            out += buf;
+        }
+
+        out += "# TYPE " + metric_name_ + "_errors_total counter\n";
+        for (std::size_t i = 0; i < labels_.size(); ++i) {
+            std::snprintf(buf, sizeof(buf), "%s_errors_total{%s} %llu\n", metric_name_.c_str(),
+                          labels_[i].c_str(), static_cast<unsigned long long>(snapshots[i].errors));
+            out += buf;
+        }
+    }
+
+    // Забирает накопленные записи дампа всех потоков и дописывает их в файл.
+    // Возвращает число записей, потерянных из-за переполнения буферов.
+    std::uint64_t drain_dump(std::FILE *file) {
+        std::vector<LatencyDumpRecord> batch;
+        std::uint64_t dropped = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &slot : slots_) {
+            if (slot->dump) {
+                slot->dump->drain(batch);
+                dropped += slot->dump->dropped.exchange(0, std::memory_order_relaxed);
+            }
+        }
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), sizeof(LatencyDumpRecord), batch.size(), file);
+            std::fflush(file);
+        }
+        return dropped;
+    }
+
+    const std::string &labels(std::size_t series) const { return labels_[series]; }
+
+private:
+    static constexpr int kMaxRecorders = 16;
+
+    struct Counters {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> errors{0};
+        std::atomic<std::uint64_t> sum_us{0};
+        std::atomic<std::uint64_t> max_us{0};
+        std::array<std::atomic<std::uint64_t>, LatencyBuckets::kCount> buckets{};
+    };
+
+    // Кольцевой буфер с одним писателем (поток слота) и одним читателем (drain_dump)
+    struct DumpRing {
+        explicit DumpRing(std::size_t capacity) : records(capacity) {}
+
+        void push(const LatencyDumpRecord &record) {
+            const std::uint64_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= records.size()) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            records[h % records.size()] = record;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        void drain(std::vector<LatencyDumpRecord> &out) {
+            const std::uint64_t h = head.load(std::memory_order_acquire);
+            std::uint64_t t = tail.load(std::memory_order_relaxed);
+            for (; t < h; ++t) {
+                out.push_back(records[t % records.size()]);
+            }
+            tail.store(t, std::memory_order_release);
+        }
+
+        std::vector<LatencyDumpRecord> records;
+        std::atomic<std::uint64_t> head{0};
+        std::atomic<std::uint64_t> tail{0};
+        std::atomic<std::uint64_t> dropped{0};
+    };
+
+    struct Slot {
+        explicit Slot(std::size_t series_count, std::size_t dump_capacity)
+            : series(new Counters[series_count]),
+              dump(dump_capacity ? std::make_unique<DumpRing>(dump_capacity) : nullptr) {}
+        std::unique_ptr<Counters[]> series;
+        std::unique_ptr<DumpRing> dump;
+    };
+
+    // Счётчик пишет только поток-владелец слота, поэтому атомарное сложение не нужно
+    static void bump(std::atomic<std::uint64_t> &counter, std::uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static int next_id() {
+        static std::atomic<int> counter{0};
+        int id = counter.fetch_add(1);
+        if (id >= kMaxRecorders) {
+            throw std::logic_error("too many LatencyRecorder instances");
+        }
+        return id;
+    }
+
+    Slot &local_slot() {
+        thread_local std::array<Slot *, kMaxRecorders> slots{};
+        Slot *&slot = slots[id_];
+        if (!slot) {
+            auto created = std::make_unique<Slot>(labels_.size(), dump_capacity_);
+            slot = created.get();
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_.push_back(std::move(created));
+        }
+        return *slot;
+    }
+
+    const std::string metric_name_;
+    const std::vector<std::string> labels_;
+    const std::size_t dump_capacity_;
+    const int id_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Slot>> slots_; // живут до конца процесса, как и потоки Crow
+};
@@ -0,0 +1,57 @@
+// src/periodic_task.h
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Фоновый поток, вызывающий fn() раз в interval до разрушения объекта.
+// Исключения из fn() логируются и не останавливают поток. Интервал не меньше 1 мс:
+// нулевой или отрицательный (например, из переменной окружения) крутил бы цикл вхолостую.
+class PeriodicTask {
+public:
+    PeriodicTask(const char *name, std::chrono::milliseconds interval, std::function<void()> fn)
+        : name_(name), interval_(std::max(interval, std::chrono::milliseconds(1))), fn_(std::move(fn)),
+          thread_([this] { loop(); }) {}
+
+    ~PeriodicTask() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    PeriodicTask(const PeriodicTask &) = delete;
+    PeriodicTask &operator=(const PeriodicTask &) = delete;
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+            lock.unlock();
+            try {
+                fn_();
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Periodic task " << name_ << " failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+        }
+    }
+
+    const char *name_;
+    const std::chrono::milliseconds interval_;
+    std::function<void()> fn_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread thread_; // последним: поток стартует, когда остальные поля готовы
+};
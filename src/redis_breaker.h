@@ -0,0 +1,262 @@
+// src/redis_breaker.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+// Автомат защиты (circuit breaker) для обращений к Redis.
+//
+// Closed — команды идут в Redis; failure_threshold ошибок подряд размыкают автомат.
+// Open — allow() сразу возвращает false, и вызывающий обходится без Redis (L1 и БД),
+// не тратя время на таймауты. Раз в open_duration фоновый поток переводит автомат в
+// HalfOpen и выполняет probe() (например, PING); запросы в это время тоже обходят
+// Redis. Успешная проба замыкает автомат, неудачная — снова размыкает. Перед первым
+// запросом проба выполняется сразу в конструкторе, так что недоступный при старте
+// Redis не тормозит первые запросы.
+//
+// Ошибки Redis пишутся в лог не чаще раза в log_interval; пропущенные строки
+// считаются и упоминаются в следующей.
+//
+// on_recover(fn) — работа, догоняющая пропущенное без Redis (например, повтор
+// инвалидаций): fn выполняет тот же фоновый поток после замыкания автомата и по
+// request_recovery(), а не поток запроса.
+class RedisBreaker {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Probe = std::function<void()>; // исключение — Redis всё ещё недоступен
+
+    enum class State { Closed, Open, HalfOpen };
+
+    struct Options {
+        std::uint32_t failure_threshold = 5;
+        std::chrono::milliseconds open_duration{1000};
+        std::chrono::milliseconds log_interval{5000};
+    };
+
+    struct Stats {
+        State state = State::Closed;
+        std::uint64_t failures = 0;       // ошибок команд
+        std::uint64_t opened = 0;         // размыканий
+        std::uint64_t skipped = 0;        // обращений, обошедших Redis
+        std::uint64_t probes = 0;         // проб в HalfOpen
+        std::uint64_t probe_failures = 0;
+        std::uint64_t suppressed_logs = 0;
+    };
+
+    static const char *state_name(State state) {
+        switch (state) {
+            case State::Closed:
+                return "closed";
+            case State::Open:
+                return "open";
+            case State::HalfOpen:
+                return "half_open";
+        }
+        return "unknown";
+    }
+
+    RedisBreaker(Options options, Probe probe) : options_(options), probe_(std::move(probe)) {
+        try {
+            probe_();
+        }
+        catch (const std::exception &e) {
+            open_circuit();
+            log_error("unavailable at startup, serving without Redis until it recovers", e);
+        }
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    ~RedisBreaker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    RedisBreaker(const RedisBreaker &) = delete;
+    RedisBreaker &operator=(const RedisBreaker &) = delete;
+
+    // Можно ли сейчас обращаться к Redis
+    bool allow() {
+        if (state_.load(std::memory_order_acquire) == State::Closed) {
+            return true;
+        }
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // fn == nullptr снимает обработчик; возвращается, когда текущий вызов fn закончен
+    void on_recover(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(recover_mutex_);
+        on_recover_ = std::move(fn);
+    }
+
+    // Просит фоновый поток вызвать обработчик on_recover, пока автомат замкнут
+    void request_recovery() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recovery_requested_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void success() {
+        consecutive_failures_.store(0, std::memory_order_relaxed);
+    }
+
+    // Ошибка команды op: пишется в лог (с ограничением частоты) и приближает размыкание
+    void failure(std::string_view op, const std::exception &e) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        log_error(op, e);
+        if (consecutive_failures_.fetch_add(1, std::memory_order_relaxed) + 1 >= options_.failure_threshold) {
+            State expected = State::Closed;
+            if (state_.compare_exchange_strong(expected, State::Open, std::memory_order_acq_rel)) {
+                open_circuit();
+                std::cerr << "Redis circuit opened after " << options_.failure_threshold
+                          << " consecutive errors, bypassing Redis" << std::endl;
+            }
+        }
+    }
+
+    // Ошибка вне командного пути (например, подписки): только лог с ограничением частоты
+    void log_error(std::string_view op, const std::exception &e) {
+        const auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        if (now - last_log_ < options_.log_interval && last_log_ != Clock::time_point{}) {
+            suppressed_logs_.fetch_add(1, std::memory_order_relaxed);
+            ++suppressed_since_log_;
+            return;
+        }
+        last_log_ = now;
+        std::cerr << "Redis " << op << ": " << e.what();
+        if (suppressed_since_log_ > 0) {
+            std::cerr << " (" << suppressed_since_log_ << " similar errors suppressed)";
+            suppressed_since_log_ = 0;
+        }
+        std::cerr << std::endl;
+    }
+
+    State state() const { return state_.load(std::memory_order_acquire); }
+
+    Stats stats() const {
+        Stats s;
+        s.state = state();
+        s.failures = failures_.load(std::memory_order_relaxed);
+        s.opened = opened_.load(std::memory_order_relaxed);
+        s.skipped = skipped_.load(std::memory_order_relaxed);
+        s.probes = probes_.load(std::memory_order_relaxed);
+        s.probe_failures = probe_failures_.load(std::memory_order_relaxed);
+        s.suppressed_logs = suppressed_logs_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    void open_circuit() {
+        state_.store(State::Open, std::memory_order_release);
+        opened_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            opened_at_ = Clock::now();
+            down_since_ = opened_at_;
+        }
+        cv_.notify_all();
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (state_.load(std::memory_order_acquire) == State::Closed) {
+                cv_.wait(lock, [this] {
+                    return stopping_ || recovery_requested_ || state_.load(std::memory_order_acquire) != State::Closed;
+                });
+                if (!stopping_ && recovery_requested_ && state_.load(std::memory_order_acquire) == State::Closed) {
+                    recovery_requested_ = false;
+                    lock.unlock();
+                    recover();
+                    lock.lock();
+                }
+                continue;
+            }
+            if (cv_.wait_until(lock, opened_at_ + options_.open_duration, [this] { return stopping_; })) {
+                return;
+            }
+            const auto down_since = down_since_;
+            lock.unlock();
+            state_.store(State::HalfOpen, std::memory_order_release);
+            probes_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                probe_();
+                consecutive_failures_.store(0, std::memory_order_relaxed);
+                state_.store(State::Closed, std::memory_order_release);
+                std::cerr << "Redis circuit closed: Redis is back after "
+                          << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - down_since).count()
+                          << " ms" << std::endl;
+                recover();
+            }
+            catch (const std::exception &e) {
+                probe_failures_.fetch_add(1, std::memory_order_relaxed);
+                log_error("probe failed", e);
+                state_.store(State::Open, std::memory_order_release);
+            }
+            lock.lock();
+            if (state_.load(std::memory_order_acquire) == State::Open) {
+                opened_at_ = Clock::now(); // следующая проба — через open_duration
+            }
+        }
+    }
+
+    void recover() {
+        std::lock_guard<std::mutex> lock(recover_mutex_);
+        if (!on_recover_) {
+            return;
+        }
+        try {
+            on_recover_();
+        }
+        catch (const std::exception &e) {
+            log_error("recovery failed", e);
+        }
+    }
+
+    const Options options_;
+    const Probe probe_;
+
+    std::atomic<State> state_{State::Closed};
+    std::atomic<std::uint32_t> consecutive_failures_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Clock::time_point opened_at_;  // от этого момента отсчитывается пауза до пробы
+    Clock::time_point down_since_; // последнее размыкание из Closed
+    bool stopping_ = false;
+    bool recovery_requested_ = false;
+
+    std::mutex recover_mutex_; // держится, пока выполняется on_recover_
+    std::function<void()> on_recover_;
+
+    std::mutex log_mutex_;
+    Clock::time_point last_log_;
+    std::uint64_t suppressed_since_log_ = 0;
+
+    std::atomic<std::uint64_t> failures_{0};
+    std::atomic<std::uint64_t> opened_{0};
+    std::atomic<std::uint64_t> skipped_{0};
+    std::atomic<std::uint64_t> probes_{0};
+    std::atomic<std::uint64_t> probe_failures_{0};
+    std::atomic<std::uint64_t> suppressed_logs_{0};
+
+    std::thread thread_; // последним: поток стартует, когда остальные поля готовы
+};
@@ -0,0 +1,171 @@
+// src/redis_lock.h
+
+#pragma once
+
+#include <sw/redis++/redis++.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "redis_breaker.h"
+
+// Объединение промахов между экземплярами сервиса через короткую блокировку в Redis.
+//
+// Перед пересборкой ключа экземпляр ставит `lock:{key}` командой SET NX PX. Кто
+// получил блокировку — считает значение; остальные в течение max_wait опрашивают
+// кеш (probe) и отдают значение, как только его положит владелец блокировки. Если
+// блокировка снята, а значения в кеше нет (владелец получил ошибку или не стал класть
+// значение в кеш), ждать больше нечего — экземпляр считает значение сам, как и при
+// недоступном Redis. Не дождавшийся за max_wait возвращает on_timeout() (по умолчанию
+// тоже считает сам).
+// Блокировка снимается Lua-скриптом только владельцем (по случайному токену),
+// а PX страхует от владельца, упавшего посреди пересборки. Пока автомат защиты breaker
+// разомкнут, блокировка не ставится.
+class RedisMissLock {
+public:
+    struct Options {
+        std::chrono::milliseconds lock_ttl{5000};
+        std::chrono::milliseconds max_wait{2000};
+        std::chrono::milliseconds poll_interval{20};
+    };
+
+    struct Stats {
+        std::uint64_t acquired = 0;          // блокировка получена, значение посчитано здесь
+        std::uint64_t contended = 0;         // блокировка занята другим экземпляром
+        std::uint64_t served_after_wait = 0; // значение дождались из кеша
+        std::uint64_t timeouts = 0;          // не дождались за max_wait — on_timeout()
+        std::uint64_t released_empty = 0;    // блокировку сняли, не положив значение, — посчитали сами
+        std::uint64_t errors = 0;            // ошибки Redis при работе с блокировкой
+    };
+
+    // redis может быть nullptr — тогда fn() вызывается без блокировки
+    RedisMissLock(sw::redis::Redis *redis, Options options, RedisBreaker *breaker = nullptr)
+        : redis_(redis), options_(options), breaker_(breaker) {}
+
+    // fn() -> T считает значение; probe() -> std::optional<T> проверяет кеш
+    template <typename T, typename Fn, typename Probe>
+    T run(const std::string &key, Fn &&fn, Probe &&probe) {
+        return run<T>(key, fn, probe, fn);
+    }
+
+    template <typename T, typename Fn, typename Probe, typename Timeout>
+    T run(const std::string &key, Fn &&fn, Probe &&probe, Timeout &&on_timeout) {
+        if (!redis_ || (breaker_ && !breaker_->allow())) {
+            return fn();
+        }
+        const std::string lock_key = "lock:" + key;
+        const std::string token = make_token();
+
+        bool locked = false;
+        try {
+            locked = redis_->set(lock_key, token, options_.lock_ttl, sw::redis::UpdateType::NOT_EXIST);
+            if (breaker_) {
+                breaker_->success();
+            }
+        }
+        catch (const std::exception &e) {
+            report_error("lock error (" + lock_key + ")", e);
+            return fn();
+        }
+
+        if (locked) {
+            acquired_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                T value = fn();
+                release(lock_key, token);
+                return value;
+            }
+            catch (...) {
+                release(lock_key, token);
+                throw;
+            }
+        }
+
+        contended_.fetch_add(1, std::memory_order_relaxed);
+        const auto deadline = std::chrono::steady_clock::now() + options_.max_wait;
+        while (std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(options_.poll_interval);
+            // Блокировка проверяется до кеша: владелец кладёт значение раньше, чем её снять
+            const bool held = lock_held(lock_key);
+            if (std::optional<T> value = probe()) {
+                served_after_wait_.fetch_add(1, std::memory_order_relaxed);
+                return std::move(*value);
+            }
+            if (!held) {
+                released_empty_.fetch_add(1, std::memory_order_relaxed);
+                return fn();
+            }
+        }
+        timeouts_.fetch_add(1, std::memory_order_relaxed);
+        return on_timeout();
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.acquired = acquired_.load(std::memory_order_relaxed);
+        s.contended = contended_.load(std::memory_order_relaxed);
+        s.served_after_wait = served_after_wait_.load(std::memory_order_relaxed);
+        s.timeouts = timeouts_.load(std::memory_order_relaxed);
+        s.released_empty = released_empty_.load(std::memory_order_relaxed);
+        s.errors = errors_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static std::string make_token() {
+        thread_local std::mt19937_64 rng{std::random_device{}()};
+        std::ostringstream out;
+        out << std::hex << rng();
+        return out.str();
+    }
+
+    // Ошибка Redis считается занятой блокировкой: ожидание продолжится до max_wait
+    bool lock_held(const std::string &lock_key) {
+        try {
+            return redis_->exists(lock_key) > 0;
+        }
+        catch (const std::exception &e) {
+            report_error("exists error (" + lock_key + ")", e);
+            return true;
+        }
+    }
+
+    void release(const std::string &lock_key, const std::string &token) {
+        static const char *script =
+            "if redis.call('get', KEYS[1]) == ARGV[1] then "
+            "return redis.call('del', KEYS[1]) else return 0 end";
+        try {
+            redis_->eval<long long>(script, {lock_key}, {token});
+        }
+        catch (const std::exception &e) {
+            report_error("unlock error (" + lock_key + ")", e);
+        }
+    }
+
+    void report_error(const std::string &op, const std::exception &e) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        if (breaker_) {
+            breaker_->failure(op, e);
+        }
+        else {
+            std::cerr << "Redis " << op << ": " << e.what() << std::endl;
+        }
+    }
+
+    sw::redis::Redis *redis_;
+    const Options options_;
+    RedisBreaker *breaker_;
+
+    std::atomic<std::uint64_t> acquired_{0};
+    std::atomic<std::uint64_t> contended_{0};
+    std::atomic<std::uint64_t> served_after_wait_{0};
+    std::atomic<std::uint64_t> timeouts_{0};
+    std::atomic<std::uint64_t> released_empty_{0};
+    std::atomic<std::uint64_t> errors_{0};
+};
@@ -0,0 +1,211 @@
+// src/request_trace.h
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "metrics.h"
+
+// Этапы обработки запроса, время которых замеряется по отдельности
+enum class Stage { Cache, DbQueue, DbConnect, DbQuery, Serialize, Encode, CacheFill, Count };
+
+inline constexpr std::size_t kStageCount = static_cast<std::size_t>(Stage::Count);
+
+// Имена этапов — они же имена метрик в Server-Timing и метка stage в /metrics
+inline const char *stage_name(Stage stage) {
+    static const char *const names[] = {"cache", "db_queue", "db_conn", "db_query", "serialize", "encode",
+                                        "cache_fill"};
+    return names[static_cast<std::size_t>(stage)];
+}
+
+// Суммарное время и число замеров по этапам одного запроса
+struct StageTimes {
+    std::array<std::int64_t, kStageCount> ns{};
+    std::array<std::uint32_t, kStageCount> count{};
+
+    void add(Stage stage, std::chrono::nanoseconds duration) {
+        const auto i = static_cast<std::size_t>(stage);
+        ns[i] += duration.count();
+        ++count[i];
+    }
+
+    void merge(const StageTimes &other) {
+        for (std::size_t i = 0; i < kStageCount; ++i) {
+            ns[i] += other.ns[i];
+            count[i] += other.count[i];
+        }
+    }
+
+    // Значение заголовка Server-Timing: "cache;dur=0.041, db_query;dur=1.250, total;dur=1.630"
+    // (миллисекунды; этапы без замеров пропускаются)
+    std::string server_timing(std::chrono::nanoseconds total) const {
+        std::string header;
+        header.reserve(160);
+        for (std::size_t i = 0; i < kStageCount; ++i) {
+            if (count[i] == 0) {
+                continue;
+            }
+            header += stage_name(static_cast<Stage>(i));
+            header += ";dur=";
+            append_ms(header, ns[i]);
+            header += ", ";
+        }
+        header += "total;dur=";
+        append_ms(header, total.count());
+        return header;
+    }
+
+    // Миллисекунды с тремя знаками после точки без snprintf: заголовок строится на каждый
+    // запрос, а форматирование double стоило бы больше самих замеров
+    static void append_ms(std::string &out, std::int64_t ns) {
+        const std::int64_t us = std::max<std::int64_t>(ns, 0) / 1000;
+        char buf[32];
+        char *end = std::to_chars(buf, buf + sizeof(buf), us / 1000).ptr;
+        const auto frac = static_cast<int>(us % 1000);
+        *end++ = '.';
+        *end++ = static_cast<char>('0' + frac / 100);
+        *end++ = static_cast<char>('0' + frac / 10 % 10);
+        *end++ = static_cast<char>('0' + frac % 10);
+        out.append(buf, end);
+    }
+};
+
+// Трассировка текущего потока: StageSpan пишет в StageTimes, установленный ближайшим
+// TraceScope. Без него StageSpan ничего не делает, поэтому фоновые задачи (прогрев,
+// обновление SWR) замеры не тратят.
+class TraceScope {
+public:
+    explicit TraceScope(StageTimes *times) : previous_(current()) { current() = times; }
+    ~TraceScope() { current() = previous_; }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    static StageTimes *&current() {
+        thread_local StageTimes *times = nullptr;
+        return times;
+    }
+
+private:
+    StageTimes *const previous_;
+};
+
+// Замер этапа от создания до разрушения. Этапы не вкладываются друг в друга, иначе
+// время вложенного учлось бы дважды.
+class StageSpan {
+public:
+    explicit StageSpan(Stage stage) : times_(TraceScope::current()), stage_(stage) {
+        if (times_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StageSpan() {
+        if (times_) {
+            times_->add(stage_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+    StageSpan(const StageSpan &) = delete;
+    StageSpan &operator=(const StageSpan &) = delete;
+
+private:
+    StageTimes *const times_;
+    const Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Итоги трассировки запросов: гистограммы по этапам (request_stage_duration в /metrics),
+// заголовок Server-Timing и журнал медленных запросов. В журнал попадает каждый
+// slow_log_sample-й запрос дольше slow_threshold, с разбивкой по этапам.
+class RequestTracer {
+public:
+    struct Options {
+        bool enabled = true;       // false — ни замеров, ни заголовка
+        bool server_timing = true; // отдавать ли Server-Timing клиентам
+        std::chrono::milliseconds slow_threshold{200}; // 0 — журнал выключен
+        std::uint32_t slow_log_sample = 1;
+    };
+
+    explicit RequestTracer(Options options)
+        : options_(options), stages_("request_stage_duration", stage_labels()) {
+        if (options_.slow_log_sample == 0) {
+            options_.slow_log_sample = 1;
+        }
+    }
+
+    RequestTracer(const RequestTracer &) = delete;
+    RequestTracer &operator=(const RequestTracer &) = delete;
+
+    bool enabled() const { return options_.enabled; }
+    bool server_timing() const { return options_.enabled && options_.server_timing; }
+
+    // Учёт завершённого запроса. describe() — строка для журнала ("GET /article/7 -> 200"),
+    // строится только для записи в журнал.
+    template <typename Describe>
+    void finish(const StageTimes &times, std::chrono::nanoseconds total, Describe &&describe) {
+        for (std::size_t i = 0; i < kStageCount; ++i) {
+            if (times.count[i] > 0) {
+                stages_.record(i, std::chrono::nanoseconds(times.ns[i]));
+            }
+        }
+        if (options_.slow_threshold.count() > 0 && total >= options_.slow_threshold) {
+            const std::uint64_t n = slow_.fetch_add(1, std::memory_order_relaxed);
+            if (n % options_.slow_log_sample == 0) {
+                log_slow(times, total, describe());
+            }
+        }
+    }
+
+    std::uint64_t slow_requests() const { return slow_.load(std::memory_order_relaxed); }
+    LatencyRecorder &stages() { return stages_; }
+    const Options &options() const { return options_; }
+
+private:
+    static std::vector<std::string> stage_labels() {
+        std::vector<std::string> labels;
+        for (std::size_t i = 0; i < kStageCount; ++i) {
+            labels.push_back(std::string("stage=\"") + stage_name(static_cast<Stage>(i)) + "\"");
+        }
+        return labels;
+    }
+
+    static void log_slow(const StageTimes &times, std::chrono::nanoseconds total, std::string_view what) {
+        std::string line = "Slow request ";
+        line += what;
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), ": %.1f ms", total.count() / 1e6);
+        line += buf;
+        std::int64_t traced = 0;
+        for (std::size_t i = 0; i < kStageCount; ++i) {
+            if (times.count[i] == 0) {
+                continue;
+            }
+            std::snprintf(buf, sizeof(buf), " %s=%.2fms", stage_name(static_cast<Stage>(i)), times.ns[i] / 1e6);
+            line += buf;
+            if (times.count[i] > 1) {
+                line += "(x" + std::to_string(times.count[i]) + ')';
+            }
+            traced += times.ns[i];
+        }
+        // Время вне замеренных этапов: ожидание чужой пересборки, разбор запроса, ответ
+        std::snprintf(buf, sizeof(buf), " other=%.2fms",
+                      std::max<std::int64_t>(total.count() - traced, 0) / 1e6);
+        line += buf;
+        std::cerr << line << std::endl;
+    }
+
+    Options options_;
+    LatencyRecorder stages_;
+    std::atomic<std::uint64_t> slow_{0};
+};
@@ -0,0 +1,548 @@
+// src/search_index.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Инвертированный индекс статей в памяти для GET /articles/search: терм -> отсортированный
+// список id статей, в тексте которых (заголовок, содержимое, комментарии) он встречается.
+//
+// Термы — слова из букв и цифр длиной от kMinTermChars символов: ASCII, латиница с
+// диакритикой и кириллица в UTF-8; ASCII, Latin-1 и кириллица приводятся к нижнему
+// регистру. Прочие трёхбайтовые символы (в том числе CJK) считаются буквами, кроме
+// блоков знаков и символов (U+2000..U+2FFF, U+3000..U+303F, U+FE00..U+FE0F, U+FEFF,
+// U+FF00..U+FFEF); четырёхбайтовые (эмодзи и т. п.) и неверные последовательности UTF-8
+// разделяют слова. Поиск по нескольким словам — пересечение их списков (все слова должны быть
+// в статье): кандидаты из самого короткого списка ищутся в остальных экспоненциальным
+// поиском от предыдущей позиции.
+//
+// Списки — плотные отсортированные массивы uint32_t. Для изменений хранится и прямой
+// индекс (id статьи -> номера её термов): replace() обновляет только изменившиеся термы,
+// новая статья с наибольшим id дописывается в конец списков. Чтения идут под общей
+// блокировкой, изменения — под исключительной.
+//
+// Полная сборка (rebuild) идёт частями: fill(chunk, part) заполняет часть индекса по
+// своему диапазону статей в одном из потоков, затем части сливаются по порядку — если
+// диапазоны частей идут по возрастанию id, списки остаются отсортированными без сортировки.
+// Готовый индекс подменяет прежний целиком.
+//
+// mark_changed()/take_changed() — очередь статей, изменившихся после последнего
+// обновления: писатели отмечают id, фоновая задача перечитывает их тексты и вызывает
+// replace() (или rebuild(), если отмечена полная пересборка).
+class SearchIndex {
+public:
+    static constexpr std::size_t kMinTermChars = 2;
+    static constexpr std::size_t kMaxTermBytes = 64;
+
+    // Термы одной статьи, собранные по её текстам
+    class Terms {
+    public:
+        void add(std::string_view text) {
+            tokenize(text, [this](std::string_view term) {
+                spans_.emplace_back(static_cast<std::uint32_t>(bytes_.size()), static_cast<std::uint32_t>(term.size()));
+                bytes_ += term;
+            });
+        }
+
+        // Термы без повторов в произвольном порядке. Повторы ищутся сортировкой по хешу, а
+        // не по строкам: сравнение строк на сотнях термов статьи обходится дороже самого
+        // разбора текста.
+        std::vector<std::string> &finish() {
+            std::vector<std::pair<std::size_t, std::string_view>> keyed;
+            keyed.reserve(spans_.size());
+            for (const auto &[offset, size] : spans_) {
+                const std::string_view term(bytes_.data() + offset, size);
+                keyed.emplace_back(std::hash<std::string_view>()(term), term);
+            }
+            std::sort(keyed.begin(), keyed.end());
+            keyed.erase(std::unique(keyed.begin(), keyed.end()), keyed.end());
+            terms_.clear();
+            terms_.reserve(keyed.size());
+            for (const auto &entry : keyed) {
+                terms_.emplace_back(entry.second);
+            }
+            return terms_;
+        }
+
+    private:
+        std::string bytes_;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> spans_; // смещение и длина в bytes_
+        std::vector<std::string> terms_;
+    };
+
+    // Часть индекса по диапазону статей; id в add() — по возрастанию
+    class Part {
+    public:
+        void add(int id, const std::vector<std::string> &terms) {
+            std::vector<std::uint32_t> local;
+            local.reserve(terms.size());
+            for (const std::string &term : terms) {
+                auto [it, inserted] = term_ids_.try_emplace(term, static_cast<std::uint32_t>(terms_.size()));
+                if (inserted) {
+                    terms_.push_back(term);
+                    postings_.emplace_back();
+                }
+                postings_[it->second].push_back(static_cast<std::uint32_t>(id));
+                local.push_back(it->second);
+            }
+            documents_.emplace_back(id, std::move(local));
+        }
+
+    private:
+        friend class SearchIndex;
+        std::unordered_map<std::string, std::uint32_t> term_ids_;
+        std::vector<std::string> terms_;
+        std::vector<std::vector<std::uint32_t>> postings_;
+        std::vector<std::pair<int, std::vector<std::uint32_t>>> documents_; // номера термов части
+    };
+
+    struct Page {
+        std::vector<int> ids; // по возрастанию, не больше limit
+        std::size_t total = 0; // сколько всего статей подходит
+        bool more = false;     // после ids есть ещё подходящие
+    };
+
+    struct Stats {
+        std::size_t documents = 0;
+        std::size_t terms = 0;
+        std::size_t postings = 0;
+        std::size_t bytes = 0; // оценка занятой памяти: списки, словарь, прямой индекс
+        std::uint64_t queries = 0;
+        std::uint64_t updates = 0;
+        std::uint64_t rebuilds = 0;
+    };
+
+    SearchIndex() = default;
+    SearchIndex(const SearchIndex &) = delete;
+    SearchIndex &operator=(const SearchIndex &) = delete;
+
+    // Вызывает fn(term) для каждого терма текста (с повторами), term действителен до возврата
+    template <typename Fn>
+    static void tokenize(std::string_view text, Fn &&fn) {
+        std::string term;
+        std::size_t chars = 0;
+        auto flush = [&]() {
+            if (chars >= kMinTermChars && term.size() <= kMaxTermBytes) {
+                fn(std::string_view(term));
+            }
+            term.clear();
+            chars = 0;
+        };
+        const auto *p = reinterpret_cast<const unsigned char *>(text.data());
+        const auto *end = p + text.size();
+        while (p < end) {
+            const unsigned char c = *p;
+            if (c < 0x80) {
+                if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+                    term += static_cast<char>(c);
+                    ++chars;
+                }
+                else if (c >= 'A' && c <= 'Z') {
+                    term += static_cast<char>(c - 'A' + 'a');
+                    ++chars;
+                }
+                else {
+                    flush();
+                }
+                ++p;
+                continue;
+            }
+            const std::ptrdiff_t length = utf8_length(p, end);
+            if (length == 0) {
+                flush(); // неверный первый байт, байт продолжения не на месте, обрыв
+                ++p;
+                continue;
+            }
+            if (length == 2) {
+                std::uint32_t cp = ((c & 0x1Fu) << 6) | (p[1] & 0x3Fu);
+                // U+00C0..U+052F — латиница с диакритикой, греческий, кириллица; кроме × и ÷
+                if (cp >= 0xC0 && cp <= 0x52F && cp != 0xD7 && cp != 0xF7) {
+                    cp = to_lower(cp);
+                    term += static_cast<char>(0xC0 | (cp >> 6));
+                    term += static_cast<char>(0x80 | (cp & 0x3F));
+                    ++chars;
+                }
+                else {
+                    flush();
+                }
+            }
+            else if (length == 4 || is_symbol(((c & 0x0Fu) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3Fu))) {
+                flush();
+            }
+            else {
+                term.append(reinterpret_cast<const char *>(p), static_cast<std::size_t>(length));
+                ++chars;
+            }
+            p += length;
+        }
+        flush();
+    }
+
+    // Термы запроса без повторов; пусто — искать нечего
+    static std::vector<std::string> query_terms(std::string_view query) {
+        Terms terms;
+        terms.add(query);
+        return std::move(terms.finish());
+    }
+
+    // Статьи со всеми термами terms, id больше after_id, не больше limit
+    Page search(const std::vector<std::string> &terms, int after_id, std::size_t limit) const {
+        queries_.fetch_add(1, std::memory_order_relaxed);
+        Page page;
+        if (terms.empty()) {
+            return page;
+        }
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::vector<const std::vector<std::uint32_t> *> lists;
+        lists.reserve(terms.size());
+        for (const std::string &term : terms) {
+            auto it = data_->term_ids.find(term);
+            if (it == data_->term_ids.end() || data_->postings[it->second].empty()) {
+                return page;
+            }
+            lists.push_back(&data_->postings[it->second]);
+        }
+        std::sort(lists.begin(), lists.end(), [](const auto *a, const auto *b) { return a->size() < b->size(); });
+        if (lists.size() == 1) {
+            // Один терм: список и есть ответ, страница — срез после after_id
+            const auto &list = *lists[0];
+            auto from = std::upper_bound(list.begin(), list.end(), static_cast<std::uint32_t>(std::max(after_id, 0)));
+            const auto count = std::min<std::size_t>(limit, static_cast<std::size_t>(list.end() - from));
+            page.ids.assign(from, from + static_cast<std::ptrdiff_t>(count));
+            page.total = list.size();
+            page.more = static_cast<std::size_t>(list.end() - from) > count;
+            return page;
+        }
+
+        // Кандидаты — из самого короткого списка; в остальных позиция только растёт
+        std::vector<Position> positions;
+        for (std::size_t i = 1; i < lists.size(); ++i) {
+            positions.push_back(lists[i]->begin());
+        }
+        for (const std::uint32_t id : *lists[0]) {
+            bool everywhere = true;
+            for (std::size_t i = 1; i < lists.size() && everywhere; ++i) {
+                auto &pos = positions[i - 1];
+                pos = gallop(pos, lists[i]->end(), id);
+                everywhere = pos != lists[i]->end() && *pos == id;
+            }
+            if (!everywhere) {
+                continue;
+            }
+            ++page.total;
+            if (static_cast<int>(id) > after_id) {
+                if (page.ids.size() < limit) {
+                    page.ids.push_back(static_cast<int>(id));
+                }
+                else {
+                    page.more = true;
+                }
+            }
+        }
+        return page;
+    }
+
+    // Новые термы статьи id (из Terms::finish); пустой набор — статьи больше нет
+    void replace(int id, const std::vector<std::string> &terms) {
+        updates_.fetch_add(1, std::memory_order_relaxed);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Data &data = *data_;
+        // Оценка памяти меняется на разницу: таблицы до и после, новые термы, затронутые
+        // списки и запись статьи
+        std::size_t bytes = data.bytes - table_bytes(data);
+        std::vector<std::uint32_t> now;
+        now.reserve(terms.size());
+        for (const std::string &term : terms) {
+            auto [it, inserted] = data.term_ids.try_emplace(term, static_cast<std::uint32_t>(data.postings.size()));
+            if (inserted) {
+                data.postings.emplace_back();
+                bytes += term_bytes(it->first);
+            }
+            now.push_back(it->second);
+        }
+        std::sort(now.begin(), now.end());
+
+        auto doc = data.documents.find(id);
+        static const std::vector<std::uint32_t> kNone;
+        const std::vector<std::uint32_t> &before = doc == data.documents.end() ? kNone : doc->second;
+        const auto uid = static_cast<std::uint32_t>(id);
+        // Оба набора отсортированы: один проход находит ушедшие и новые термы
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < before.size() || j < now.size()) {
+            if (j == now.size() || (i < before.size() && before[i] < now[j])) {
+                auto &list = data.postings[before[i++]];
+                // erase не меняет ёмкость списка
+                auto pos = std::lower_bound(list.begin(), list.end(), uid);
+                if (pos != list.end() && *pos == uid) {
+                    list.erase(pos);
+                    --data.postings_count;
+                }
+            }
+            else if (i == before.size() || now[j] < before[i]) {
+                auto &list = data.postings[now[j++]];
+                bytes -= list_bytes(list);
+                if (list.empty() || list.back() < uid) {
+                    list.push_back(uid);
+                }
+                else {
+                    list.insert(std::lower_bound(list.begin(), list.end(), uid), uid);
+                }
+                bytes += list_bytes(list);
+                ++data.postings_count;
+            }
+            else {
+                ++i;
+                ++j;
+            }
+        }
+        if (doc != data.documents.end()) {
+            bytes -= document_bytes(doc->second);
+        }
+        if (!now.empty()) {
+            bytes += document_bytes(now);
+        }
+        if (now.empty()) {
+            if (doc != data.documents.end()) {
+                data.documents.erase(doc);
+            }
+        }
+        else if (doc != data.documents.end()) {
+            doc->second = std::move(now);
+        }
+        else {
+            data.documents.emplace(id, std::move(now));
+        }
+        data.bytes = bytes + table_bytes(data);
+    }
+
+    void remove(int id) { replace(id, {}); }
+
+    void mark_changed(int id) {
+        std::lock_guard<std::mutex> lock(changed_mutex_);
+        changed_.push_back(id);
+    }
+
+    // Изменения могли пройти мимо (например, потеряны уведомления БД): пересобрать всё
+    void mark_all_changed() {
+        std::lock_guard<std::mutex> lock(changed_mutex_);
+        rebuild_requested_ = true;
+        changed_.clear();
+    }
+
+    // Отмеченные id без повторов; rebuild — запрошена полная пересборка
+    std::vector<int> take_changed(bool &rebuild) {
+        std::vector<int> ids;
+        {
+            std::lock_guard<std::mutex> lock(changed_mutex_);
+            ids.swap(changed_);
+            rebuild = rebuild_requested_;
+            rebuild_requested_ = false;
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+
+    // Индекс собран хотя бы раз
+    bool ready() const { return rebuilds_.load(std::memory_order_relaxed) > 0; }
+
+    // Полная пересборка: fill(chunk, part) для chunk из [0, chunks) в threads потоках.
+    // Исключение из fill прерывает сборку и выходит из rebuild(), прежний индекс остаётся.
+    template <typename Fill>
+    void rebuild(std::size_t chunks, std::size_t threads, Fill &&fill) {
+        std::vector<Part> parts(chunks);
+        std::atomic<std::size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto work = [&]() {
+            for (std::size_t chunk = next++; chunk < chunks; chunk = next++) {
+                try {
+                    fill(chunk, parts[chunk]);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    error = std::current_exception();
+                    next = chunks;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t t = 1; t < std::min(std::max<std::size_t>(threads, 1), chunks); ++t) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        auto data = std::make_unique<Data>();
+        for (Part &part : parts) {
+            std::vector<std::uint32_t> global(part.terms_.size());
+            for (std::size_t t = 0; t < part.terms_.size(); ++t) {
+                data->postings_count += part.postings_[t].size();
+                auto [it, inserted] =
+                    data->term_ids.try_emplace(std::move(part.terms_[t]), static_cast<std::uint32_t>(data->postings.size()));
+                if (inserted) {
+                    data->postings.push_back(std::move(part.postings_[t]));
+                }
+                else {
+                    auto &list = data->postings[it->second];
+                    list.insert(list.end(), part.postings_[t].begin(), part.postings_[t].end());
+                }
+                global[t] = it->second;
+            }
+            for (auto &[id, local] : part.documents_) {
+                for (std::uint32_t &term : local) {
+                    term = global[term];
+                }
+                std::sort(local.begin(), local.end());
+                data->documents.emplace(id, std::move(local));
+            }
+            part = Part();
+        }
+        for (auto &list : data->postings) {
+            list.shrink_to_fit();
+        }
+        data->bytes = table_bytes(*data);
+        for (const auto &list : data->postings) {
+            data->bytes += list_bytes(list);
+        }
+        for (const auto &entry : data->term_ids) {
+            data->bytes += term_bytes(entry.first);
+        }
+        for (const auto &entry : data->documents) {
+            data->bytes += document_bytes(entry.second);
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            data_.swap(data);
+        }
+        rebuilds_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.queries = queries_.load(std::memory_order_relaxed);
+        s.updates = updates_.load(std::memory_order_relaxed);
+        s.rebuilds = rebuilds_.load(std::memory_order_relaxed);
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const Data &data = *data_;
+        s.documents = data.documents.size();
+        s.terms = data.term_ids.size();
+        s.postings = data.postings_count;
+        s.bytes = data.bytes;
+        return s;
+    }
+
+private:
+    struct Data {
+        std::unordered_map<std::string, std::uint32_t> term_ids;
+        std::vector<std::vector<std::uint32_t>> postings;                 // по номеру терма
+        std::unordered_map<int, std::vector<std::uint32_t>> documents; // номера термов статьи
+        std::size_t postings_count = 0;
+        std::size_t bytes = 0; // оценка памяти для stats(): считается в rebuild, меняется в replace
+    };
+
+    // Слагаемые оценки памяти. Узел хеш-таблицы — ключ, значение, указатель на следующий
+    // и кешированный хеш; строка до 15 байт хранится в самом объекте.
+    static constexpr std::size_t kNode = 2 * sizeof(void *);
+
+    static std::size_t table_bytes(const Data &data) {
+        return data.postings.capacity() * sizeof(std::vector<std::uint32_t>) +
+               (data.term_ids.bucket_count() + data.documents.bucket_count()) * sizeof(void *);
+    }
+
+    static std::size_t list_bytes(const std::vector<std::uint32_t> &list) {
+        return list.capacity() * sizeof(std::uint32_t);
+    }
+
+    static std::size_t term_bytes(const std::string &term) {
+        return kNode + sizeof(std::string) + sizeof(std::uint32_t) + (term.size() > 15 ? term.capacity() + 1 : 0);
+    }
+
+    static std::size_t document_bytes(const std::vector<std::uint32_t> &terms) {
+        return kNode + sizeof(int) + sizeof(terms) + terms.capacity() * sizeof(std::uint32_t);
+    }
+
+    // lower_bound от позиции, которая только растёт: шаг удваивается, пока не перескочит
+    // id, затем двоичный поиск в последнем шаге — соседние кандидаты находятся за
+    // несколько сравнений, а не за log(длины списка)
+    using Position = std::vector<std::uint32_t>::const_iterator;
+    static Position gallop(Position pos, Position end, std::uint32_t id) {
+        std::ptrdiff_t step = 1;
+        Position low = pos;
+        while (end - pos > step && pos[step] < id) {
+            low = pos + step;
+            step *= 2;
+        }
+        return std::lower_bound(low, end - pos > step ? pos + step + 1 : end, id);
+    }
+
+    // Длина верной последовательности UTF-8 с первым байтом *p, 0 — неверная: лишний байт
+    // продолжения, обрыв, неверный байт продолжения, избыточная запись или суррогат
+    static std::ptrdiff_t utf8_length(const unsigned char *p, const unsigned char *end) {
+        const unsigned char c = *p;
+        const std::ptrdiff_t length = c >= 0xF5 ? 0 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 ? 2 : 0;
+        if (length == 0 || end - p < length) {
+            return 0;
+        }
+        for (std::ptrdiff_t i = 1; i < length; ++i) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return 0;
+            }
+        }
+        // Допустимый диапазон второго байта: без избыточных записей, суррогатов и > U+10FFFF
+        if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0) || (c == 0xF0 && p[1] < 0x90) ||
+            (c == 0xF4 && p[1] >= 0x90)) {
+            return 0;
+        }
+        return length;
+    }
+
+    // Трёхбайтовые символы, которые не бывают частью слова: знаки препинания, символы,
+    // пробелы и знаки CJK, селекторы вариантов, BOM, полноширинные формы
+    static bool is_symbol(std::uint32_t cp) {
+        return (cp >= 0x2000 && cp <= 0x2FFF) || (cp >= 0x3000 && cp <= 0x303F) || (cp >= 0xFE00 && cp <= 0xFE0F) ||
+               cp == 0xFEFF || (cp >= 0xFF00 && cp <= 0xFFEF);
+    }
+
+    // Нижний регистр для двухбайтовых символов UTF-8: Latin-1 и кириллица
+    static std::uint32_t to_lower(std::uint32_t cp) {
+        if (cp >= 0xC0 && cp <= 0xDE) {
+            return cp + 0x20;
+        }
+        if (cp >= 0x410 && cp <= 0x42F) {
+            return cp + 0x20;
+        }
+        if (cp >= 0x400 && cp <= 0x40F) {
+            return cp + 0x50;
+        }
+        return cp;
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::unique_ptr<Data> data_ = std::make_unique<Data>();
+    std::mutex changed_mutex_;
+    std::vector<int> changed_;
+    bool rebuild_requested_ = false;
+    mutable std::atomic<std::uint64_t> queries_{0};
+    std::atomic<std::uint64_t> updates_{0};
+    std::atomic<std::uint64_t> rebuilds_{0};
+};
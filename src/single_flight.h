@@ -0,0 +1,96 @@
+// src/single_flight.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Объединение одновременных промахов по одному ключу внутри процесса.
+//
+// Первый запрос по ключу («ведущий») выполняет fn(), остальные, пришедшие до его
+// завершения, ждут и получают тот же результат (или то же исключение). Ожидание
+// ограничено wait_timeout: не дождавшись ведущего, ожидающий возвращает on_timeout()
+// (по умолчанию — вычисляет значение сам).
+template <typename T>
+class SingleFlight {
+public:
+    struct Stats {
+        std::uint64_t leaders = 0;       // вычислений, выполненных ведущими
+        std::uint64_t coalesced = 0;     // запросов, получивших чужой результат
+        std::uint64_t wait_timeouts = 0; // ожидающих, не дождавшихся ведущего
+    };
+
+    explicit SingleFlight(std::chrono::milliseconds wait_timeout) : wait_timeout_(wait_timeout) {}
+
+    SingleFlight(const SingleFlight &) = delete;
+    SingleFlight &operator=(const SingleFlight &) = delete;
+
+    template <typename Fn>
+    T run(const std::string &key, Fn &&fn) {
+        return run(key, fn, fn);
+    }
+
+    template <typename Fn, typename Timeout>
+    T run(const std::string &key, Fn &&fn, Timeout &&on_timeout) {
+        std::promise<T> promise;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto it = calls_.find(key);
+            if (it != calls_.end()) {
+                std::shared_future<T> pending = it->second;
+                lock.unlock();
+                if (pending.wait_for(wait_timeout_) == std::future_status::ready) {
+                    coalesced_.fetch_add(1, std::memory_order_relaxed);
+                    return pending.get();
+                }
+                wait_timeouts_.fetch_add(1, std::memory_order_relaxed);
+                return on_timeout();
+            }
+            calls_.emplace(key, promise.get_future().share());
+        }
+
+        leaders_.fetch_add(1, std::memory_order_relaxed);
+        try {
+            T value = fn();
+            finish(key);
+            promise.set_value(value);
+            return value;
+        }
+        catch (...) {
+            finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.leaders = leaders_.load(std::memory_order_relaxed);
+        s.coalesced = coalesced_.load(std::memory_order_relaxed);
+        s.wait_timeouts = wait_timeouts_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    // Ключ снимается до публикации результата: пришедшие позже начнут новое
+    // вычисление, но к этому моменту значение обычно уже лежит в кеше.
+    void finish(const std::string &key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        calls_.erase(key);
+    }
+
+    const std::chrono::milliseconds wait_timeout_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_future<T>> calls_;
+
+    std::atomic<std::uint64_t> leaders_{0};
+    std::atomic<std::uint64_t> coalesced_{0};
+    std::atomic<std::uint64_t> wait_timeouts_{0};
+};
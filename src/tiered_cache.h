@@ -0,0 +1,879 @@
+// src/tiered_cache.h
+
+#pragma once
+
+#include <sw/redis++/redis++.h>
+#ifdef HAVE_REDIS_ASYNC
+#include <sw/redis++/async_redis++.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cache_snapshot.h"
+#include "l1_cache.h"
+#include "metrics.h"
+#include "redis_breaker.h"
+#include "request_trace.h"
+
+// Откуда получен ответ
+enum class CacheSource {
+    L1,       // внутрипроцессный кеш
+    Redis,    // общий кеш (L2)
+    Snapshot, // снимок с диска, ещё не проверенный по БД (см. use_snapshot)
+    Miss      // нет ни там, ни там — нужен запрос к БД
+};
+
+struct CacheLookup {
+    L1Cache::Value value; // nullptr при промахе
+    CacheSource source = CacheSource::Miss;
+};
+
+// Двухуровневый кеш: L1Cache в процессе перед Redis.
+//
+// Согласованность L1 между экземплярами сервиса поддерживается через pub/sub:
+// invalidate() удаляет ключи локально и в Redis и публикует их в канал, а фоновый
+// слушатель каждого экземпляра стирает полученные ключи из своего L1. Если подписка
+// обрывается, сообщения могли потеряться, поэтому L1 после переподключения очищается.
+//
+// Запись в Redis — один атомарный SET с TTL. Чтение идёт вместе с PTTL ключа (для
+// нескольких ключей — одним конвейером): запись из Redis живёт в L1 не дольше, чем в Redis.
+// Если сервис собран с HAVE_REDIS_ASYNC и вызван use_async(), заполнение кеша не ждёт
+// ответа Redis, а чтение ждёт не дольше заданного таймаута (после него — промах).
+//
+// С use_breaker() кеш не обращается к Redis, пока автомат разомкнут: чтения сразу
+// становятся промахами, записи остаются только в L1. Инвалидации, не дошедшие до Redis,
+// запоминаются (не больше kMaxSkippedInvalidations ключей) и повторяются после
+// восстановления Redis фоновым потоком автомата (RedisBreaker::on_recover), а не
+// запросом — иначе в Redis остались бы записи, изменённые за время недоступности.
+//
+// С use_bulk() команды больше чем на Options::bulk_min_keys ключей (сборка списка из
+// фрагментов, запись их конвейером) и повтор инвалидаций идут через отдельный клиент со
+// своим, более длинным таймаутом: таймаут одиночных команд рассчитан на один ключ.
+//
+// Заполнение после инвалидации: загрузка, прочитавшая БД до записи, не должна положить
+// старое значение после инвалидации этой записи (иначе оно прожило бы весь TTL). Перед
+// чтением БД загрузка берёт fill_epoch() и передаёт её в put(): каждая инвалидация ключа —
+// своя, полученная от других экземпляров или после потери подписки — отмечает его номером
+// новее, и такой put() пропускается. Если инвалидация пришла, пока put() писал, ключ
+// после записи удаляется ещё раз. Отметки хранятся в kEpochSlots ячейках по хешу ключа:
+// совпадение хешей лишь пропускает лишнюю запись.
+//
+// С use_snapshot() ключ, которого нет ни в L1, ни в Redis (или Redis недоступен,
+// автомат разомкнут), ищется в снимке горячих записей прошлого запуска (CacheSnapshot):
+// после рестарта тёплые ответы есть, даже если Redis сам перезапущен. Снимок — после
+// Redis: пока сервис стоял, другие экземпляры могли изменить ключ, и значение из Redis
+// новее. Найденный в Redis ключ, новая запись и инвалидация убирают его из снимка;
+// записи, полученные из снимка, вызывающий проверяет по БД.
+class TieredCache {
+public:
+    // Команды Redis, задержка которых пишется в Options::command_latency
+    enum class Command { Get, Mget, Set, SetMany, Invalidate, Count };
+
+    struct Options {
+        std::string redis_uri;
+        std::string channel = "cache_invalidation";
+        L1Cache::Options l1;
+        // TTL записи в L1 не больше этого значения (и не больше TTL в Redis)
+        std::chrono::seconds l1_ttl{60};
+        // Таймаут подключения слушателя инвалидаций
+        std::chrono::milliseconds connect_timeout{100};
+        // Регистратор с рядами command_labels(); nullptr — не замерять
+        LatencyRecorder *command_latency = nullptr;
+        // С этого числа ключей get_many и put_many идут через клиент use_bulk()
+        std::size_t bulk_min_keys = 128;
+    };
+
+    static std::vector<std::string> command_labels() {
+        return {"cmd=\"get\"", "cmd=\"mget\"", "cmd=\"set\"", "cmd=\"set_many\"", "cmd=\"invalidate\""};
+    }
+
+    // Номер для put(..., since): инвалидации, отмеченные позже, отменяют запись
+    using FillEpoch = std::uint64_t;
+    static constexpr FillEpoch kAnyEpoch = ~FillEpoch(0); // без проверки
+    static constexpr std::size_t kEpochSlots = 4096;
+
+    // Сколько ключей пропущенных инвалидаций помнить до восстановления Redis
+    static constexpr std::size_t kMaxSkippedInvalidations = 100000;
+
+    struct Stats {
+        std::uint64_t l1_hits = 0;
+        std::uint64_t l2_hits = 0;
+        std::uint64_t snapshot_hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t invalidations_sent = 0;
+        std::uint64_t invalidations_received = 0;
+        std::uint64_t invalidations_skipped = 0;  // не дошли до Redis, ждут повтора
+        std::uint64_t invalidations_replayed = 0; // повторены после восстановления
+        std::uint64_t invalidations_lost = 0;     // не поместились в очередь повтора
+        std::uint64_t fills_skipped = 0;          // put() после инвалидации ключа отменён
+        L1Cache::Stats l1;
+    };
+
+    // redis может быть nullptr — тогда работает только L1
+    TieredCache(sw::redis::Redis *redis, Options options)
+        : redis_(redis), options_(std::move(options)), l1_(options_.l1), instance_id_(make_instance_id()) {}
+
+    ~TieredCache() {
+        if (breaker_) {
+            breaker_->on_recover(nullptr);
+        }
+        stopping_ = true;
+        if (listener_.joinable()) {
+            listener_.join();
+        }
+    }
+
+    TieredCache(const TieredCache &) = delete;
+    TieredCache &operator=(const TieredCache &) = delete;
+
+    // Запускает фоновую подписку на канал инвалидации
+    void start_invalidation_listener() {
+        if (!redis_ || listener_.joinable()) {
+            return;
+        }
+        listener_ = std::thread([this] { listen_loop(); });
+    }
+
+    // Автомат защиты Redis; breaker должен жить дольше последнего обращения к кешу.
+    // Его фоновый поток повторяет пропущенные инвалидации.
+    void use_breaker(RedisBreaker *breaker) {
+        breaker_ = breaker;
+        if (breaker_) {
+            breaker_->on_recover([this] { replay_skipped_invalidations(); });
+        }
+    }
+
+    // Клиент для многоключевых команд; bulk должен жить дольше кеша
+    void use_bulk(sw::redis::Redis *bulk) { bulk_ = bulk; }
+
+    // Повторяет инвалидации, не дошедшие до Redis (без автомата — из redis_available())
+    void replay_skipped_invalidations() {
+        replay_requested_.store(false, std::memory_order_relaxed);
+        if (has_skipped_.exchange(false)) {
+            replay_skipped();
+        }
+    }
+
+    // Снимок с диска для тёплого рестарта; snapshot должен жить дольше кеша
+    void use_snapshot(CacheSnapshot *snapshot) { snapshot_ = snapshot; }
+
+#ifdef HAVE_REDIS_ASYNC
+    // Неблокирующий режим: async должен жить дольше кеша
+    void use_async(sw::redis::AsyncRedis *async, std::chrono::milliseconds read_timeout) {
+        async_ = async;
+        async_read_timeout_ = read_timeout;
+    }
+#endif
+
+    CacheLookup get(const std::string &key) {
+        StageSpan span(Stage::Cache);
+        if (auto value = l1_.get(key)) {
+            l1_hits_.fetch_add(1, std::memory_order_relaxed);
+            return {std::move(value), CacheSource::L1};
+        }
+        if (redis_available()) {
+            try {
+                std::chrono::milliseconds l1_ttl{0};
+                if (auto cached = redis_get(key, l1_ttl)) {
+                    auto value = std::make_shared<const std::string>(std::move(*cached));
+                    l1_.put(key, value, l1_ttl);
+                    drop_from_snapshot(key);
+                    l2_hits_.fetch_add(1, std::memory_order_relaxed);
+                    return {std::move(value), CacheSource::Redis};
+                }
+            }
+            catch (const std::exception &e) {
+                redis_error("GET error (" + key + ")", e);
+            }
+        }
+        if (auto value = take_from_snapshot(key)) {
+            return {std::move(value), CacheSource::Snapshot};
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    // Несколько ключей сразу: L1, затем одна отправка в Redis на все ключи, которых нет в
+    // L1 (GET и PTTL каждого конвейером), затем снимок. result[i] соответствует keys[i].
+    std::vector<CacheLookup> get_many(const std::vector<std::string> &keys) {
+        StageSpan span(Stage::Cache);
+        std::vector<CacheLookup> result(keys.size());
+        std::vector<std::size_t> missing;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            if (auto value = l1_.get(keys[i])) {
+                result[i] = {std::move(value), CacheSource::L1};
+                l1_hits_.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                missing.push_back(i);
+            }
+        }
+
+        std::size_t found = 0;
+        if (!missing.empty() && redis_available()) {
+            std::vector<std::string> missing_keys;
+            missing_keys.reserve(missing.size());
+            for (std::size_t i : missing) {
+                missing_keys.push_back(keys[i]);
+            }
+            std::vector<sw::redis::OptionalString> values;
+            std::vector<long long> pttls;
+            values.reserve(missing.size());
+            pttls.reserve(missing.size());
+            try {
+                CommandTimer timer(*this, Command::Mget);
+                auto pipe = client_for(missing_keys.size()).pipeline(false);
+                for (const std::string &key : missing_keys) {
+                    pipe.get(key).pttl(key);
+                }
+                auto replies = pipe.exec();
+                for (std::size_t j = 0; j < missing_keys.size(); ++j) {
+                    values.push_back(replies.get<sw::redis::OptionalString>(2 * j));
+                    pttls.push_back(replies.get<long long>(2 * j + 1));
+                }
+            }
+            catch (const std::exception &e) {
+                redis_error("MGET error (" + std::to_string(missing_keys.size()) + " keys)", e);
+                values.clear();
+            }
+            for (std::size_t j = 0; j < values.size() && j < missing.size(); ++j) {
+                if (values[j]) {
+                    auto value = std::make_shared<const std::string>(std::move(*values[j]));
+                    l1_.put(keys[missing[j]], value, l1_ttl_for(pttls[j]));
+                    result[missing[j]] = {std::move(value), CacheSource::Redis};
+                    drop_from_snapshot(keys[missing[j]]);
+                    ++found;
+                }
+            }
+        }
+        l2_hits_.fetch_add(found, std::memory_order_relaxed);
+        std::size_t from_snapshot = 0;
+        for (std::size_t i : missing) {
+            if (result[i].value) {
+                continue;
+            }
+            if (auto value = take_from_snapshot(keys[i])) {
+                result[i] = {std::move(value), CacheSource::Snapshot};
+                ++from_snapshot;
+            }
+        }
+        misses_.fetch_add(missing.size() - found - from_snapshot, std::memory_order_relaxed);
+        return result;
+    }
+
+    // Только Redis, без счётчиков: для опроса ключа, который пересобирает другой экземпляр
+    L1Cache::Value get_from_redis(const std::string &key) {
+        StageSpan span(Stage::Cache);
+        if (!redis_available()) {
+            return nullptr;
+        }
+        try {
+            std::chrono::milliseconds l1_ttl{0};
+            if (auto cached = redis_get(key, l1_ttl)) {
+                auto value = std::make_shared<const std::string>(std::move(*cached));
+                l1_.put(key, value, l1_ttl);
+                return value;
+            }
+        }
+        catch (const std::exception &e) {
+            redis_error("GET error (" + key + ")", e);
+        }
+        return nullptr;
+    }
+
+    // Отметка для загрузки из БД: брать до чтения, передавать в put()/put_many()
+    FillEpoch fill_epoch() const { return invalidation_seq_.load(); }
+
+    // since — fill_epoch() до чтения значения из БД; если ключ с тех пор инвалидирован,
+    // запись не кладётся
+    void put(const std::string &key, const std::string &value, std::chrono::seconds ttl,
+             FillEpoch since = kAnyEpoch) {
+        StageSpan span(Stage::CacheFill);
+        if (invalidated_since(key, since)) {
+            fills_skipped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (snapshot_) {
+            snapshot_->erase(key);
+        }
+        l1_.put(key, std::make_shared<const std::string>(value), std::min(ttl, options_.l1_ttl));
+        if (!redis_available()) {
+            drop_if_invalidated(key, since);
+            return;
+        }
+#ifdef HAVE_REDIS_ASYNC
+        if (async_) {
+            // Ответ не ждём: future отбрасывается, ошибка записи значит лишь лишний промах
+            try {
+                async_->set(key, value, ttl);
+            }
+            catch (const std::exception &e) {
+                redis_error("async SET error (" + key + ")", e);
+            }
+            drop_if_invalidated(key, since);
+            return;
+        }
+#endif
+        try {
+            // Значение и TTL одной командой: ключ не бывает без срока жизни
+            CommandTimer timer(*this, Command::Set);
+            redis_->set(key, value, ttl);
+        }
+        catch (const std::exception &e) {
+            redis_error("SET error (" + key + ")", e);
+        }
+        drop_if_invalidated(key, since);
+    }
+
+    // Несколько записей с одним TTL: в Redis уходят одним конвейером SET ... PX.
+    // since — как в put(), для всех ключей.
+    void put_many(const std::vector<std::pair<std::string, std::string>> &all_entries, std::chrono::seconds ttl,
+                  FillEpoch since = kAnyEpoch) {
+        std::vector<std::pair<std::string, std::string>> kept;
+        if (since != kAnyEpoch) {
+            for (const auto &entry : all_entries) {
+                if (invalidated_since(entry.first, since)) {
+                    fills_skipped_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else {
+                    kept.push_back(entry);
+                }
+            }
+        }
+        const auto &entries = since != kAnyEpoch ? kept : all_entries;
+        if (entries.empty()) {
+            return;
+        }
+        StageSpan span(Stage::CacheFill);
+        for (const auto &[key, value] : entries) {
+            if (snapshot_) {
+                snapshot_->erase(key);
+            }
+            l1_.put(key, std::make_shared<const std::string>(value), std::min(ttl, options_.l1_ttl));
+        }
+        std::vector<std::string> keys;
+        if (since != kAnyEpoch) {
+            keys.reserve(entries.size());
+            for (const auto &entry : entries) {
+                keys.push_back(entry.first);
+            }
+        }
+        if (!redis_available()) {
+            drop_invalidated(keys, since);
+            return;
+        }
+#ifdef HAVE_REDIS_ASYNC
+        if (async_) {
+            for (const auto &[key, value] : entries) {
+                try {
+                    async_->set(key, value, ttl);
+                }
+                catch (const std::exception &e) {
+                    redis_error("async SET error (" + key + ")", e);
+                }
+            }
+            drop_invalidated(keys, since);
+            return;
+        }
+#endif
+        try {
+            CommandTimer timer(*this, Command::SetMany);
+            auto pipe = client_for(entries.size()).pipeline(false);
+            for (const auto &[key, value] : entries) {
+                pipe.set(key, value, ttl);
+            }
+            pipe.exec();
+        }
+        catch (const std::exception &e) {
+            redis_error("pipelined SET error (" + std::to_string(entries.size()) + " keys)", e);
+        }
+        drop_invalidated(keys, since);
+    }
+
+    // Счётчик поколения (например, для ключей, которые нельзя перечислить при инвалидации):
+    // значение из L1, иначе из Redis ("0", если ключа нет). Меняется через invalidate().
+    std::string generation(const std::string &key) {
+        if (auto value = l1_.get(key)) {
+            return *value;
+        }
+        std::string value = "0";
+        if (redis_) {
+            // В L1 не кладём, если Redis недоступен: после восстановления прочтём настоящее значение
+            if (!redis_available()) {
+                return value;
+            }
+            try {
+                if (auto stored = redis_get(key)) {
+                    value = std::move(*stored);
+                }
+            }
+            catch (const std::exception &e) {
+                redis_error("GET error (" + key + ")", e);
+                return value;
+            }
+        }
+        l1_.put(key, std::make_shared<const std::string>(value), options_.l1_ttl);
+        return value;
+    }
+
+    // Удаляет ключи из L1 и Redis, увеличивает счётчики поколений generations и рассылает
+    // всё это остальным экземплярам. В Redis уходит одним конвейером: DEL, INCR, PUBLISH.
+    void invalidate(const std::vector<std::string> &keys, const std::vector<std::string> &generations = {}) {
+        if (keys.empty() && generations.empty()) {
+            return;
+        }
+        // Отметка — до удаления: put(), не заметивший её, пишет раньше DEL ниже
+        mark_invalidated(keys);
+        for (const auto &key : keys) {
+            l1_.erase(key);
+            if (snapshot_) {
+                snapshot_->erase(key);
+            }
+        }
+        for (const auto &key : generations) {
+            l1_.erase(key);
+        }
+        if (!redis_) {
+            return;
+        }
+        if (!redis_available()) {
+            remember_skipped(keys, generations);
+            return;
+        }
+        try {
+            CommandTimer timer(*this, Command::Invalidate);
+            send_invalidation(keys, generations);
+        }
+        catch (const std::exception &e) {
+            redis_error("invalidation error", e);
+            remember_skipped(keys, generations);
+        }
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.l1_hits = l1_hits_.load(std::memory_order_relaxed);
+        s.l2_hits = l2_hits_.load(std::memory_order_relaxed);
+        s.snapshot_hits = snapshot_hits_.load(std::memory_order_relaxed);
+        s.misses = misses_.load(std::memory_order_relaxed);
+        s.invalidations_sent = invalidations_sent_.load(std::memory_order_relaxed);
+        s.invalidations_received = invalidations_received_.load(std::memory_order_relaxed);
+        s.invalidations_skipped = invalidations_skipped_.load(std::memory_order_relaxed);
+        s.invalidations_replayed = invalidations_replayed_.load(std::memory_order_relaxed);
+        s.invalidations_lost = invalidations_lost_.load(std::memory_order_relaxed);
+        s.fills_skipped = fills_skipped_.load(std::memory_order_relaxed);
+        s.l1 = l1_.stats();
+        return s;
+    }
+
+    // Обнуляет счётчики попаданий и промахов: прогрев перед приёмом запросов не должен
+    // попадать в долю попаданий
+    void reset_hit_stats() {
+        l1_hits_.store(0, std::memory_order_relaxed);
+        l2_hits_.store(0, std::memory_order_relaxed);
+        snapshot_hits_.store(0, std::memory_order_relaxed);
+        misses_.store(0, std::memory_order_relaxed);
+    }
+
+    // Записи L1, для которых filter(key) == true (для снимка на диск)
+    template <typename Filter>
+    std::vector<L1Cache::Exported> l1_entries(Filter &&filter) const {
+        return l1_.entries(std::forward<Filter>(filter));
+    }
+
+private:
+    // Замер команды Redis: время жизни объекта, ошибка — выход по исключению.
+    // Успешная команда сбрасывает счётчик ошибок автомата защиты.
+    class CommandTimer {
+    public:
+        CommandTimer(TieredCache &cache, Command command)
+            : recorder_(cache.options_.command_latency), breaker_(cache.breaker_), command_(command),
+              exceptions_(std::uncaught_exceptions()), start_(std::chrono::steady_clock::now()) {}
+
+        ~CommandTimer() {
+            const bool failed = std::uncaught_exceptions() > exceptions_;
+            if (recorder_) {
+                recorder_->record(static_cast<std::size_t>(command_), std::chrono::steady_clock::now() - start_,
+                                  failed);
+            }
+            if (breaker_ && !failed) {
+                breaker_->success();
+            }
+        }
+
+        CommandTimer(const CommandTimer &) = delete;
+        CommandTimer &operator=(const CommandTimer &) = delete;
+
+    private:
+        LatencyRecorder *recorder_;
+        RedisBreaker *breaker_;
+        const Command command_;
+        const int exceptions_;
+        const std::chrono::steady_clock::time_point start_;
+    };
+
+    // Значение из снимка переносится в L1 (не дольше l1_ttl и остатка срока в снимке)
+    L1Cache::Value take_from_snapshot(const std::string &key) {
+        if (!snapshot_) {
+            return nullptr;
+        }
+        std::chrono::milliseconds ttl{0};
+        auto value = snapshot_->take(key, ttl);
+        if (value) {
+            l1_.put(key, value, std::min<std::chrono::milliseconds>(ttl, options_.l1_ttl));
+            snapshot_hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    std::atomic<FillEpoch> &epoch_slot(const std::string &key) {
+        return epochs_[std::hash<std::string>()(key) % kEpochSlots];
+    }
+
+    // Ключи инвалидированы: их ячейкам — новый номер (только вперёд)
+    void mark_invalidated(const std::vector<std::string> &keys) {
+        if (keys.empty()) {
+            return;
+        }
+        const FillEpoch seq = ++invalidation_seq_;
+        for (const auto &key : keys) {
+            std::atomic<FillEpoch> &slot = epoch_slot(key);
+            FillEpoch current = slot.load();
+            while (current < seq && !slot.compare_exchange_weak(current, seq)) {
+            }
+        }
+    }
+
+    bool invalidated_since(const std::string &key, FillEpoch since) {
+        return since != kAnyEpoch && (cleared_seq_.load() > since || epoch_slot(key).load() > since);
+    }
+
+    void drop_if_invalidated(const std::string &key, FillEpoch since) {
+        if (invalidated_since(key, since)) {
+            drop_invalidated({key}, since);
+        }
+    }
+
+    // После записи: ключи, инвалидированные, пока она шла, удаляются ещё раз — запись
+    // могла лечь в Redis после DEL инвалидации
+    void drop_invalidated(const std::vector<std::string> &keys, FillEpoch since) {
+        std::vector<std::string> dropped;
+        for (const auto &key : keys) {
+            if (invalidated_since(key, since)) {
+                l1_.erase(key);
+                dropped.push_back(key);
+            }
+        }
+        if (dropped.empty()) {
+            return;
+        }
+        fills_skipped_.fetch_add(dropped.size(), std::memory_order_relaxed);
+        if (!redis_available()) {
+            return;
+        }
+        try {
+            redis_->del(dropped.begin(), dropped.end());
+        }
+        catch (const std::exception &e) {
+            redis_error("DEL error (" + std::to_string(dropped.size()) + " keys)", e);
+        }
+    }
+
+    // Значение из Redis новее снимка: запись снимка больше не нужна
+    void drop_from_snapshot(const std::string &key) {
+        if (snapshot_) {
+            snapshot_->erase(key);
+        }
+    }
+
+    // Redis можно использовать: есть клиент и автомат защиты замкнут. Пропущенные
+    // инвалидации повторяет фоновый поток автомата; запрос только напоминает о них.
+    bool redis_available() {
+        if (!redis_ || (breaker_ && !breaker_->allow())) {
+            return false;
+        }
+        if (has_skipped_.load(std::memory_order_relaxed)) {
+            if (!breaker_) {
+                replay_skipped_invalidations();
+            }
+            else if (!replay_requested_.exchange(true, std::memory_order_relaxed)) {
+                breaker_->request_recovery();
+            }
+        }
+        return true;
+    }
+
+    sw::redis::Redis &client_for(std::size_t keys) const {
+        return bulk_ && keys >= options_.bulk_min_keys ? *bulk_ : *redis_;
+    }
+
+    void redis_error(const std::string &op, const std::exception &e) {
+        if (breaker_) {
+            breaker_->failure(op, e);
+        }
+        else {
+            std::cerr << "Redis " << op << ": " << e.what() << std::endl;
+        }
+    }
+
+    // В Redis одним конвейером: DEL, INCR, PUBLISH
+    void send_invalidation(const std::vector<std::string> &keys, const std::vector<std::string> &generations,
+                           sw::redis::Redis *client = nullptr) {
+        std::string message = instance_id_;
+        for (const auto *list : {&keys, &generations}) {
+            for (const auto &key : *list) {
+                message += ' ';
+                message += key;
+            }
+        }
+        auto pipe = (client ? client : redis_)->pipeline(false);
+        if (!keys.empty()) {
+            pipe.del(keys.begin(), keys.end());
+        }
+        for (const auto &key : generations) {
+            pipe.incr(key);
+        }
+        pipe.publish(options_.channel, message);
+        pipe.exec();
+        invalidations_sent_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Повторяет инвалидации, не дошедшие до Redis, через клиент для многоключевых команд.
+    // При ошибке ключи возвращаются в очередь повтора до следующего обращения.
+    void replay_skipped() {
+        std::vector<std::string> keys;
+        std::vector<std::string> generations;
+        bool lost = false;
+        {
+            std::lock_guard<std::mutex> lock(skipped_mutex_);
+            keys.swap(skipped_keys_);
+            generations.swap(skipped_generations_);
+            std::swap(lost, skipped_lost_);
+        }
+        for (auto *list : {&keys, &generations}) {
+            std::sort(list->begin(), list->end());
+            list->erase(std::unique(list->begin(), list->end()), list->end());
+        }
+        try {
+            CommandTimer timer(*this, Command::Invalidate);
+            // Ключи — пачками по 1000, поколения — с первой пачкой
+            std::size_t begin = 0;
+            do {
+                const std::size_t end = std::min(begin + 1000, keys.size());
+                send_invalidation(std::vector<std::string>(keys.begin() + static_cast<std::ptrdiff_t>(begin),
+                                                           keys.begin() + static_cast<std::ptrdiff_t>(end)),
+                                  begin == 0 ? generations : std::vector<std::string>(), bulk_);
+                begin = end;
+            } while (begin < keys.size());
+        }
+        catch (const std::exception &e) {
+            redis_error("invalidation replay error", e);
+            remember_skipped(keys, generations);
+            if (lost) {
+                std::lock_guard<std::mutex> lock(skipped_mutex_);
+                skipped_lost_ = true;
+            }
+            return;
+        }
+        invalidations_replayed_.fetch_add(keys.size() + generations.size(), std::memory_order_relaxed);
+        std::cerr << "Redis: replayed " << keys.size() << " keys and " << generations.size()
+                  << " generations invalidated while it was unavailable" << std::endl;
+        if (lost) {
+            std::cerr << "Redis: some invalidations were dropped while it was unavailable, "
+                         "affected entries expire by TTL" << std::endl;
+        }
+    }
+
+    void remember_skipped(const std::vector<std::string> &keys, const std::vector<std::string> &generations) {
+        std::lock_guard<std::mutex> lock(skipped_mutex_);
+        auto remember = [this](const std::vector<std::string> &from, std::vector<std::string> &to) {
+            for (const auto &key : from) {
+                if (skipped_keys_.size() + skipped_generations_.size() >= kMaxSkippedInvalidations) {
+                    skipped_lost_ = true;
+                    invalidations_lost_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                to.push_back(key);
+                invalidations_skipped_.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+        remember(keys, skipped_keys_);
+        remember(generations, skipped_generations_);
+        has_skipped_.store(true, std::memory_order_relaxed);
+    }
+
+    sw::redis::OptionalString redis_get(const std::string &key) {
+        CommandTimer timer(*this, Command::Get);
+#ifdef HAVE_REDIS_ASYNC
+        if (async_) {
+            auto future = async_->get(key);
+            if (future.wait_for(async_read_timeout_) != std::future_status::ready) {
+                throw std::runtime_error("async GET timed out");
+            }
+            return future.get();
+        }
+#endif
+        return redis_->get(key);
+    }
+
+    // Значение и TTL для L1 (см. l1_ttl_for): GET и PTTL уходят одной отправкой, в
+    // неблокирующем режиме — двумя запросами без ожидания друг друга
+    sw::redis::OptionalString redis_get(const std::string &key, std::chrono::milliseconds &l1_ttl) {
+        CommandTimer timer(*this, Command::Get);
+#ifdef HAVE_REDIS_ASYNC
+        if (async_) {
+            auto value = async_->get(key);
+            auto pttl = async_->command<long long>("PTTL", key);
+            const auto deadline = std::chrono::steady_clock::now() + async_read_timeout_;
+            if (value.wait_until(deadline) != std::future_status::ready ||
+                pttl.wait_until(deadline) != std::future_status::ready) {
+                throw std::runtime_error("async GET timed out");
+            }
+            l1_ttl = l1_ttl_for(pttl.get());
+            return value.get();
+        }
+#endif
+        auto pipe = redis_->pipeline(false);
+        auto replies = pipe.get(key).pttl(key).exec();
+        l1_ttl = l1_ttl_for(replies.get<long long>(1));
+        return replies.get<sw::redis::OptionalString>(0);
+    }
+
+    // Запись из Redis живёт в L1 не дольше l1_ttl и не дольше, чем ключ в Redis: иначе
+    // истечение ключа в Redis (тоже инвалидация) не доходило бы до L1. PTTL -1 — ключ без
+    // срока, -2 — ключ истёк между GET и PTTL (в L1 не кладётся).
+    std::chrono::milliseconds l1_ttl_for(long long pttl) const {
+        if (pttl == -1) {
+            return options_.l1_ttl;
+        }
+        return std::min<std::chrono::milliseconds>(std::chrono::milliseconds(std::max(0LL, pttl)), options_.l1_ttl);
+    }
+
+    static std::string make_instance_id() {
+        std::random_device rd;
+        std::ostringstream out;
+        out << std::hex << rd() << rd();
+        return out.str();
+    }
+
+    // Сообщение: "<instance_id> <key> <key> ..."
+    void handle_invalidation(const std::string &message) {
+        std::istringstream in(message);
+        std::string sender;
+        in >> sender;
+        if (sender == instance_id_) {
+            return;
+        }
+        invalidations_received_.fetch_add(1, std::memory_order_relaxed);
+        std::string key;
+        while (in >> key) {
+            mark_invalidated({key});
+            l1_.erase(key);
+            if (snapshot_) {
+                snapshot_->erase(key);
+            }
+        }
+    }
+
+    void listen_loop() {
+        // Подписка обрывалась: после следующей удачной подписки L1 очищается (один раз,
+        // а не при каждой попытке — пока Redis недоступен, L1 продолжает отвечать)
+        bool disconnected = false;
+        while (!stopping_) {
+            try {
+                // Отдельное соединение: подписка занимает его целиком. Таймаут сокета
+                // нужен, чтобы consume() периодически возвращал управление и поток
+                // мог заметить остановку.
+                sw::redis::ConnectionOptions connection_options(options_.redis_uri);
+                connection_options.connect_timeout = options_.connect_timeout;
+                connection_options.socket_timeout = std::chrono::milliseconds(1000);
+                sw::redis::Redis subscriber_client(connection_options);
+                auto subscriber = subscriber_client.subscriber();
+                subscriber.on_message([this](std::string, std::string message) {
+                    handle_invalidation(message);
+                });
+                subscriber.subscribe(options_.channel);
+                if (disconnected) {
+                    // Пока подписки не было, сообщения могли потеряться. Снимок не
+                    // сбрасывается: его записи и так не проверены и перечитываются из БД
+                    // вызывающим. Загрузки, начатые до этого, тоже не кладут свои записи.
+                    cleared_seq_.store(++invalidation_seq_);
+                    l1_.clear();
+                    disconnected = false;
+                }
+                while (!stopping_) {
+                    try {
+                        subscriber.consume();
+                    }
+                    catch (const sw::redis::TimeoutError &) {
+                        continue;
+                    }
+                }
+            }
+            catch (const std::exception &e) {
+                if (breaker_) {
+                    breaker_->log_error("invalidation listener error", e);
+                }
+                else {
+                    std::cerr << "Redis invalidation listener error: " << e.what() << std::endl;
+                }
+                disconnected = true;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+        }
+    }
+
+    sw::redis::Redis *redis_;
+    sw::redis::Redis *bulk_ = nullptr;
+    RedisBreaker *breaker_ = nullptr;
+    CacheSnapshot *snapshot_ = nullptr;
+#ifdef HAVE_REDIS_ASYNC
+    sw::redis::AsyncRedis *async_ = nullptr;
+    std::chrono::milliseconds async_read_timeout_{50};
+#endif
+    Options options_;
+    L1Cache l1_;
+    const std::string instance_id_;
+
+    std::atomic<bool> stopping_{false};
+    std::thread listener_;
+
+    std::atomic<std::uint64_t> l1_hits_{0};
+    std::atomic<std::uint64_t> l2_hits_{0};
+    std::atomic<std::uint64_t> snapshot_hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> invalidations_sent_{0};
+    std::atomic<std::uint64_t> invalidations_received_{0};
+    std::atomic<std::uint64_t> invalidations_skipped_{0};
+    std::atomic<std::uint64_t> invalidations_replayed_{0};
+    std::atomic<std::uint64_t> invalidations_lost_{0};
+    std::atomic<std::uint64_t> fills_skipped_{0};
+
+    std::atomic<FillEpoch> invalidation_seq_{0};
+    std::atomic<FillEpoch> cleared_seq_{0}; // L1 сброшен целиком: отменяет все загрузки до него
+    std::array<std::atomic<FillEpoch>, kEpochSlots> epochs_{};
+
+    std::atomic<bool> has_skipped_{false};
+    std::atomic<bool> replay_requested_{false}; // фоновый повтор уже запрошен
+    std::mutex skipped_mutex_;
+    std::vector<std::string> skipped_keys_;
+    std::vector<std::string> skipped_generations_;
+    bool skipped_lost_ = false; // часть ключей не поместилась, их записи истекут по TTL
+};
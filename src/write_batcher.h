@@ -0,0 +1,287 @@
+// src/write_batcher.h
+
+#pragma once
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "db_pool.h"
+
+enum class WriteStatus {
+    Created,
+    ArticleNotFound, // комментарий к несуществующей статье
+    Overloaded,      // очередь записи переполнена
+    Failed           // ошибка БД
+};
+
+// Одна запись: новая статья (article_id == 0 до вставки) или комментарий к article_id
+struct PendingWrite {
+    enum class Kind { Article, Comment } kind;
+    int article_id = 0;
+    std::string title;   // только для статьи
+    std::string content;
+};
+
+struct WriteResult {
+    WriteStatus status = WriteStatus::Failed;
+    int id = 0;         // id созданной статьи или комментария
+    int article_id = 0; // статья, которой касается запись
+};
+
+// Групповая фиксация записей (group commit).
+//
+// Обработчики кладут записи в очередь и ждут future. Фоновый поток забирает из очереди
+// до max_batch записей — сразу, как их набралось достаточно, или через max_delay после
+// первой — и вставляет их одной транзакцией: по одному многострочному INSERT на статьи
+// и на комментарии (см. insert_articles/insert_comments в prepare_article_statements).
+// Если транзакция пачки не удалась, записи повторяются по одной, чтобы одна плохая
+// запись не роняла остальные. Повтор только там, где исход известен: если связь
+// оборвалась во время COMMIT (pqxx::in_doubt_error), пачка могла и зафиксироваться,
+// и повтор её продублировал бы — такие записи отвечают WriteStatus::Failed.
+//
+// После фиксации пачки, до того как обработчики получат ответ, вызывается on_commit со
+// всеми успешными записями — там сбрасывается кеш, так что клиент, получивший 201,
+// уже не прочтёт устаревший ответ из кеша своего экземпляра.
+class WriteBatcher {
+public:
+    struct Options {
+        std::size_t max_batch = 64;
+        std::chrono::microseconds max_delay{1000};
+        std::size_t max_pending = 10000; // больше — отказ с WriteStatus::Overloaded
+    };
+
+    struct Stats {
+        std::uint64_t batches = 0;
+        std::uint64_t writes = 0;
+        std::uint64_t max_batch_seen = 0;
+        std::uint64_t failed_batches = 0; // пачки, повторённые по одной записи
+        std::uint64_t in_doubt = 0;       // записи с неизвестным исходом COMMIT, без повтора
+        std::uint64_t rejected = 0;
+        std::size_t pending = 0;
+    };
+
+    using CommitHook = std::function<void(const std::vector<PendingWrite> &, const std::vector<WriteResult> &)>;
+
+    WriteBatcher(DbPool &db_pool, Options options, CommitHook on_commit)
+        : db_pool_(db_pool), options_(options), on_commit_(std::move(on_commit)),
+          thread_([this] { loop(); }) {}
+
+    ~WriteBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    WriteBatcher(const WriteBatcher &) = delete;
+    WriteBatcher &operator=(const WriteBatcher &) = delete;
+
+    std::future<WriteResult> add_article(std::string title, std::string content) {
+        return submit({PendingWrite::Kind::Article, 0, std::move(title), std::move(content)});
+    }
+
+    std::future<WriteResult> add_comment(int article_id, std::string content) {
+        return submit({PendingWrite::Kind::Comment, article_id, {}, std::move(content)});
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.batches = batches_.load(std::memory_order_relaxed);
+        s.writes = writes_.load(std::memory_order_relaxed);
+        s.max_batch_seen = max_batch_seen_.load(std::memory_order_relaxed);
+        s.failed_batches = failed_batches_.load(std::memory_order_relaxed);
+        s.in_doubt = in_doubt_.load(std::memory_order_relaxed);
+        s.rejected = rejected_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.pending = queue_.size();
+        return s;
+    }
+
+private:
+    struct Item {
+        PendingWrite write;
+        std::promise<WriteResult> promise;
+    };
+
+    std::future<WriteResult> submit(PendingWrite write) {
+        std::promise<WriteResult> promise;
+        std::future<WriteResult> future = promise.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= options_.max_pending) {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                promise.set_value({WriteStatus::Overloaded, 0, write.article_id});
+                return future;
+            }
+            queue_.push_back({std::move(write), std::move(promise)});
+            if (queue_.size() == 1) {
+                first_enqueued_ = std::chrono::steady_clock::now();
+            }
+        }
+        cv_.notify_one();
+        return future;
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return; // stopping_ и очередь разобрана
+            }
+            // Ждём, пока наберётся пачка или истечёт окно с момента первой записи
+            cv_.wait_until(lock, first_enqueued_ + options_.max_delay, [this] {
+                return stopping_ || queue_.size() >= options_.max_batch;
+            });
+
+            std::vector<Item> batch;
+            const std::size_t n = std::min(queue_.size(), options_.max_batch);
+            batch.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            if (!queue_.empty()) {
+                first_enqueued_ = std::chrono::steady_clock::now();
+            }
+
+            lock.unlock();
+            process(batch);
+            lock.lock();
+        }
+    }
+
+    void process(std::vector<Item> &batch) {
+        std::vector<PendingWrite> writes;
+        writes.reserve(batch.size());
+        for (auto &item : batch) {
+            writes.push_back(std::move(item.write));
+        }
+
+        std::vector<WriteResult> results;
+        try {
+            results = insert(writes);
+        }
+        catch (const pqxx::in_doubt_error &e) {
+            std::cerr << "Write batch of " << writes.size() << " in doubt, not retrying: " << e.what() << std::endl;
+            in_doubt_.fetch_add(writes.size(), std::memory_order_relaxed);
+            results.clear();
+            for (const auto &write : writes) {
+                results.push_back({WriteStatus::Failed, 0, write.article_id});
+            }
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Write batch of " << writes.size() << " failed, retrying one by one: " << e.what() << std::endl;
+            failed_batches_.fetch_add(1, std::memory_order_relaxed);
+            results.clear();
+            for (const auto &write : writes) {
+                try {
+                    results.push_back(insert({write})[0]);
+                }
+                catch (const pqxx::in_doubt_error &single) {
+                    std::cerr << "Write in doubt, not retrying: " << single.what() << std::endl;
+                    in_doubt_.fetch_add(1, std::memory_order_relaxed);
+                    results.push_back({WriteStatus::Failed, 0, write.article_id});
+                }
+                catch (const std::exception &single) {
+                    std::cerr << "Write failed: " << single.what() << std::endl;
+                    results.push_back({WriteStatus::Failed, 0, write.article_id});
+                }
+            }
+        }
+
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        writes_.fetch_add(writes.size(), std::memory_order_relaxed);
+        if (writes.size() > max_batch_seen_.load(std::memory_order_relaxed)) {
+            max_batch_seen_.store(writes.size(), std::memory_order_relaxed);
+        }
+
+        if (on_commit_) {
+            try {
+                on_commit_(writes, results);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Write commit hook failed: " << e.what() << std::endl;
+            }
+        }
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            batch[i].promise.set_value(results[i]);
+        }
+    }
+
+    // Вставка пачки одной транзакцией; results[i] соответствует writes[i]
+    std::vector<WriteResult> insert(const std::vector<PendingWrite> &writes) {
+        std::vector<WriteResult> results(writes.size());
+        std::vector<std::size_t> article_rows, comment_rows;
+        std::vector<std::string> titles, article_contents, comment_contents;
+        std::vector<int> comment_articles;
+        for (std::size_t i = 0; i < writes.size(); ++i) {
+            const PendingWrite &w = writes[i];
+            if (w.kind == PendingWrite::Kind::Article) {
+                article_rows.push_back(i);
+                titles.push_back(w.title);
+                article_contents.push_back(w.content);
+            }
+            else {
+                comment_rows.push_back(i);
+                comment_articles.push_back(w.article_id);
+                comment_contents.push_back(w.content);
+                results[i] = {WriteStatus::ArticleNotFound, 0, w.article_id};
+            }
+        }
+
+        auto conn = db_pool_.acquire();
+        pqxx::work tx(*conn);
+        // Статьи вставляются первыми: комментарии пачки могут ссылаться на них
+        if (!article_rows.empty()) {
+            // Строки результата: (порядковый номер во входных массивах с 1, id)
+            for (const auto &row : tx.exec_prepared("insert_articles", titles, article_contents)) {
+                const std::size_t i = article_rows[row[0].as<std::size_t>() - 1];
+                const int id = row[1].as<int>();
+                results[i] = {WriteStatus::Created, id, id};
+            }
+        }
+        if (!comment_rows.empty()) {
+            for (const auto &row : tx.exec_prepared("insert_comments", comment_articles, comment_contents)) {
+                const std::size_t i = comment_rows[row[0].as<std::size_t>() - 1];
+                results[i] = {WriteStatus::Created, row[1].as<int>(), writes[i].article_id};
+            }
+        }
+        tx.commit();
+        return results;
+    }
+
+    DbPool &db_pool_;
+    const Options options_;
+    CommitHook on_commit_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Item> queue_;
+    std::chrono::steady_clock::time_point first_enqueued_;
+    bool stopping_ = false;
+
+    std::atomic<std::uint64_t> batches_{0};
+    std::atomic<std::uint64_t> writes_{0};
+    std::atomic<std::uint64_t> max_batch_seen_{0};
+    std::atomic<std::uint64_t> failed_batches_{0};
+    std::atomic<std::uint64_t> in_doubt_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+
+    std::thread thread_; // последним: поток стартует, когда остальные поля готовы
+};